@@ -98,8 +98,8 @@ AnalysisTab::AnalysisTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger,
   drawingPub = node->Advertise<gazebo::msgs::Drawing>("~/draw");
   lasersPub = node->Advertise<gazebo::msgs::Lasers>("~/SceneReconstruction/Framework/Lasers");
 
-  objBufferSub = node->Subscribe("~/SceneReconstruction/ObjectInstantiator/Object", &AnalysisTab::OnBufferMsg, this);
-  robBufferSub = node->Subscribe("~/SceneReconstruction/RobotController/", &AnalysisTab::OnBufferMsg, this);
+  objBufferSub = node->Subscribe("~/SceneReconstruction/ObjectInstantiator/Object", &AnalysisTab::OnObjectBufferMsg, this);
+  robBufferSub = node->Subscribe("~/SceneReconstruction/RobotController/", &AnalysisTab::OnRobotBufferMsg, this);
   lasersSub = node->Subscribe("~/SceneReconstruction/GUI/Lasers", &AnalysisTab::OnLasersMsg, this);
   on_lasers_msg.connect( sigc::mem_fun( *this , &AnalysisTab::ProcessLasersMsg ));
   controlSub = node->Subscribe("~/SceneReconstruction/Framework/Control", &AnalysisTab::OnControlMsg, this);
@@ -110,6 +110,7 @@ AnalysisTab::~AnalysisTab() {
 }
 
 void AnalysisTab::OnControlMsg(ConstSceneFrameworkControlPtr& _msg) {
+  logger->record("~/SceneReconstruction/Framework/Control", *_msg);
   if(_msg->has_change_offset() && _msg->change_offset()) {
     time_offset = _msg->offset();
     on_control_msg();
@@ -128,11 +129,19 @@ void AnalysisTab::ProcessControlMsg() {
   }
 }
 
-void AnalysisTab::OnBufferMsg(ConstMessage_VPtr& _msg) {
-  {
-    boost::mutex::scoped_lock lock(*this->bufferMutex);
-    bufferMsgs.push_back(*_msg);
-  }
+void AnalysisTab::OnObjectBufferMsg(ConstMessage_VPtr& _msg) {
+  logger->record("~/SceneReconstruction/ObjectInstantiator/Object", *_msg);
+  BufferMsg(*_msg);
+}
+
+void AnalysisTab::OnRobotBufferMsg(ConstMessage_VPtr& _msg) {
+  logger->record("~/SceneReconstruction/RobotController/", *_msg);
+  BufferMsg(*_msg);
+}
+
+void AnalysisTab::BufferMsg(const gazebo::msgs::Message_V &_msg) {
+  boost::mutex::scoped_lock lock(*this->bufferMutex);
+  bufferMsgs.push_back(_msg);
 }
 
 void AnalysisTab::StartProcessBufferMsg() {
@@ -496,6 +505,7 @@ void AnalysisTab::on_button_lasers_update_clicked() {
 }
 
 void AnalysisTab::OnLasersMsg(ConstLasersPtr &_msg) {
+  logger->record("~/SceneReconstruction/GUI/Lasers", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->lasersMutex);
     this->lasersMsgs.push_back(*_msg);
@@ -111,7 +111,9 @@ namespace SceneReconstruction {
       double                                          time_offset;
 
     private:
-      void OnBufferMsg(ConstMessage_VPtr&);
+      void OnObjectBufferMsg(ConstMessage_VPtr&);
+      void OnRobotBufferMsg(ConstMessage_VPtr&);
+      void BufferMsg(const gazebo::msgs::Message_V&);
       void StartProcessBufferMsg();
       bool ProcessBufferMsg();
       void EndProcessBufferMsg();
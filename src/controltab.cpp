@@ -128,6 +128,7 @@ ControlTab::~ControlTab() {
 }
 
 void ControlTab::OnTimeMsg(ConstDoublePtr& _msg) {
+  logger->record("~/SceneReconstruction/GUI/Time", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->timeMutex);
     this->timeMsgs.push_back(*_msg);
@@ -155,6 +156,7 @@ void ControlTab::ProcessTimeMsg() {
 }
 
 void ControlTab::OnWorldStatsMsg(ConstWorldStatisticsPtr& _msg) {
+  logger->record("~/world_stats", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->worldstatsMutex);
     this->worldstatsMsgs.push_back(*_msg);
@@ -190,6 +192,7 @@ void ControlTab::ProcessWorldStatsMsg() {
 }
 
 void ControlTab::OnResMsg(ConstResponsePtr& _msg) {
+  logger->record("~/response", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->resMutex);
     this->resMsgs.push_back(*_msg);
@@ -229,6 +232,7 @@ void ControlTab::ProcessResMsg() {
 }
 
 void ControlTab::OnResponseMsg(ConstResponsePtr& _msg) {
+  logger->record("~/SceneReconstruction/GUI/Response", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->responseMutex);
     this->responseMsgs.push_back(*_msg);
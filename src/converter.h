@@ -15,6 +15,13 @@
 #include <gazebo/transport/TransportTypes.hh>
 #include <gazebo/gazebo_config.h>
 #include <gazebo/math/Pose.hh>
+#include <gazebo/common/Image.hh>
+#include <gazebo/msgs/msgs.hh>
+
+#include <cstring>
+#include <limits>
+
+#include "pixelconverter.h"
 
 namespace SceneReconstruction {
   /** @class Converter "converter.h"
@@ -330,7 +337,139 @@ namespace SceneReconstruction {
         return def;
       }
 
+      /** converts the pixels of an image message to a Gdk::Pixbuf
+       *  8 bit RGB and RGBA pixels are wrapped by the Pixbuf, the pixel
+       *  data is moved out of the message instead of copied. Gray, BGR(A),
+       *  16 bit and bayer images are converted by PixelConverter, 16 bit
+       *  gray images are depth images and shown with a color map over
+       *  their range. Other formats are converted by gazebo::common::Image,
+       *  all in memory.
+       *  @param image the image, its pixel data may be taken
+       *  @return the Pixbuf or an empty pointer if the image is invalid
+       */
+      static Glib::RefPtr<Gdk::Pixbuf> to_pixbuf(gazebo::msgs::Image &image) {
+        size_t width = image.width();
+        size_t height = image.height();
+        size_t step = image.step();
+        const std::string &data = image.data();
+        int format = image.pixel_format();
+
+        int bpp;
+        switch(format) {
+          case gazebo::common::Image::L_INT8:
+          case gazebo::common::Image::BAYER_RGGB8:
+          case gazebo::common::Image::BAYER_RGGR8:
+          case gazebo::common::Image::BAYER_GBRG8:
+          case gazebo::common::Image::BAYER_GRBG8: bpp = 1; break;
+          case gazebo::common::Image::L_INT16:     bpp = 2; break;
+          case gazebo::common::Image::RGB_INT8:
+          case gazebo::common::Image::BGR_INT8:    bpp = 3; break;
+          case gazebo::common::Image::RGBA_INT8:
+          case gazebo::common::Image::BGRA_INT8:   bpp = 4; break;
+          case gazebo::common::Image::RGB_INT16:
+          case gazebo::common::Image::BGR_INT16:   bpp = 6; break;
+          default:                                 bpp = 0; break;
+        }
+        // the Pixbuf takes its sizes as int, rows of up to 8 bytes per pixel
+        // and all rows of the image have to fit
+        const size_t int_max = std::numeric_limits<int>::max(), size_max = std::numeric_limits<size_t>::max();
+        if(width == 0 || height == 0 || width > int_max/8 || height > int_max || height > size_max/(width*8))
+          return Glib::RefPtr<Gdk::Pixbuf>();
+
+        if(bpp == 0) {
+          // formats without a direct conversion, e.g. floats
+          gazebo::common::Image img;
+          gazebo::msgs::Set(img, image);
+          unsigned char *rgb = NULL;
+          unsigned int count = 0;
+          img.GetRGBData(&rgb, count);
+          Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+          if(rgb && count >= width*height*3) {
+            pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, (int)width, (int)height);
+            for(size_t y = 0; pixbuf && y < height; y++)
+              memcpy(pixbuf->get_pixels() + y*pixbuf->get_rowstride(), rgb + y*width*3, width*3);
+          }
+          delete[] rgb;
+          return pixbuf;
+        }
+
+        if(step < width*bpp || step > int_max || height-1 > (size_max - width*bpp)/step ||
+           data.size() < step*(height-1) + width*bpp)
+          return Glib::RefPtr<Gdk::Pixbuf>();
+
+        if(format == gazebo::common::Image::RGB_INT8 || format == gazebo::common::Image::RGBA_INT8) {
+          // the rows are already laid out as a Pixbuf expects them
+          std::string *pixels = new std::string();
+          pixels->swap(*image.mutable_data());
+          return Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(pixels->data()), Gdk::COLORSPACE_RGB,
+                                               format == gazebo::common::Image::RGBA_INT8, 8, (int)width, (int)height, (int)step,
+                                               sigc::bind(sigc::ptr_fun(&free_pixels), pixels));
+        }
+
+        const unsigned char *src = reinterpret_cast<const unsigned char*>(data.data());
+        bool bayer = (bpp == 1 && format != gazebo::common::Image::L_INT8);
+        bool alpha = (bayer || format == gazebo::common::Image::BGRA_INT8);
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, alpha, 8, (int)width, (int)height);
+        // the pixels may not be allocated for big images
+        if(!pixbuf)
+          return pixbuf;
+        guint8 *pixels = pixbuf->get_pixels();
+        size_t rowstride = pixbuf->get_rowstride();
+
+        if(bayer) {
+          PixelConverter::BayerPattern pattern;
+          switch(format) {
+            case gazebo::common::Image::BAYER_RGGB8: pattern = PixelConverter::BAYER_RGGB; break;
+            case gazebo::common::Image::BAYER_GBRG8: pattern = PixelConverter::BAYER_GBRG; break;
+            case gazebo::common::Image::BAYER_GRBG8: pattern = PixelConverter::BAYER_GRBG; break;
+            // gazebo's name of the pattern with blue at the top left
+            default:                                 pattern = PixelConverter::BAYER_BGGR; break;
+          }
+          PixelConverter::bayer_to_rgba(src, step, pixels, rowstride, (int)width, (int)height, pattern);
+          return pixbuf;
+        }
+
+        uint16_t min = 0, max = 0;
+        if(format == gazebo::common::Image::L_INT16) {
+          for(size_t y = 0; y < height; y++)
+            PixelConverter::depth_range(src + y*step, width, min, max);
+        }
+
+        for(size_t y = 0; y < height; y++, src += step, pixels += rowstride) {
+          switch(format) {
+            case gazebo::common::Image::L_INT8:
+              PixelConverter::gray_to_rgb(src, pixels, width);
+              break;
+            case gazebo::common::Image::L_INT16:
+              PixelConverter::depth_to_rgb(src, pixels, width, min, max);
+              break;
+            case gazebo::common::Image::BGR_INT8:
+              PixelConverter::bgr_to_rgb(src, pixels, width);
+              break;
+            case gazebo::common::Image::BGRA_INT8:
+              PixelConverter::bgra_to_rgba(src, pixels, width);
+              break;
+            case gazebo::common::Image::RGB_INT16:
+              PixelConverter::narrow16(src, pixels, width*3);
+              break;
+            case gazebo::common::Image::BGR_INT16:
+              PixelConverter::narrow16(src, pixels, width*3);
+              PixelConverter::bgr_to_rgb(pixels, pixels, width);
+              break;
+          }
+        }
+        return pixbuf;
+      }
+
     private:
+      /** frees the pixel data wrapped by a Pixbuf
+       *  @param data the pixels
+       *  @param pixels the string holding the pixels
+       */
+      static void free_pixels(const guint8* /* data */, std::string *pixels) {
+        delete pixels;
+      }
+
       static std::string shift(unsigned int count) {
         std::string result = "";
         for(unsigned int i=0; i<count; i++) {
@@ -0,0 +1,163 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <map>
+#include <climits>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <gazebo/msgs/msgs.hh>
+
+namespace SceneReconstruction {
+/** @class DocumentIndex "documentindex.h"
+ *  Keeps SceneDocuments as serialized bytes, ordered by their timestamp.
+ *  Adding a document only reads its timestamp and skips the image and
+ *  the pointcloud without copying them, the document is decoded when it
+ *  is shown. Ids are given in the order the documents were added.
+ *  @author Bastian Klingen
+ */
+  class DocumentIndex {
+    public:
+      /** Constructor */
+      DocumentIndex() {}
+
+      /** adds a document
+       *  @param data the serialized SceneDocument, swapped into the index
+       *  @return id of the document
+       */
+      int add(std::string &data) {
+        int id = entries.size();
+        entries.push_back(Entry());
+        Entry &entry = entries.back();
+        entry.data.swap(data);
+        entry.timestamp = read_timestamp(entry.data);
+        // documents with the same timestamp keep the order they were added in
+        entry.position = by_time.insert(std::make_pair(entry.timestamp, id));
+        return id;
+      }
+
+      /** gets the number of documents
+       *  @return the number of documents
+       */
+      int size() const {
+        return entries.size();
+      }
+
+      /** gets the timestamp of a document
+       *  @param id id of the document
+       *  @return the timestamp
+       */
+      double timestamp(int id) const {
+        return entries[id].timestamp;
+      }
+
+      /** gets the document following another one in timestamp order
+       *  @param id id of the document
+       *  @return id of the next document or -1 for the last one
+       */
+      int next(int id) const {
+        TimeIndex::const_iterator i = entries[id].position;
+        i++;
+        return i == by_time.end() ? -1 : i->second;
+      }
+
+      /** gets the document preceding another one in timestamp order
+       *  @param id id of the document
+       *  @return id of the previous document or -1 for the first one
+       */
+      int previous(int id) const {
+        TimeIndex::const_iterator i = entries[id].position;
+        if(i == by_time.begin())
+          return -1;
+        i--;
+        return i->second;
+      }
+
+      /** decodes a document
+       *  @param id id of the document
+       *  @param doc upon return contains the document
+       *  @return false if the document could not be parsed
+       */
+      bool decode(int id, gazebo::msgs::SceneDocument &doc) const {
+        return doc.ParseFromString(entries[id].data);
+      }
+
+      /** removes all documents */
+      void clear() {
+        entries.clear();
+        by_time.clear();
+      }
+
+    private:
+      typedef std::multimap<double, int> TimeIndex;
+
+      /** a serialized document */
+      struct Entry {
+        double                     timestamp;
+        std::string                data;
+        /** position of the document in by_time */
+        TimeIndex::iterator        position;
+      };
+
+      /** reads the timestamp of a serialized SceneDocument, other fields are skipped
+       *  @param data the serialized document
+       *  @return the timestamp, 0 if it is missing
+       */
+      static double read_timestamp(const std::string &data) {
+        using google::protobuf::internal::WireFormatLite;
+        static const google::protobuf::FieldDescriptor *field = gazebo::msgs::SceneDocument::descriptor()->FindFieldByName("timestamp");
+
+        google::protobuf::io::CodedInputStream input((const google::protobuf::uint8*)data.data(), data.size());
+#if GOOGLE_PROTOBUF_VERSION >= 3006000
+        input.SetTotalBytesLimit(INT_MAX);
+#else
+        input.SetTotalBytesLimit(INT_MAX, INT_MAX);
+#endif
+        google::protobuf::uint32 tag;
+        while((tag = input.ReadTag()) != 0) {
+          if(WireFormatLite::GetTagFieldNumber(tag) == field->number()) {
+            // serializers write the field once, so the first one is the value
+            switch(WireFormatLite::GetTagWireType(tag)) {
+              case WireFormatLite::WIRETYPE_FIXED64: {
+                google::protobuf::uint64 value;
+                if(!input.ReadLittleEndian64(&value))
+                  return 0;
+                if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)
+                  return WireFormatLite::DecodeDouble(value);
+                return (double)(google::protobuf::int64)value;
+              }
+              case WireFormatLite::WIRETYPE_FIXED32: {
+                google::protobuf::uint32 value;
+                if(!input.ReadLittleEndian32(&value))
+                  return 0;
+                if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_FLOAT)
+                  return WireFormatLite::DecodeFloat(value);
+                return (double)(google::protobuf::int32)value;
+              }
+              case WireFormatLite::WIRETYPE_VARINT: {
+                google::protobuf::uint64 value;
+                if(!input.ReadVarint64(&value))
+                  return 0;
+                if(field->type() == google::protobuf::FieldDescriptor::TYPE_SINT64 || field->type() == google::protobuf::FieldDescriptor::TYPE_SINT32)
+                  return (double)WireFormatLite::ZigZagDecode64(value);
+                return (double)(google::protobuf::int64)value;
+              }
+              default:
+                return 0;
+            }
+          }
+          if(!WireFormatLite::SkipField(&input, tag))
+            break;
+        }
+        return 0;
+      }
+
+    private:
+      /** the documents by id, a deque never copies them when it grows */
+      std::deque<Entry>          entries;
+      /** ids of the documents by timestamp */
+      TimeIndex                  by_time;
+  };
+}
@@ -0,0 +1,185 @@
+#include "flightrecorder.h"
+
+#include <cstring>
+#include <fstream>
+#include <sys/time.h>
+
+using namespace SceneReconstruction;
+
+/** @class FlightRecorder "flightrecorder.h"
+ *  Always-on in-memory recorder that keeps the serialized messages of the
+ *  last seconds of traffic in a preallocated byte ring.
+ *  @author Bastian Klingen
+ */
+
+FlightRecorder::FlightRecorder(size_t capacity, double _window, size_t max_records)
+: slab(capacity), records(max_records)
+{
+  topics.reserve(64);
+  first = count = write = used = 0;
+  first_serial = pinned = 0;
+  dumping = false;
+  window = _window;
+  dropped_msgs = 0;
+}
+
+FlightRecorder::~FlightRecorder() {
+}
+
+double FlightRecorder::now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+size_t FlightRecorder::topic_index(const char *topic) {
+  // the caller's string may not outlive the call, so topics are copied
+  for(size_t i=0; i<topics.size(); i++) {
+    if(strcmp(topics[i].c_str(), topic) == 0)
+      return i;
+  }
+
+  topics.push_back(topic);
+  return topics.size()-1;
+}
+
+bool FlightRecorder::pinned_front() {
+  return dumping && first_serial >= pinned;
+}
+
+void FlightRecorder::pop_front() {
+  used -= records[first].length;
+  first = (first+1) % records.size();
+  first_serial++;
+  count--;
+}
+
+void FlightRecorder::expire(double time) {
+  // messages kept for a dump expire once they are written
+  while(count > 0 && records[first].time < time - window && !pinned_front())
+    pop_front();
+}
+
+void FlightRecorder::record(const char *topic, const google::protobuf::Message &msg) {
+  double time = now();
+  size_t length = msg.ByteSize();
+
+  boost::mutex::scoped_lock lock(recordMutex);
+  // a single message may not take more than half the ring
+  if(records.empty() || length > slab.size()/2) {
+    dropped_msgs++;
+    return;
+  }
+
+  expire(time);
+
+  // messages kept for a dump are not replaced, the new message is dropped
+  if(count == records.size()) {
+    if(pinned_front()) {
+      dropped_msgs++;
+      return;
+    }
+    pop_front();
+  }
+
+  if(write + length > slab.size()) {
+    // wrap around, everything stored behind the write position is the oldest data
+    while(count > 0 && records[first].offset >= write) {
+      if(pinned_front()) {
+        dropped_msgs++;
+        return;
+      }
+      pop_front();
+    }
+    write = 0;
+  }
+
+  // free the region the message will be written to
+  while(count > 0 && records[first].offset < write + length && records[first].offset + records[first].length > write) {
+    if(pinned_front()) {
+      dropped_msgs++;
+      return;
+    }
+    pop_front();
+  }
+
+  Record &r = records[(first+count) % records.size()];
+  r.time   = time;
+  r.topic  = topic_index(topic);
+  r.type   = msg.GetDescriptor();
+  r.offset = write;
+  r.length = length;
+  msg.SerializeWithCachedSizesToArray(reinterpret_cast<google::protobuf::uint8*>(&slab[0] + write));
+
+  write += length;
+  used  += length;
+  count++;
+}
+
+bool FlightRecorder::dump(std::string filename, size_t *messages) {
+  // only the range of messages is taken under the lock, the messages are
+  // pinned in the ring and written from there without copying the slab
+  unsigned long begin, end;
+  std::vector<std::string> names;
+  {
+    boost::mutex::scoped_lock lock(recordMutex);
+    if(dumping)
+      return false;
+    expire(now());
+    begin = first_serial;
+    end = first_serial + count;
+    pinned = begin;
+    dumping = true;
+    names = topics;
+  }
+
+  std::ofstream out;
+  out.open(filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+  if(!out.is_open()) {
+    boost::mutex::scoped_lock lock(recordMutex);
+    dumping = false;
+    return false;
+  }
+
+  // format: header line, then per message a text line
+  // "<time> <topic> <type> <length>" followed by <length> bytes of serialized data
+  out << "SceneReconstruction flight recorder, " << (end - begin) << " messages\n";
+  out.precision(6);
+  for(unsigned long serial = begin; serial < end; serial++) {
+    Record r;
+    {
+      // releases the messages written so far
+      boost::mutex::scoped_lock lock(recordMutex);
+      pinned = serial;
+      r = records[(first + (serial - first_serial)) % records.size()];
+    }
+    out << std::fixed << r.time << " " << names[r.topic] << " " << r.type->full_name() << " " << r.length << "\n";
+    out.write(&slab[0] + r.offset, r.length);
+    out << "\n";
+  }
+
+  {
+    boost::mutex::scoped_lock lock(recordMutex);
+    dumping = false;
+  }
+
+  if(messages)
+    *messages = end - begin;
+  out.close();
+  return !out.fail();
+}
+
+size_t FlightRecorder::size() {
+  boost::mutex::scoped_lock lock(recordMutex);
+  return count;
+}
+
+size_t FlightRecorder::bytes() {
+  boost::mutex::scoped_lock lock(recordMutex);
+  return used;
+}
+
+unsigned long FlightRecorder::dropped() {
+  boost::mutex::scoped_lock lock(recordMutex);
+  return dropped_msgs;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <google/protobuf/message.h>
+
+namespace SceneReconstruction {
+  /** @class FlightRecorder "flightrecorder.h"
+   *  Always-on in-memory recorder that keeps the serialized messages of the
+   *  last seconds of traffic in a preallocated byte ring. The ring is bounded
+   *  by bytes, by a number of records and by age. Once the slab and the record
+   *  table are allocated, recording does not allocate any further memory.
+   *  The content can be dumped to disk at any time.
+   *  @author Bastian Klingen
+   */
+  class FlightRecorder
+  {
+    public:
+      /** Constructor
+       *  @param capacity size of the byte ring in bytes
+       *  @param window number of seconds to keep messages
+       *  @param max_records maximal number of messages to keep
+       */
+      FlightRecorder(size_t, double, size_t);
+      /** Destructor */
+      ~FlightRecorder();
+
+      /** records a message, thread-safe
+       *  @param topic topic of the message, copied on its first use
+       *  @param msg the message to record
+       */
+      void record(const char*, const google::protobuf::Message&);
+
+      /** writes all currently recorded messages to a file, meant to be
+       *  called on a worker thread. The messages are written straight from
+       *  the ring, until a message is written it is kept and new messages
+       *  that would replace it are dropped. Only one dump runs at a time.
+       *  @param filename name of the file to write to
+       *  @param messages if not NULL receives the number of written messages
+       *  @return true if the file was written
+       */
+      bool dump(std::string, size_t *messages = NULL);
+
+      /** get the number of recorded messages
+       *  @return number of messages currently held in the ring
+       */
+      size_t size();
+
+      /** get the number of bytes used by recorded messages
+       *  @return number of bytes currently used in the ring
+       */
+      size_t bytes();
+
+      /** get the number of messages that were too big to be recorded
+       *  @return number of dropped messages
+       */
+      unsigned long dropped();
+
+    private:
+      /** header of a recorded message */
+      struct Record {
+        /** time of recording in seconds */
+        double                                 time;
+        /** index into the topic table */
+        size_t                                 topic;
+        /** message type */
+        const google::protobuf::Descriptor    *type;
+        /** offset of the serialized message in the slab */
+        size_t                                 offset;
+        /** length of the serialized message */
+        size_t                                 length;
+      };
+
+      size_t topic_index(const char*);
+      bool   pinned_front();
+      void   pop_front();
+      void   expire(double);
+      static double now();
+
+    private:
+      boost::mutex                       recordMutex;
+      std::vector<char>                  slab;
+      std::vector<Record>                records;
+      std::vector<std::string>           topics;
+      size_t                             first,
+                                         count,
+                                         write,
+                                         used;
+      /** serial of the oldest message */
+      unsigned long                      first_serial;
+      /** messages from this serial on are kept for the running dump */
+      unsigned long                      pinned;
+      bool                               dumping;
+      double                             window;
+      unsigned long                      dropped_msgs;
+  };
+}
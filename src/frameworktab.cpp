@@ -42,6 +42,7 @@ FrameworkTab::~FrameworkTab() {
 }
 
 void FrameworkTab::OnResponseMsg(ConstResponsePtr& _msg) {
+  logger->record("~/SceneReconstruction/GUI/MongoDB", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->responseMutex);
     this->responseMsgs.push_back(*_msg);
@@ -23,13 +23,56 @@
  */
 
 #include "graph_drawing_area.h"
-#include "gvplugin_cairo.h"
 
 #include <cmath>
+#include <algorithm>
 #include <libgen.h>
 #include <sys/time.h>
 
 using namespace SceneReconstruction;
+
+/** maximal number of pixels of the raster cache, bigger views are replayed directly */
+#define RASTER_CACHE_MAX_PIXELS (4096 * 4096)
+/** pixels rastered around the visible part of the graph, so panning copies pixels */
+#define RASTER_CACHE_MARGIN 256
+/** milliseconds without zooming until the raster is drawn at the new scale */
+#define RASTER_ZOOM_IDLE 150
+/** distance in pixels up to which an edge counts as hit */
+#define EDGE_HIT_TOLERANCE 4.0
+/** number of line pieces a bezier segment is split into for hit-testing */
+#define EDGE_HIT_STEPS 16
+
+namespace {
+  /** Squared distance of a point to a bezier segment.
+   * The segment is approximated by EDGE_HIT_STEPS line pieces.
+   * @param s the segment
+   * @param x x coordinate of the point
+   * @param y y coordinate of the point
+   * @return squared distance
+   */
+  double
+  segment_distance2(const CairoRenderInstructor::edge_segment &s, double x, double y)
+  {
+    double best = -1.0;
+    double px = s.x[0], py = s.y[0];
+    for (int i = 1; i <= EDGE_HIT_STEPS; ++i) {
+      double t = (double)i / EDGE_HIT_STEPS, u = 1.0 - t;
+      double qx = u*u*u*s.x[0] + 3*u*u*t*s.x[1] + 3*u*t*t*s.x[2] + t*t*t*s.x[3];
+      double qy = u*u*u*s.y[0] + 3*u*u*t*s.y[1] + 3*u*t*t*s.y[2] + t*t*t*s.y[3];
+      double dx = qx - px, dy = qy - py;
+      double len2 = dx*dx + dy*dy;
+      double f = len2 > 0 ? ((x - px)*dx + (y - py)*dy) / len2 : 0;
+      f = std::max(0.0, std::min(1.0, f));
+      double ex = px + f*dx - x, ey = py + f*dy - y;
+      double d2 = ex*ex + ey*ey;
+      if (best < 0 || d2 < best)  best = d2;
+      px = qx;
+      py = qy;
+    }
+    return best;
+  }
+}
+
 /** @class GraphDrawingArea "graph_drawing_area.h"
  * Graph drawing area.
  * Derived version of Gtk::DrawingArea that renders a graph via Graphviz.
@@ -41,19 +84,25 @@ GraphDrawingArea::GraphDrawingArea()
 {
   add_events(Gdk::SCROLL_MASK | Gdk::BUTTON_MOTION_MASK);
 
-  __gvc = gvContext();
+  __layouter = new GraphLayouter();
+  __layouter->signal_ready.connect(sigc::mem_fun(*this, &GraphDrawingArea::on_layout_ready));
+  __raster_scale = 0.0;
+  __raster_x = __raster_y = __raster_w = __raster_h = 0.0;
+  __zoom_scale = 0.0;
+  __origin_x = __origin_y = 0.0;
+  __hover_node = -1;
 
   __graph_fsm = "";
   __graph = "";
+  __native = __nonupd_native = false;
 
   __bbw = __bbh = __pad_x = __pad_y = 0.0;
   __translation_x = __translation_y = 0.0;
   __scale = 1.0;
   __scale_override = false;
+  __fit_pending = false;
   __update_graph = true;
 
-  gvplugin_cairo_setup(__gvc, this);
-
   __fcd_save = new Gtk::FileChooserDialog("Save Graph",
 					  Gtk::FILE_CHOOSER_ACTION_SAVE);
   __fcd_open = new Gtk::FileChooserDialog("Load Graph",
@@ -87,15 +136,18 @@ GraphDrawingArea::GraphDrawingArea()
   __fcd_open->set_filter(__filter_dot);
 
   add_events(Gdk::SCROLL_MASK | Gdk::BUTTON_MOTION_MASK |
-	     Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK );
+	     Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK |
+	     Gdk::POINTER_MOTION_MASK | Gdk::LEAVE_NOTIFY_MASK );
 
   signal_button_press_event().connect(sigc::mem_fun(*this, &GraphDrawingArea::on_button_press_event));
   signal_motion_notify_event().connect(sigc::mem_fun(*this, &GraphDrawingArea::on_motion_notify_event));
+  signal_leave_notify_event().connect(sigc::mem_fun(*this, &GraphDrawingArea::on_leave_notify_event));
 }
 
 GraphDrawingArea::~GraphDrawingArea()
 {
-  gvFreeContext(__gvc);
+  __raster_timeout.disconnect();
+  delete __layouter;
   //delete __fcd;
   delete __fcd_save;
   delete __fcd_open;
@@ -116,6 +168,18 @@ GraphDrawingArea::signal_update_disabled()
 }
 
 
+/** Get "layout positions" signal.
+ * Emitted with the positions of the nodes whenever a native layout was
+ * taken, so that they can be kept for the next layout.
+ * @return "layout positions" signal
+ */
+sigc::signal<void, const std::vector<KIDLayout::Node>&>
+GraphDrawingArea::signal_layout_positions()
+{
+  return __signal_layout_positions;
+}
+
+
 /** Set graph's FSM name.
  * @param fsm_name name of FSM the graph belongs to
  */
@@ -125,6 +189,7 @@ GraphDrawingArea::set_graph_fsm(std::string fsm_name)
   if ( __update_graph ) {
     if ( __graph_fsm != fsm_name ) {
       __scale_override = false;
+      __fit_pending = true;
     }
     __graph_fsm = fsm_name;
   } else {
@@ -140,81 +205,70 @@ void
 GraphDrawingArea::set_graph(std::string graph)
 {
   if ( __update_graph ) {
-    __graph = graph;
-    queue_draw();
+    if ( __graph != graph || __native ) {
+      __graph = graph;
+      __native = false;
+      __kid_graph = KIDLayout::Graph();
+      request_layout();
+      queue_draw();
+    }
   } else {
     __nonupd_graph = graph;
+    __nonupd_native = false;
   }
 }
 
-/** Set bounding box.
- * To be called only by the Graphviz plugin.
- * @param bbw bounding box width
- * @param bbh bounding box height
- */
-void
-GraphDrawingArea::set_bb(double bbw, double bbh)
-{
-  __bbw = bbw;
-  __bbh = bbh;
-}
-
 
-/** Set padding.
- * To be called only by the Graphviz plugin.
- * @param pad_x padding in x
- * @param pad_y padding in y
+/** Set KID graph laid out by the native KIDLayout.
+ * @param graph string representation of the graph in the dot language, used for saving
+ * @param kid snapshot of the KID graph to lay out
  */
 void
-GraphDrawingArea::set_pad(double pad_x, double pad_y)
+GraphDrawingArea::set_graph(std::string graph, const KIDLayout::Graph &kid)
 {
-  __pad_x = pad_x;
-  __pad_y = pad_y;
-}
-
-
-/** Get padding.
- * To be called only by the Graphviz plugin.
- * @param pad_x upon return contains padding in x
- * @param pad_y upon return contains padding in y
- */
-void
-GraphDrawingArea::get_pad(double &pad_x, double &pad_y)
-{
-  if (__scale_override) {
-    pad_x = pad_y = 0;
+  if ( __update_graph ) {
+    if ( ! __native || ! (__kid_graph == kid) ) {
+      __graph = graph;
+      __kid_graph = kid;
+      __native = true;
+      request_layout();
+      queue_draw();
+    }
   } else {
-    pad_x = __pad_x;
-    pad_y = __pad_y;
+    __nonupd_graph = graph;
+    __nonupd_kid_graph = kid;
+    __nonupd_native = true;
   }
 }
 
 
-/** Set translation.
- * To be called only by the Graphviz plugin.
- * @param tx translation in x
- * @param ty translation in y
- */
+/** Request the layout of the current graph from the layouter. */
 void
-GraphDrawingArea::set_translation(double tx, double ty)
+GraphDrawingArea::request_layout()
 {
-  __translation_x = tx;
-  __translation_y = ty;
+  if (__native) {
+    __layouter->request(__kid_graph);
+  } else {
+    __layouter->request(__graph);
+  }
 }
 
 
-/** Set scale.
- * To be called only by the Graphviz plugin.
- * @param scale scale value
+/** Lay out the current graph from scratch.
+ * The native layout drops the positions it kept from the previous
+ * layouts, Graphviz lays out every graph from scratch anyway.
  */
 void
-GraphDrawingArea::set_scale(double scale)
+GraphDrawingArea::relayout()
 {
-  __scale = scale;
+  if (__native) {
+    __layouter->request(__kid_graph, true);
+  } else {
+    __layouter->request(__graph);
+  }
 }
 
 /** Get scale.
- * To be called only by the Graphviz plugin.
  * @return scale value
  */
 double
@@ -280,12 +334,13 @@ GraphDrawingArea::zoom_out()
 
 
 /** Zoom to fit.
- * Disables scale override and draws with values suggested by Graphviz plugin.
+ * Disables scale override and fits the graph into the widget.
  */
 void
 GraphDrawingArea::zoom_fit()
 {
   __scale_override = false;
+  __fit_pending = true;
   queue_draw();
 }
 
@@ -305,29 +360,6 @@ GraphDrawingArea::zoom_reset()
 }
 
 
-/** Check if scale override is enabled.
- * @return true if scale override is enabled, false otherwise
- */
-bool
-GraphDrawingArea::scale_override()
-{
-  return __scale_override;
-}
-
-
-/** Get Cairo context.
- * This is only valid during the expose event and is only meant for the
- * Graphviz plugin.
- * @return Cairo context
- */
-Cairo::RefPtr<Cairo::Context>
-GraphDrawingArea::get_cairo()
-{
-  return __cairo;
-}
-
-
-
 /** Check if graph is being updated.
  * @return true if the graph will be update if new data is received, false otherwise
  */
@@ -347,15 +379,219 @@ GraphDrawingArea::set_update_graph(bool update)
   if (update && ! __update_graph) {
     if ( __graph_fsm != __nonupd_graph_fsm ) {
       __scale_override = false;
+      __fit_pending = true;
     }
     __graph     = __nonupd_graph;
     __graph_fsm = __nonupd_graph_fsm;
+    __native    = __nonupd_native;
+    __kid_graph = __nonupd_kid_graph;
+    request_layout();
     queue_draw();
   }
   __update_graph = update;
 }
 
 
+/** Take the rendering of the latest graph from the layouter.
+ * Called on the GTK thread when the layout worker finished. Native
+ * layouts keep the nodes in place, so unless a fit was requested the
+ * top left corner of the graph stays where it is on screen.
+ */
+void
+GraphDrawingArea::on_layout_ready()
+{
+  GraphRenderingPtr rendering = __layouter->take();
+  if (! rendering)  return;
+
+  bool keep_view = ! __fit_pending && rendering->recording && ! rendering->kid_nodes.empty()
+                   && __rendering && __rendering->recording && ! __rendering->kid_nodes.empty();
+  double left = __origin_x - __pad_x * __scale;
+  double top  = __origin_y - (__bbh - __pad_y) * __scale;
+
+  __rendering = rendering;
+  __raster.clear();
+  __hover_node = -1;
+  __hover_segments.clear();
+  if (__rendering->recording) {
+    __bbw   = __rendering->bbw;
+    __bbh   = __rendering->bbh;
+    __pad_x = __rendering->pad_x;
+    __pad_y = __rendering->pad_y;
+  }
+  if (keep_view) {
+    __scale_override = true;
+    __translation_x = left + __pad_x * __scale;
+    __translation_y = top + (__bbh - __pad_y) * __scale;
+  }
+  __fit_pending = false;
+  if (! __rendering->kid_nodes.empty())  __signal_layout_positions.emit(__rendering->kid_nodes);
+  queue_draw();
+}
+
+
+/** Compute scale and translation to fit the graph into the widget.
+ * Same as the Graphviz plugin does when the scale is not overridden.
+ */
+void
+GraphDrawingArea::fit_graph()
+{
+  double avwidth, avheight;
+  get_dimensions(avwidth, avheight);
+
+  float zoom_w = avwidth  / __bbw;
+  float zoom_h = avheight / __bbh;
+  float zoom   = std::min(zoom_w, zoom_h);
+
+  if (__bbw > avwidth || __bbh > avheight) {
+    float zwidth  = __bbw * zoom;
+    float zheight = __bbh * zoom;
+    __translation_x = (avwidth  - zwidth ) / 2.;
+    __translation_y = (avheight - zheight) / 2. + zheight;
+  } else {
+    zoom = 1.0;
+    __translation_x = (avwidth  - __bbw) / 2.;
+    __translation_y = (avheight - __bbh) / 2. + __bbh;
+  }
+  __scale = zoom;
+}
+
+
+/** Paint the recorded graph with the current scale and translation.
+ * A raster of the visible part of the graph and a margin around it is
+ * kept, so translations only copy pixels until the view leaves it.
+ * While zooming, the raster is scaled and only drawn again at the new
+ * scale once the zoom is idle for RASTER_ZOOM_IDLE ms. Views too big
+ * for the raster are replayed from the recording, cairo skips the
+ * recorded commands outside of the clip region. Below
+ * GVPLUGIN_CAIRO_LOD_SCALE the simplified overview is painted instead
+ * of the recording.
+ * @param cr cairo context to paint to
+ */
+void
+GraphDrawingArea::paint_graph(const Cairo::RefPtr<Cairo::Context> &cr)
+{
+  // the fitted translation does not contain the padding
+  double pad_x = __scale_override ? 0 : __pad_x;
+  double pad_y = __scale_override ? 0 : __pad_y;
+  __origin_x = __translation_x + pad_x * __scale;
+  __origin_y = __translation_y - pad_y * __scale;
+  // text is unreadable when zoomed out that far, the overview is much cheaper
+  Cairo::RefPtr<Cairo::Surface> recording = __rendering->recording;
+  if (__scale < GVPLUGIN_CAIRO_LOD_SCALE && __rendering->overview)  recording = __rendering->overview;
+  double ink_x = __rendering->ink_x;
+  double ink_y = __rendering->ink_y;
+
+  // graph units of the recording relative to the origin of the graph
+  double rec_x = __pad_x;
+  double rec_y = __bbh - __pad_y;
+
+  if (__raster && __raster_scale != __scale) {
+    // scaling the old raster is cheap, drawing it again waits for the zoom to end
+    if (! __raster_timeout.connected() || __zoom_scale != __scale) {
+      __raster_timeout.disconnect();
+      __raster_timeout = Glib::signal_timeout().connect(sigc::mem_fun(*this, &GraphDrawingArea::on_raster_timeout), RASTER_ZOOM_IDLE);
+      __zoom_scale = __scale;
+    }
+    cr->save();
+    cr->translate(__origin_x + (__raster_x - rec_x) * __scale,
+                  __origin_y + (__raster_y - rec_y) * __scale);
+    cr->scale(__scale / __raster_scale, __scale / __raster_scale);
+    cr->set_source(__raster, 0, 0);
+    cr->paint();
+    cr->restore();
+    return;
+  }
+
+  // visible part of the ink in recording units
+  double margin = RASTER_CACHE_MARGIN / __scale;
+  double vis_x1 = std::max(ink_x, rec_x - __origin_x / __scale);
+  double vis_y1 = std::max(ink_y, rec_y - __origin_y / __scale);
+  double vis_x2 = std::min(ink_x + __rendering->ink_w, rec_x + (get_allocated_width()  - __origin_x) / __scale);
+  double vis_y2 = std::min(ink_y + __rendering->ink_h, rec_y + (get_allocated_height() - __origin_y) / __scale);
+  if (vis_x1 >= vis_x2 || vis_y1 >= vis_y2)  return;
+
+  if (! __raster || vis_x1 < __raster_x || vis_y1 < __raster_y ||
+      vis_x2 > __raster_x + __raster_w || vis_y2 > __raster_y + __raster_h) {
+    // whole pixels from the corner of the ink, so rasters drawn after panning line up
+    double x1 = ink_x + floor((std::max(ink_x, vis_x1 - margin) - ink_x) * __scale) / __scale;
+    double y1 = ink_y + floor((std::max(ink_y, vis_y1 - margin) - ink_y) * __scale) / __scale;
+    double x2 = std::min(ink_x + __rendering->ink_w, vis_x2 + margin);
+    double y2 = std::min(ink_y + __rendering->ink_h, vis_y2 + margin);
+    int width  = (int)ceil((x2 - x1) * __scale);
+    int height = (int)ceil((y2 - y1) * __scale);
+    __raster.clear();
+    if (width > 0 && height > 0 && (double)width * height <= RASTER_CACHE_MAX_PIXELS) {
+      __raster = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, height);
+      Cairo::RefPtr<Cairo::Context> rc = Cairo::Context::create(__raster);
+      rc->scale(__scale, __scale);
+      rc->set_source(recording, -x1, -y1);
+      rc->paint();
+      __raster_scale = __scale;
+      __raster_x = x1;
+      __raster_y = y1;
+      __raster_w = width / __scale;
+      __raster_h = height / __scale;
+    }
+  }
+
+  if (__raster) {
+    cr->set_source(__raster,
+                   floor(__origin_x + (__raster_x - rec_x) * __scale + 0.5),
+                   floor(__origin_y + (__raster_y - rec_y) * __scale + 0.5));
+    cr->paint();
+  } else {
+    cr->save();
+    cr->translate(__origin_x, __origin_y);
+    cr->scale(__scale, __scale);
+    cr->set_source(recording, -rec_x, -rec_y);
+    cr->paint();
+    cr->restore();
+  }
+}
+
+
+/** Draw the raster again at the current scale.
+ * Called when the zoom was idle for RASTER_ZOOM_IDLE ms.
+ * @return false to stop the timeout
+ */
+bool
+GraphDrawingArea::on_raster_timeout()
+{
+  __raster.clear();
+  queue_draw();
+  return false;
+}
+
+
+/** Highlight the node or edge under the mouse pointer.
+ * @param cr cairo context to paint to
+ */
+void
+GraphDrawingArea::paint_hover(const Cairo::RefPtr<Cairo::Context> &cr)
+{
+  if (__hover_node < 0 && __hover_segments.empty())  return;
+
+  cr->save();
+  cr->translate(__origin_x, __origin_y);
+  cr->scale(__scale, __scale);
+  cr->translate(-__pad_x, -(__bbh - __pad_y));
+  cr->set_source_rgba(0.2, 0.4, 1.0, 0.5);
+  cr->set_line_width(3.0 / __scale);
+
+  if (__hover_node >= 0) {
+    const HitGrid::Box &b = __rendering->node_grid.get_box(__hover_node);
+    cr->rectangle(b.x1, b.y1, b.x2 - b.x1, b.y2 - b.y1);
+  }
+  for (size_t i = 0; i < __hover_segments.size(); ++i) {
+    const CairoRenderInstructor::edge_segment &s = __rendering->edge_segments[__hover_segments[i]];
+    cr->move_to(s.x[0], s.y[0]);
+    cr->curve_to(s.x[1], s.y[1], s.x[2], s.y[2], s.x[3], s.y[3]);
+  }
+  cr->stroke();
+  cr->restore();
+}
+
+
 void
 GraphDrawingArea::save_dotfile(const char *filename)
 {
@@ -385,52 +621,17 @@ GraphDrawingArea::save()
     if (filename != "") {
       if (f == __filter_dot) {
       	save_dotfile(filename.c_str());
-      } else {
-      	Cairo::RefPtr<Cairo::Surface> surface;
-
-      	bool write_to_png = false;
+      } else if (__rendering) {
+	      // the recording is in graph units, vector formats stay vector
+	      std::string format;
 	      if (f == __filter_pdf) {
-	        surface = Cairo::PdfSurface::create(filename, __bbw, __bbh);
+	        format = "pdf";
 	      } else if (f == __filter_svg) {
-	        surface = Cairo::SvgSurface::create(filename, __bbw, __bbh);
+	        format = "svg";
 	      } else if (f == __filter_png) {
-	        surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32,
-          				(int)ceilf(__bbw),
-						      (int)ceilf(__bbh));
-	        write_to_png = true;
-	      }
-
-	      if (surface) {
-	        __cairo = Cairo::Context::create(surface);
-	        
-	        bool old_scale_override = __scale_override;
-	        double old_tx = __translation_x;
-	        double old_ty = __translation_y;
-	        double old_scale = __scale;
-	        __translation_x = __pad_x;
-	        __translation_y = __bbh - __pad_y;
-	        __scale = 1.0;
-	        __scale_override = true;
-
-	        Agraph_t *g = agmemread((char *)__graph.c_str());
-	        if (g) {
-	          gvLayout(__gvc, g, (char *)"dot");
-	          gvRender(__gvc, g, (char *)"cairo", NULL);
-	          gvFreeLayout(__gvc, g);
-	          agclose(g);
-	        }
-
-	        if (write_to_png) {
-	          surface->write_to_png(filename);
-	        }
-
-	        __cairo.clear();
-
-	        __translation_x = old_tx;
-	        __translation_y = old_ty;
-	        __scale = old_scale;
-	        __scale_override = old_scale_override;
+	        format = "png";
 	      }
+	      GraphLayouter::write(*__rendering, filename, format);
       }
 
     } else {
@@ -471,6 +672,8 @@ GraphDrawingArea::open()
       }
     }
     fclose(f);
+    __native = false;
+    request_layout();
     __signal_update_disabled.emit();
     queue_draw();
   }
@@ -489,7 +692,6 @@ GraphDrawingArea::on_draw(const Cairo::RefPtr<Cairo::Context> &cr)
   // This is where we draw on the window
   Glib::RefPtr<Gdk::Window> window = get_window();
   if(window) {
-    clickable_nodes.clear();
     //Gtk::Allocation allocation = get_allocation();
     //const int width = allocation.get_width();
     //const int height = allocation.get_height();
@@ -498,19 +700,23 @@ GraphDrawingArea::on_draw(const Cairo::RefPtr<Cairo::Context> &cr)
     //int xc, yc;
     //xc = width / 2;
     //yc = height / 2;
-    __cairo = cr;
-    __cairo->set_source_rgb(1, 1, 1);
-    __cairo->paint();
-
-    Agraph_t *g = agmemread((char *)__graph.c_str());
-    if (g) {
-      gvLayout(__gvc, g, (char *)"dot");
-      gvRender(__gvc, g, (char *)"cairo", NULL);
-      gvFreeLayout(__gvc, g);
-      agclose(g);
+    cr->set_source_rgb(1, 1, 1);
+    cr->paint();
+
+    if (__rendering && __rendering->recording) {
+      if (! __scale_override)  fit_graph();
+      paint_graph(cr);
+      paint_hover(cr);
     }
 
-    __cairo.clear();
+    // the previous drawing stays until the layout of the new graph is done
+    if (__layouter->pending()) {
+      cr->select_font_face("sans", Cairo::FONT_SLANT_ITALIC, Cairo::FONT_WEIGHT_NORMAL);
+      cr->set_font_size(12);
+      cr->set_source_rgba(0.3, 0.3, 0.3, 0.8);
+      cr->move_to(8, 18);
+      cr->show_text("layout pending...");
+    }
   }    
 
   return true;
@@ -552,6 +758,12 @@ GraphDrawingArea::on_button_press_event(GdkEventButton *event)
 bool
 GraphDrawingArea::on_motion_notify_event(GdkEventMotion *event)
 {
+  if (! (event->state & (GDK_BUTTON1_MASK | GDK_BUTTON2_MASK | GDK_BUTTON3_MASK))) {
+    int node = find_node(event->x, event->y);
+    set_hover(node, node < 0 ? find_edge(event->x, event->y) : -1);
+    return true;
+  }
+
   __scale_override = true;
   __translation_x -= __last_mouse_x - event->x;
   __translation_y -= __last_mouse_y - event->y;
@@ -562,6 +774,110 @@ GraphDrawingArea::on_motion_notify_event(GdkEventMotion *event)
 }
 
 
+/** Leave notify event handler.
+ * @param event event data
+ * @return true
+ */
+bool
+GraphDrawingArea::on_leave_notify_event(GdkEventCrossing * /* event */)
+{
+  set_hover(-1, -1);
+  return true;
+}
+
+
+/** Convert widget coordinates to the graph units of the recording.
+ * @param x x coordinate, upon return in graph units
+ * @param y y coordinate, upon return in graph units
+ */
+void
+GraphDrawingArea::to_graph_units(double &x, double &y)
+{
+  x = (x - __origin_x) / __scale + __pad_x;
+  y = (y - __origin_y) / __scale + __bbh - __pad_y;
+}
+
+
+/** Find the node at a position.
+ * Nodes with overlapping boxes resolve to the smallest box.
+ * @param x x coordinate in the widget
+ * @param y y coordinate in the widget
+ * @return index of the node box or -1
+ */
+int
+GraphDrawingArea::find_node(double x, double y)
+{
+  if (! __rendering || __scale <= 0.0)  return -1;
+  to_graph_units(x, y);
+
+  __rendering->node_grid.query(x, y, __hits);
+  int found = -1;
+  double found_area = 0;
+  for (size_t i = 0; i < __hits.size(); ++i) {
+    const HitGrid::Box &b = __rendering->node_grid.get_box(__hits[i]);
+    double area = (b.x2 - b.x1) * (b.y2 - b.y1);
+    if (found < 0 || area < found_area) {
+      found = __hits[i];
+      found_area = area;
+    }
+  }
+  return found;
+}
+
+
+/** Find the edge segment next to a position.
+ * The grid yields the segments whose control point box is within the
+ * tolerance, the closest curve within the tolerance wins.
+ * @param x x coordinate in the widget
+ * @param y y coordinate in the widget
+ * @return index of the edge segment or -1
+ */
+int
+GraphDrawingArea::find_edge(double x, double y)
+{
+  if (! __rendering || __scale <= 0.0)  return -1;
+  to_graph_units(x, y);
+
+  double tolerance = EDGE_HIT_TOLERANCE / __scale;
+  __rendering->edge_grid.query(HitGrid::Box(x - tolerance, y - tolerance, x + tolerance, y + tolerance), __hits);
+  int found = -1;
+  double found_d2 = tolerance * tolerance;
+  for (size_t i = 0; i < __hits.size(); ++i) {
+    double d2 = segment_distance2(__rendering->edge_segments[__hits[i]], x, y);
+    if (d2 <= found_d2) {
+      found = __hits[i];
+      found_d2 = d2;
+    }
+  }
+  return found;
+}
+
+
+/** Set the highlighted node or edge.
+ * @param node index of the node box or -1
+ * @param edge index of an edge segment or -1, all segments of its edge are highlighted
+ */
+void
+GraphDrawingArea::set_hover(int node, int edge)
+{
+  // the plugin stores the segments of an edge one after another
+  std::vector<int> segments;
+  if (edge >= 0) {
+    const std::vector<CairoRenderInstructor::edge_segment> &all = __rendering->edge_segments;
+    int first = edge, last = edge;
+    while (first > 0 && all[first - 1].edge == all[edge].edge)  --first;
+    while (last + 1 < (int)all.size() && all[last + 1].edge == all[edge].edge)  ++last;
+    for (int i = first; i <= last; ++i)  segments.push_back(i);
+  }
+
+  if (node != __hover_node || segments != __hover_segments) {
+    __hover_node = node;
+    __hover_segments.swap(segments);
+    queue_draw();
+  }
+}
+
+
 /** getter for the label of the clicked node
  *  @param x x coord of the click
  *  @param y y coord of the click
@@ -569,13 +885,18 @@ GraphDrawingArea::on_motion_notify_event(GdkEventMotion *event)
  */
 std::string
 GraphDrawingArea::get_clicked_node(double x, double y) {
-  std::map<std::string, box>::iterator bb;
-  for(bb = clickable_nodes.begin(); bb != clickable_nodes.end(); bb++) {
-    if(bb->second.x1 <= x && bb->second.y1 <= y && bb->second.x2 >= x && bb->second.y2 >= y) {
-      return bb->first;
-    }
-  }
-  
-  return "";
+  int node = find_node(x, y);
+  return node < 0 ? "" : __rendering->node_names[node];
 }
 
+
+/** getter for the clicked edge
+ *  @param x x coord of the click
+ *  @param y y coord of the click
+ *  @return the clicked edge as "from" --"label"--> "to" if it was an edge
+ */
+std::string
+GraphDrawingArea::get_clicked_edge(double x, double y) {
+  int edge = find_edge(x, y);
+  return edge < 0 ? "" : __rendering->edge_segments[edge].edge;
+}
@@ -25,21 +25,20 @@
 
 #include <gtkmm.h>
 
-#include <gvc.h>
-#include <gvcjob.h>
-
-#include "gvplugin_cairo.h"
+#include "graph_layouter.h"
 
 namespace SceneReconstruction {
   /** @class GraphDrawingArea "graph_drawing_area.h"
    * Graph drawing area.
    * Derived version of Gtk::DrawingArea that renders a graph via Graphviz.
+   * The layout runs on a GraphLayouter thread, until it is finished the
+   * previous drawing is shown with a pending indicator. KID graphs can
+   * be laid out by the native KIDLayout instead.
    * @author Tim Niemueller
    * @author Bastian Klingen
    */
   class GraphDrawingArea
-  : public Gtk::DrawingArea,
-    public CairoRenderInstructor
+  : public Gtk::DrawingArea
   {
    public:
 
@@ -62,7 +61,7 @@ namespace SceneReconstruction {
      */
     void zoom_out();
     /** Zoom to fit.
-     * Disables scale override and draws with values suggested by Graphviz plugin.
+     * Disables scale override and fits the graph into the widget.
      */
     void zoom_fit();
     /** Zoom reset.
@@ -78,36 +77,13 @@ namespace SceneReconstruction {
      * @param graph string representation of the current graph in the dot language.
      */
     void set_graph(std::string graph);
+    /** Set KID graph laid out by the native KIDLayout.
+     * @param graph string representation of the graph in the dot language, used for saving
+     * @param kid snapshot of the KID graph to lay out
+     */
+    void set_graph(std::string graph, const KIDLayout::Graph &kid);
 
-    /** Set bounding box.
-     * To be called only by the Graphviz plugin.
-     * @param bbw bounding box width
-     * @param bbh bounding box height
-     */
-    void   set_bb(double bbw, double bbh);
-    /** Set padding.
-     * To be called only by the Graphviz plugin.
-     * @param pad_x padding in x
-     * @param pad_y padding in y
-     */
-    void   set_pad(double pad_x, double pad_y);
-    /** Set translation.
-     * To be called only by the Graphviz plugin.
-     * @param tx translation in x
-     * @param ty translation in y
-     */
-    void   set_translation(double tx, double ty);
-    /** Set scale.
-     * To be called only by the Graphviz plugin.
-     * @param scale scale value
-     */
-    void   set_scale(double scale);
-    /** Check if scale override is enabled.
-     * @return true if scale override is enabled, false otherwise
-     */
-    bool   scale_override();
     /** Get scale.
-     * To be called only by the Graphviz plugin.
      * @return scale value
      */
     double get_scale();
@@ -121,18 +97,6 @@ namespace SceneReconstruction {
      * @param height upon return contains height
      */
     void   get_dimensions(double &width, double &height);
-    /** Get padding.
-     * To be called only by the Graphviz plugin.
-     * @param pad_x upon return contains padding in x
-     * @param pad_y upon return contains padding in y
-     */
-    void   get_pad(double &pad_x, double &pad_y);
-    /** Get Cairo context.
-     * This is only valid during the expose event and is only meant for the
-     * Graphviz plugin.
-     * @return Cairo context
-     */
-    Cairo::RefPtr<Cairo::Context> get_cairo();
 
     /** Check if graph is being updated.
      * @return true if the graph will be update if new data is received, false otherwise
@@ -147,6 +111,13 @@ namespace SceneReconstruction {
      * @return "update disabled" signal
      */
     sigc::signal<void> signal_update_disabled();
+    /** Get "layout positions" signal.
+     * @return signal emitted with the node positions of each native layout
+     */
+    sigc::signal<void, const std::vector<KIDLayout::Node>&> signal_layout_positions();
+
+    /** Lay out the current graph from scratch, dropping kept positions. */
+    void relayout();
 
     /** getter for the label of the clicked node
      *  @param x x coord of the click
@@ -154,6 +125,12 @@ namespace SceneReconstruction {
      *  @return the label of the clicked node if it was a node
      */
     std::string get_clicked_node(double x, double y);
+    /** getter for the clicked edge
+     *  @param x x coord of the click
+     *  @param y y coord of the click
+     *  @return the clicked edge as "from" --"label"--> "to" if it was an edge
+     */
+    std::string get_clicked_edge(double x, double y);
 
    protected:
     /** Draw event handler.
@@ -176,12 +153,26 @@ namespace SceneReconstruction {
      * @return true
      */
     virtual bool on_motion_notify_event(GdkEventMotion *event);
+    /** Leave notify event handler.
+     * @param event event data
+     * @return true
+     */
+    virtual bool on_leave_notify_event(GdkEventCrossing *event);
 
    private:
     void save_dotfile(const char *filename);
+    void request_layout();
+    void on_layout_ready();
+    void fit_graph();
+    void paint_graph(const Cairo::RefPtr<Cairo::Context> &cr);
+    bool on_raster_timeout();
+    void paint_hover(const Cairo::RefPtr<Cairo::Context> &cr);
+    void to_graph_units(double &x, double &y);
+    int  find_node(double x, double y);
+    int  find_edge(double x, double y);
+    void set_hover(int node, int edge);
 
    private:
-    Cairo::RefPtr<Cairo::Context> __cairo;
     Gtk::FileChooserDialog *__fcd_save;
     Gtk::FileChooserDialog *__fcd_open;
     Glib::RefPtr<Gtk::FileFilter> __filter_pdf;
@@ -189,13 +180,34 @@ namespace SceneReconstruction {
     Glib::RefPtr<Gtk::FileFilter> __filter_png;
     Glib::RefPtr<Gtk::FileFilter> __filter_dot;
     sigc::signal<void> __signal_update_disabled;
-
-    GVC_t *__gvc;
+    sigc::signal<void, const std::vector<KIDLayout::Node>&> __signal_layout_positions;
+
+    GraphLayouter *__layouter;
+    GraphRenderingPtr __rendering;
+
+    Cairo::RefPtr<Cairo::ImageSurface> __raster;
+    double __raster_scale;
+    double __raster_x;
+    double __raster_y;
+    double __raster_w;
+    double __raster_h;
+    sigc::connection __raster_timeout;
+    double __zoom_scale;
+    double __origin_x;
+    double __origin_y;
+
+    int __hover_node;
+    std::vector<int> __hover_segments;
+    std::vector<int> __hits;
 
     std::string __graph_fsm;
     std::string __graph;
     std::string __nonupd_graph;
     std::string __nonupd_graph_fsm;
+    KIDLayout::Graph __kid_graph;
+    KIDLayout::Graph __nonupd_kid_graph;
+    bool __native;
+    bool __nonupd_native;
 
     double __bbw;
     double __bbh;
@@ -209,6 +221,7 @@ namespace SceneReconstruction {
     double __last_mouse_y;
 
     bool __scale_override;
+    bool __fit_pending;
     bool __update_graph;
   };
 }
@@ -0,0 +1,496 @@
+#include "graph_layouter.h"
+
+#include <cairo.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace SceneReconstruction;
+
+namespace {
+  /** Render instructor that records a graph in graph units.
+   *  The scale is fixed to 1 and the translation maps the bounding box
+   *  of the graph to the origin of the recording. The overview is
+   *  recorded in the same pass.
+   */
+  class GraphRecorder : public CairoRenderInstructor
+  {
+    public:
+      GraphRecorder(Cairo::RefPtr<Cairo::Context> cr, Cairo::RefPtr<Cairo::Context> ov)
+      : cairo(cr), overview(ov), bbw(0), bbh(0), pad_x(0), pad_y(0) {}
+
+      Cairo::RefPtr<Cairo::Context> get_cairo() { return cairo; }
+      Cairo::RefPtr<Cairo::Context> get_overview() { return overview; }
+
+      bool   scale_override() { return true; }
+      void   get_dimensions(double &width, double &height) { width = bbw; height = bbh; }
+      double get_scale() { return 1.0; }
+      void   set_scale(double /* scale */) {}
+      void   get_translation(double &tx, double &ty) { tx = pad_x; ty = bbh - pad_y; }
+      void   set_translation(double /* tx */, double /* ty */) {}
+      void   set_bb(double w, double h) { bbw = w; bbh = h; }
+      void   set_pad(double x, double y) { pad_x = x; pad_y = y; }
+      void   get_pad(double &x, double &y) { x = y = 0; }
+
+    public:
+      Cairo::RefPtr<Cairo::Context> cairo;
+      Cairo::RefPtr<Cairo::Context> overview;
+      double bbw, bbh, pad_x, pad_y;
+  };
+
+  /** Build the hit-test grids of a rendering.
+   * @param r rendering with its edge segments set
+   * @param nodes label boxes of the nodes in graph units
+   */
+  void
+  build_index(GraphRendering &r, const std::map<std::string, CairoRenderInstructor::box> &nodes)
+  {
+    std::map<std::string, CairoRenderInstructor::box>::const_iterator n;
+    for (n = nodes.begin(); n != nodes.end(); ++n) {
+      r.node_names.push_back(n->first);
+      r.node_grid.add(HitGrid::Box(n->second.x1, n->second.y1, n->second.x2, n->second.y2));
+    }
+    r.node_grid.build();
+
+    for (size_t i = 0; i < r.edge_segments.size(); ++i) {
+      const CairoRenderInstructor::edge_segment &s = r.edge_segments[i];
+      HitGrid::Box b(s.x[0], s.y[0], s.x[0], s.y[0]);
+      for (int j = 1; j < 4; ++j) {
+        b.x1 = std::min(b.x1, s.x[j]);
+        b.y1 = std::min(b.y1, s.y[j]);
+        b.x2 = std::max(b.x2, s.x[j]);
+        b.y2 = std::max(b.y2, s.y[j]);
+      }
+      r.edge_grid.add(b);
+    }
+    r.edge_grid.build();
+  }
+
+  /** Set the pen of a KID graph element like the dot attributes of KIDGraph do.
+   * @param cr cairo context
+   * @param marked true for marked elements (bold, red2)
+   * @param summary true for summary nodes and their edges (dashed)
+   */
+  void
+  set_kid_pen(const Cairo::RefPtr<Cairo::Context> &cr, bool marked, bool summary = false)
+  {
+    if (marked) {
+      cr->set_source_rgb(238 / 255., 0, 0);
+      cr->set_line_width(2.0);
+    } else {
+      cr->set_source_rgb(0, 0, 0);
+      cr->set_line_width(1.0);
+    }
+    std::vector<double> dash;
+    if (summary)  dash.push_back(6.0);
+    cr->set_dash(dash, 0.0);
+  }
+
+  /** Show a shaped text at a point.
+   * @param cr cairo context with the font of the text selected
+   * @param text the shaped text
+   * @param x x coordinate of the start of the text
+   * @param y y coordinate of the baseline
+   */
+  void
+  show_at(const Cairo::RefPtr<Cairo::Context> &cr, const TextCache::Text &text, double x, double y)
+  {
+    cr->save();
+    cr->translate(x, y);
+    cr->show_glyphs(text.glyphs);
+    cr->restore();
+  }
+
+  /** Show a text centered at a point.
+   * @param cr cairo context
+   * @param size font size
+   * @param text the text
+   * @param x x coordinate of the center
+   * @param y y coordinate of the center
+   * @param box upon return contains the clickable box of the text
+   */
+  void
+  show_centered(const Cairo::RefPtr<Cairo::Context> &cr, double size, const std::string &text,
+                double x, double y, CairoRenderInstructor::box &box)
+  {
+    TextCache::Text shaped;
+    gvplugin_cairo_text_cache().shape(cr, "Times-Roman", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL, size, text, shaped);
+    const Cairo::TextExtents &extents = shaped.extents;
+    show_at(cr, shaped, x - extents.width / 2 - extents.x_bearing, y - extents.height / 2 - extents.y_bearing);
+    // slightly increased like the boxes of the plugin
+    box.x1 = x - extents.width / 2 - 10;
+    box.y1 = y - extents.height / 2 - 10;
+    box.x2 = x + extents.width / 2 + 10;
+    box.y2 = y + extents.height / 2 + 10;
+  }
+
+  /** Create an unbounded recording surface.
+   * @return the surface
+   */
+  Cairo::RefPtr<Cairo::Surface>
+  create_recording()
+  {
+    cairo_surface_t *rec = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, NULL);
+    return Cairo::RefPtr<Cairo::Surface>(new Cairo::Surface(rec, true));
+  }
+}
+
+GraphLayouter::GraphLayouter()
+: native(false), full(false), requested(0), finished(0), stopping(false)
+{
+  worker = boost::thread(&GraphLayouter::run, this);
+}
+
+GraphLayouter::~GraphLayouter()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  worker.join();
+}
+
+void GraphLayouter::request(const std::string &graph)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    dot = graph;
+    native = false;
+    requested++;
+    // a finished rendering that was not taken yet belongs to an older graph
+    rendering.reset();
+  }
+  wakeup.notify_all();
+}
+
+void GraphLayouter::request(const KIDLayout::Graph &kid, bool full_layout)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    graph = kid;
+    native = true;
+    // a full layout that did not start yet is not lost by later requests
+    full = full || full_layout;
+    requested++;
+    rendering.reset();
+  }
+  wakeup.notify_all();
+}
+
+bool GraphLayouter::pending()
+{
+  boost::mutex::scoped_lock lock(mutex);
+  return finished != requested;
+}
+
+GraphRenderingPtr GraphLayouter::take()
+{
+  boost::mutex::scoped_lock lock(mutex);
+  GraphRenderingPtr result = rendering;
+  rendering.reset();
+  return result;
+}
+
+GraphRenderingPtr GraphLayouter::record(GVC_t *gvc, Agraph_t *g)
+{
+  // called with the Graphviz lock held
+  GraphRenderingPtr result(new GraphRendering());
+
+  result->recording = create_recording();
+  result->overview  = create_recording();
+
+  GraphRecorder recorder(Cairo::Context::create(result->recording),
+                         Cairo::Context::create(result->overview));
+  gvplugin_cairo_render(gvc, g, &recorder);
+  recorder.cairo.clear();
+  recorder.overview.clear();
+  result->recording->flush();
+  result->overview->flush();
+
+  result->bbw   = recorder.bbw;
+  result->bbh   = recorder.bbh;
+  result->pad_x = recorder.pad_x;
+  result->pad_y = recorder.pad_y;
+  cairo_recording_surface_ink_extents(result->recording->cobj(), &result->ink_x, &result->ink_y, &result->ink_w, &result->ink_h);
+
+  // the hit-test grids are built once per layout
+  result->edge_segments.swap(recorder.clickable_edges);
+  build_index(*result, recorder.clickable_nodes);
+
+  return result;
+}
+
+GraphRenderingPtr GraphLayouter::draw(KIDLayout &layout, KIDLayout::Graph &graph, bool full)
+{
+  GraphRenderingPtr result(new GraphRendering());
+
+  result->recording = create_recording();
+  result->overview  = create_recording();
+  Cairo::RefPtr<Cairo::Context> cr = Cairo::Context::create(result->recording);
+  Cairo::RefPtr<Cairo::Context> ov = Cairo::Context::create(result->overview);
+  TextCache &text_cache = gvplugin_cairo_text_cache();
+
+  // the node sizes follow the node attributes of KIDGraph::get_dot
+  for (size_t i = 0; i < graph.nodes.size(); ++i) {
+    KIDLayout::Node &node = graph.nodes[i];
+    node.height = 36;
+    if (node.rank_box) {
+      node.width = 144;
+    } else {
+      TextCache::Text text;
+      text_cache.shape(cr, "Times-Roman", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL, 14, node.name, text);
+      node.width = std::max(54.0, (text.extents.x_advance + 16) * M_SQRT2);
+    }
+  }
+  layout.layout(graph, full);
+
+  std::map<std::string, CairoRenderInstructor::box> boxes;
+  for (size_t i = 0; i < graph.nodes.size(); ++i) {
+    const KIDLayout::Node &node = graph.nodes[i];
+    set_kid_pen(cr, node.marked, node.summary);
+    if (node.rank_box) {
+      cr->rectangle(node.x - node.width / 2, node.y - node.height / 2, node.width, node.height);
+    } else {
+      cr->save();
+      cr->translate(node.x, node.y);
+      cr->scale(node.width / 2, node.height / 2);
+      cr->arc(0, 0, 1, 0, 2 * M_PI);
+      cr->restore();
+    }
+    cr->stroke();
+    show_centered(cr, node.rank_box ? 20 : 14, node.name, node.x, node.y, boxes[node.name]);
+
+    // the overview shows the outline and a bar in place of the name
+    const CairoRenderInstructor::box &box = boxes[node.name];
+    set_kid_pen(ov, node.marked, node.summary);
+    if (node.rank_box) {
+      ov->rectangle(node.x - node.width / 2, node.y - node.height / 2, node.width, node.height);
+    } else {
+      ov->save();
+      ov->translate(node.x, node.y);
+      ov->scale(node.width / 2, node.height / 2);
+      ov->arc(0, 0, 1, 0, 2 * M_PI);
+      ov->restore();
+    }
+    ov->stroke();
+    ov->rectangle(box.x1 + 10, node.y - 3, box.x2 - box.x1 - 20, 6);
+    ov->set_source_rgba(0, 0, 0, 0.3);
+    ov->fill();
+  }
+
+  for (size_t e = 0; e < graph.edges.size(); ++e) {
+    KIDLayout::Edge &edge = graph.edges[e];
+    size_t n = edge.px.size();
+    if (n < 4)  continue;
+
+    CairoRenderInstructor::edge_segment segment;
+    const std::string &from = graph.nodes[edge.from].name;
+    const std::string &to   = graph.nodes[edge.to].name;
+    segment.edge = "\"" + from + "\" --" + (edge.label.empty() ? "" : "\"" + edge.label + "\"") + "--> \"" + to + "\"";
+    for (size_t i = 0; i + 3 < n; i += 3) {
+      for (int j = 0; j < 4; ++j) {
+        segment.x[j] = edge.px[i + j];
+        segment.y[j] = edge.py[i + j];
+      }
+      result->edge_segments.push_back(segment);
+    }
+
+    // the curve ends at the base of the arrow head, the edge points to "to",
+    // links to summary nodes have no direction
+    size_t tip = edge.arrow_at_start ? 0 : n - 1;
+    size_t ctl = edge.arrow_at_start ? 1 : n - 2;
+    double dx = edge.px[tip] - edge.px[ctl], dy = edge.py[tip] - edge.py[ctl];
+    double len = sqrt(dx * dx + dy * dy);
+    if (len <= 0) {
+      dx = 0;
+      dy = 1;
+    } else {
+      dx /= len;
+      dy /= len;
+    }
+    double tip_x = edge.px[tip], tip_y = edge.py[tip];
+    if (! edge.summary) {
+      edge.px[tip] -= 10 * dx;
+      edge.py[tip] -= 10 * dy;
+    }
+
+    set_kid_pen(cr, edge.marked, edge.summary);
+    cr->move_to(edge.px[0], edge.py[0]);
+    for (size_t i = 1; i + 2 < n; i += 3)
+      cr->curve_to(edge.px[i], edge.py[i], edge.px[i + 1], edge.py[i + 1], edge.px[i + 2], edge.py[i + 2]);
+    cr->stroke();
+
+    if (! edge.summary) {
+      cr->move_to(tip_x, tip_y);
+      cr->line_to(edge.px[tip] - 3.5 * dy, edge.py[tip] + 3.5 * dx);
+      cr->line_to(edge.px[tip] + 3.5 * dy, edge.py[tip] - 3.5 * dx);
+      cr->close_path();
+      cr->fill_preserve();
+      cr->stroke();
+    }
+
+    set_kid_pen(ov, edge.marked, edge.summary);
+    ov->move_to(edge.px[0], edge.py[0]);
+    ov->line_to(edge.px[n - 1], edge.py[n - 1]);
+    ov->stroke();
+
+    if (! edge.label.empty()) {
+      TextCache::Text text;
+      text_cache.shape(cr, "Times-Roman", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL, 14, edge.label, text);
+      show_at(cr, text, edge.label_x + 4 - text.extents.x_bearing, edge.label_y - text.extents.height / 2 - text.extents.y_bearing);
+    }
+  }
+  cr.clear();
+  ov.clear();
+  result->recording->flush();
+  result->overview->flush();
+
+  result->bbw = graph.width;
+  result->bbh = graph.height;
+  cairo_recording_surface_ink_extents(result->recording->cobj(), &result->ink_x, &result->ink_y, &result->ink_w, &result->ink_h);
+  build_index(*result, boxes);
+  result->kid_nodes.swap(graph.nodes);
+
+  return result;
+}
+
+bool GraphLayouter::superseded(unsigned long id)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  return stopping || id != requested;
+}
+
+GraphRenderingPtr GraphLayouter::render(GVC_t *gvc, const std::string &graph, const char *engine, std::string *laid_out)
+{
+  boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+  GraphRenderingPtr result;
+  Agraph_t *g = agmemread((char *)graph.c_str());
+  if (g) {
+    gvLayout(gvc, g, (char *)engine);
+    if (laid_out) {
+      char *data = NULL;
+      unsigned int length = 0;
+      if (gvRenderData(gvc, g, (char *)"dot", &data, &length) == 0 && data) {
+        laid_out->assign(data, length);
+      } else {
+        laid_out->clear();
+      }
+      free(data);
+    }
+    result = record(gvc, g);
+    gvFreeLayout(gvc, g);
+    agclose(g);
+  } else {
+    result = GraphRenderingPtr(new GraphRendering());
+  }
+
+  return result;
+}
+
+GraphRenderingPtr GraphLayouter::render(KIDLayout::Graph &graph)
+{
+  KIDLayout layout;
+  return draw(layout, graph, true);
+}
+
+unsigned long long GraphLayouter::hash(const std::string &dot)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  for (size_t i = 0; i < dot.size(); ++i) {
+    h ^= (unsigned char)dot[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+bool GraphLayouter::write(const GraphRendering &rendering, const std::string &filename, const std::string &format)
+{
+  if (! rendering.recording)  return false;
+
+  Cairo::RefPtr<Cairo::Surface> surface;
+  if (format == "pdf") {
+    surface = Cairo::PdfSurface::create(filename, rendering.bbw, rendering.bbh);
+  } else if (format == "svg") {
+    surface = Cairo::SvgSurface::create(filename, rendering.bbw, rendering.bbh);
+  } else if (format == "png") {
+    surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, (int)ceil(rendering.bbw), (int)ceil(rendering.bbh));
+  } else {
+    return false;
+  }
+
+  // the recording is in graph units
+  Cairo::RefPtr<Cairo::Context> cairo = Cairo::Context::create(surface);
+  cairo->set_source(rendering.recording, 0, 0);
+  cairo->paint();
+  cairo.clear();
+
+  if (format == "png")  surface->write_to_png(filename);
+  surface->finish();
+  return cairo_surface_status(surface->cobj()) == CAIRO_STATUS_SUCCESS;
+}
+
+void GraphLayouter::run()
+{
+  GVC_t *gvc;
+  {
+    boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+    gvc = gvContext();
+    gvplugin_cairo_setup(gvc);
+  }
+
+  boost::mutex::scoped_lock lock(mutex);
+  while (true) {
+    while (! stopping && finished == requested)  wakeup.wait(lock);
+    if (stopping)  break;
+
+    unsigned long id = requested;
+    bool job_native = native;
+    bool job_full = full;
+    full = false;
+    std::string job_dot;
+    KIDLayout::Graph job_graph;
+    if (native)  job_graph.swap(graph);
+    else         job_dot = dot;
+    lock.unlock();
+
+    GraphRenderingPtr result;
+    if (job_native) {
+      // the native layout does not need Graphviz
+      result = draw(kid_layout, job_graph, job_full);
+    } else {
+      // parsing and layout cannot be interrupted, superseded jobs are
+      // abandoned between the steps, other threads may use Graphviz
+      // in between
+      Agraph_t *g;
+      {
+        boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+        g = agmemread((char *)job_dot.c_str());
+        if (g)  gvLayout(gvc, g, (char *)"dot");
+      }
+      if (g) {
+        bool abandon = superseded(id);
+        boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+        if (! abandon)  result = record(gvc, g);
+        gvFreeLayout(gvc, g);
+        agclose(g);
+      } else {
+        result = GraphRenderingPtr(new GraphRendering());
+      }
+    }
+
+    lock.lock();
+    // the pins of the next request still hold the old positions
+    if (job_full && id != requested && native)  full = true;
+    if (result && id == requested && ! stopping) {
+      rendering = result;
+      finished = id;
+      signal_ready();
+    }
+  }
+
+  lock.unlock();
+  boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+  gvFreeContext(gvc);
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glibmm/dispatcher.h>
+#include <cairomm/cairomm.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <gvc.h>
+
+#include "gvplugin_cairo.h"
+#include "hitgrid.h"
+#include "kidlayout.h"
+
+namespace SceneReconstruction {
+  /** @struct GraphRendering "graph_layouter.h"
+   *  Drawing of a laid out graph recorded in graph units.
+   *  The recording is immutable once it is handed out, so it can be
+   *  replayed from any thread.
+   *  @author Bastian Klingen
+   */
+  struct GraphRendering {
+    /** recording of the drawing, NULL if the graph could not be laid out */
+    Cairo::RefPtr<Cairo::Surface>                       recording;
+    /** recording of a simplified drawing for scales below
+     *  GVPLUGIN_CAIRO_LOD_SCALE, text as bars and edges as straight lines */
+    Cairo::RefPtr<Cairo::Surface>                       overview;
+    /** bounding box width */
+    double                                              bbw;
+    /** bounding box height */
+    double                                              bbh;
+    /** padding in x */
+    double                                              pad_x;
+    /** padding in y */
+    double                                              pad_y;
+    /** extents of the recorded drawing */
+    double                                              ink_x, ink_y, ink_w, ink_h;
+    /** names of the nodes, by box of node_grid */
+    std::vector<std::string>                            node_names;
+    /** hit-test grid over the node label boxes in graph units */
+    HitGrid                                             node_grid;
+    /** bezier segments of the edges in graph units, by box of edge_grid */
+    std::vector<CairoRenderInstructor::edge_segment>    edge_segments;
+    /** hit-test grid over the control point boxes of the edge segments */
+    HitGrid                                             edge_grid;
+    /** nodes of a native layout with their positions, empty for Graphviz */
+    std::vector<KIDLayout::Node>                        kid_nodes;
+
+    /** Constructor */
+    GraphRendering() : bbw(0), bbh(0), pad_x(0), pad_y(0), ink_x(0), ink_y(0), ink_w(0), ink_h(0) {}
+  };
+
+  /** shared pointer to a rendering */
+  typedef boost::shared_ptr<GraphRendering> GraphRenderingPtr;
+
+  /** @class GraphLayouter "graph_layouter.h"
+   *  Lays out dot graphs and records their drawing on a worker thread
+   *  with its own Graphviz context. Only the latest request is kept: a
+   *  request that is superseded while it is waiting is dropped, one that
+   *  is superseded while it runs is abandoned after its current step.
+   *  Finished renderings are announced through signal_ready on the
+   *  thread that created the layouter. KID graphs can be laid out by
+   *  the native KIDLayout instead of Graphviz.
+   *  @author Bastian Klingen
+   */
+  class GraphLayouter
+  {
+    public:
+      /** Constructor, starts the worker thread */
+      GraphLayouter();
+      /** Destructor, stops the worker thread after its current step */
+      ~GraphLayouter();
+
+      /** requests the layout of a graph, supersedes all earlier requests
+       *  @param dot the graph in the dot language
+       */
+      void request(const std::string&);
+
+      /** requests the native layout of a KID graph, supersedes all earlier
+       *  requests, pinned nodes and the nodes of the last native layout
+       *  keep their positions unless a full layout is requested
+       *  @param graph snapshot of the KID graph
+       *  @param full true to optimize the layout from scratch
+       */
+      void request(const KIDLayout::Graph&, bool full = false);
+
+      /** checks if the latest request is not finished yet
+       *  @return true if a layout is pending
+       */
+      bool pending();
+
+      /** takes the finished rendering of the latest request, renderings
+       *  of superseded requests are never returned
+       *  @return the rendering or an empty pointer if there is none
+       */
+      GraphRenderingPtr take();
+
+      /** lays out a graph and records its drawing on the calling thread
+       *  each thread needs its own context, calls into Graphviz are
+       *  serialized through gvplugin_cairo_mutex()
+       *  @param gvc Graphviz context set up with gvplugin_cairo_setup
+       *  @param dot the graph in the dot language
+       *  @param engine Graphviz layout engine, "nop2" draws a graph that
+       *         was laid out before at its stored positions
+       *  @param laid_out if not NULL receives the laid out graph in the dot
+       *         language with positions, to be rendered again with "nop2"
+       *  @return the rendering, without recording if the graph is invalid
+       */
+      static GraphRenderingPtr render(GVC_t*, const std::string&, const char *engine = "dot", std::string *laid_out = NULL);
+
+      /** lays out a KID graph natively from scratch and records its
+       *  drawing on the calling thread, Graphviz is not used
+       *  @param graph snapshot of the KID graph, receives the positions
+       *  @return the rendering
+       */
+      static GraphRenderingPtr render(KIDLayout::Graph&);
+
+      /** hashes a graph in the dot language, equal graphs have equal
+       *  hashes, so it identifies the layouts of a graph
+       *  @param dot the graph
+       *  @return the FNV-1a hash of the text
+       */
+      static unsigned long long hash(const std::string&);
+
+      /** writes the recording of a rendering to a file
+       *  vector formats keep the recorded drawing as vectors
+       *  @param rendering the rendering
+       *  @param filename name of the file
+       *  @param format "svg", "pdf" or "png"
+       *  @return true if the file was written
+       */
+      static bool write(const GraphRendering&, const std::string&, const std::string&);
+
+    public:
+      /** emitted when a rendering can be taken */
+      Glib::Dispatcher                   signal_ready;
+
+    private:
+      void run();
+      bool superseded(unsigned long);
+      static GraphRenderingPtr record(GVC_t*, Agraph_t*);
+      static GraphRenderingPtr draw(KIDLayout&, KIDLayout::Graph&, bool);
+
+    private:
+      boost::mutex                       mutex;
+      boost::condition_variable          wakeup;
+      boost::thread                      worker;
+      std::string                        dot;
+      bool                               native;
+      bool                               full;
+      KIDLayout::Graph                   graph;
+      KIDLayout                          kid_layout;
+      unsigned long                      requested;
+      unsigned long                      finished;
+      GraphRenderingPtr                  rendering;
+      bool                               stopping;
+  };
+}
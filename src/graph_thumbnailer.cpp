@@ -0,0 +1,131 @@
+#include "graph_thumbnailer.h"
+#include "graph_layouter.h"
+
+#include <algorithm>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace SceneReconstruction;
+
+GraphThumbnailer::GraphThumbnailer(size_t _capacity)
+: stopping(false), capacity(_capacity)
+{
+  worker = boost::thread(&GraphThumbnailer::run, this);
+}
+
+GraphThumbnailer::~GraphThumbnailer()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  worker.join();
+}
+
+Glib::RefPtr<Gdk::Pixbuf> GraphThumbnailer::lookup(unsigned long long key)
+{
+  std::map<unsigned long long, CacheList::iterator>::iterator i = cache_index.find(key);
+  if (i == cache_index.end())  return Glib::RefPtr<Gdk::Pixbuf>();
+
+  // most recently used thumbnails are at the front
+  cache.splice(cache.begin(), cache, i->second);
+  return i->second->second;
+}
+
+void GraphThumbnailer::request(int id, unsigned long long key, const KIDLayout::Graph &graph)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    Job &job = jobs[id];
+    job.key = key;
+    job.graph = graph;
+  }
+  wakeup.notify_all();
+}
+
+void GraphThumbnailer::cancel(int id)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  jobs.erase(id);
+}
+
+bool GraphThumbnailer::take(int &id, unsigned long long &key, Glib::RefPtr<Gdk::Pixbuf> &thumbnail)
+{
+  ResultPtr result;
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    if (results.empty())  return false;
+    result = results.front();
+    results.pop_front();
+  }
+
+  id = result->id;
+  key = result->key;
+  thumbnail = Gdk::Pixbuf::create(result->surface, 0, 0, WIDTH, HEIGHT);
+
+  if (cache_index.find(key) == cache_index.end()) {
+    cache.push_front(std::make_pair(key, thumbnail));
+    cache_index[key] = cache.begin();
+    while (cache.size() > capacity) {
+      cache_index.erase(cache.back().first);
+      cache.pop_back();
+    }
+  }
+  return true;
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> GraphThumbnailer::draw(KIDLayout::Graph &graph)
+{
+  Cairo::RefPtr<Cairo::ImageSurface> surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, WIDTH, HEIGHT);
+  Cairo::RefPtr<Cairo::Context> cairo = Cairo::Context::create(surface);
+  cairo->set_source_rgb(1, 1, 1);
+  cairo->paint();
+
+  GraphRenderingPtr rendering = GraphLayouter::render(graph);
+  if (rendering->bbw <= 0 || rendering->bbh <= 0)  return surface;
+
+  // fit the graph centered into the thumbnail, small scales replay the overview
+  double scale = std::min(WIDTH / rendering->bbw, HEIGHT / rendering->bbh);
+  cairo->translate((WIDTH - rendering->bbw * scale) / 2, (HEIGHT - rendering->bbh * scale) / 2);
+  cairo->scale(scale, scale);
+  if (scale < GVPLUGIN_CAIRO_LOD_SCALE && rendering->overview) {
+    cairo->set_source(rendering->overview, 0, 0);
+  } else {
+    cairo->set_source(rendering->recording, 0, 0);
+  }
+  cairo->paint();
+  cairo.clear();
+  surface->flush();
+  return surface;
+}
+
+void GraphThumbnailer::run()
+{
+  // thumbnails are never urgent, the GUI and the layouter go first
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+  boost::mutex::scoped_lock lock(mutex);
+  while (true) {
+    while (! stopping && jobs.empty())  wakeup.wait(lock);
+    if (stopping)  break;
+
+    ResultPtr result(new Result());
+    result->id = jobs.begin()->first;
+    result->key = jobs.begin()->second.key;
+    KIDLayout::Graph graph;
+    graph.swap(jobs.begin()->second.graph);
+    jobs.erase(jobs.begin());
+    lock.unlock();
+
+    result->surface = draw(graph);
+
+    lock.lock();
+    if (! stopping) {
+      results.push_back(result);
+      signal_ready();
+    }
+  }
+}
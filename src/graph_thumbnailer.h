@@ -0,0 +1,112 @@
+#pragma once
+#include <list>
+#include <map>
+
+#include <glibmm/dispatcher.h>
+#include <gdkmm/pixbuf.h>
+#include <cairomm/cairomm.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "kidlayout.h"
+
+namespace SceneReconstruction {
+  /** @class GraphThumbnailer "graph_thumbnailer.h"
+   *  Draws small previews of KID graphs on a worker thread with the
+   *  lowest scheduling priority, so it only uses time the GUI and the
+   *  GraphLayouter leave over. The graphs are laid out natively, which
+   *  does not take the Graphviz lock the layouter of the visible graph
+   *  needs. Only the latest request of each graph is kept. Finished
+   *  thumbnails are announced through signal_ready and cached by a key
+   *  that identifies the state of the graph, e.g. its document and
+   *  revision, so unchanged graphs are never drawn twice. Except for
+   *  the worker, the thumbnailer is only used on the thread that
+   *  created it.
+   *  @author Bastian Klingen
+   */
+  class GraphThumbnailer
+  {
+    public:
+      /** size of the thumbnails in pixels */
+      enum Size {
+        /** width of a thumbnail */
+        WIDTH = 48,
+        /** height of a thumbnail */
+        HEIGHT = 32
+      };
+
+      /** Constructor, starts the worker thread
+       *  @param capacity number of thumbnails to keep in the cache
+       */
+      GraphThumbnailer(size_t capacity = 64);
+      /** Destructor, stops the worker thread after its current thumbnail */
+      ~GraphThumbnailer();
+
+      /** gets a cached thumbnail
+       *  @param key key of the graph
+       *  @return the thumbnail or an empty pointer if it is not cached
+       */
+      Glib::RefPtr<Gdk::Pixbuf> lookup(unsigned long long key);
+
+      /** requests the thumbnail of a graph, supersedes the earlier
+       *  requests of the same graph
+       *  @param id id of the graph, e.g. of its document
+       *  @param key key of the graph
+       *  @param graph snapshot of the KID graph
+       */
+      void request(int id, unsigned long long key, const KIDLayout::Graph &graph);
+
+      /** drops the waiting request of a graph, e.g. when it is closed
+       *  @param id id of the graph
+       */
+      void cancel(int id);
+
+      /** takes a finished thumbnail and caches it
+       *  @param id upon return contains the id of the graph
+       *  @param key upon return contains the key of the drawn graph
+       *  @param thumbnail upon return contains the thumbnail
+       *  @return false if no thumbnail is finished
+       */
+      bool take(int &id, unsigned long long &key, Glib::RefPtr<Gdk::Pixbuf> &thumbnail);
+
+    public:
+      /** emitted when thumbnails can be taken */
+      Glib::Dispatcher                   signal_ready;
+
+    private:
+      /** a requested thumbnail */
+      struct Job {
+        unsigned long long               key;
+        KIDLayout::Graph                 graph;
+      };
+
+      /** a finished thumbnail, the surface is only touched by one
+       *  thread at a time */
+      struct Result {
+        int                              id;
+        unsigned long long               key;
+        Cairo::RefPtr<Cairo::ImageSurface> surface;
+      };
+      typedef boost::shared_ptr<Result> ResultPtr;
+
+      typedef std::list<std::pair<unsigned long long, Glib::RefPtr<Gdk::Pixbuf> > > CacheList;
+
+      void run();
+      static Cairo::RefPtr<Cairo::ImageSurface> draw(KIDLayout::Graph&);
+
+    private:
+      boost::mutex                       mutex;
+      boost::condition_variable          wakeup;
+      boost::thread                      worker;
+      std::map<int, Job>                 jobs;
+      std::list<ResultPtr>               results;
+      bool                               stopping;
+
+      CacheList                          cache;
+      std::map<unsigned long long, CacheList::iterator> cache_index;
+      size_t                             capacity;
+  };
+}
@@ -28,19 +28,22 @@
 #include <gvplugin_render.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 
 #define NOEXPORT __attribute__ ((visibility("hidden")))
 
-NOEXPORT CairoRenderInstructor *__cri = NULL;
+/** instructor of the render call running on this thread, handed to the job */
+NOEXPORT __thread CairoRenderInstructor *__cri_current = NULL;
 
-#if CAIROMM_MAJOR_VERSION > 1 || (CAIROMM_MAJOR_VERSION == 1 && CAIROMM_MINO_VERSION > 8)
-NOEXPORT std::vector<double> __cairo_render_dashed;
-NOEXPORT std::vector<double> __cairo_render_dotted;
-#else
-NOEXPORT std::valarray<double> __cairo_render_dashed(1);
-NOEXPORT std::valarray<double> __cairo_render_dotted(2);
-#endif
+/** serializes all calls into Graphviz */
+NOEXPORT boost::mutex __graphviz_mutex;
+
+/** shaped labels, kept across renders and layouts */
+NOEXPORT SceneReconstruction::TextCache __text_cache;
+
+static const double __cairo_render_dashed[] = { 6.0 };
+static const double __cairo_render_dotted[] = { 2.0, 6.0 };
 
 /** @class CairoRenderInstructor
  * Graphviz Cairo render plugin instructor.
@@ -109,7 +112,7 @@ cairo_device_init(GVJ_t* /* firstjob */)
 static void
 cairo_device_finalize(GVJ_t *firstjob)
 {
-  firstjob->context = (void *)__cri;
+  firstjob->context = (void *)__cri_current;
   firstjob->external_context = TRUE;
 
   // Render!
@@ -117,10 +120,59 @@ cairo_device_finalize(GVJ_t *firstjob)
 }
 
 static inline void
-cairo_set_color(Cairo::RefPtr<Cairo::Context> cairo, gvcolor_t * color)
+cairo_set_color(Cairo::RefPtr<Cairo::Context> cairo, gvcolor_t * color, double alpha = 1.0)
 {
   cairo->set_source_rgba(color->u.RGBA[0], color->u.RGBA[1],
-			 color->u.RGBA[2], color->u.RGBA[3]);
+			 color->u.RGBA[2], color->u.RGBA[3] * alpha);
+}
+
+/** Check if a box in user space touches the clip region.
+ * Unbounded targets like recording surfaces have unbounded clip extents.
+ * @param cairo cairo context
+ * @param x1 left border
+ * @param y1 top border
+ * @param x2 right border
+ * @param y2 bottom border
+ * @return true if the box may be visible
+ */
+static inline bool
+cairo_visible(Cairo::RefPtr<Cairo::Context> cairo, double x1, double y1, double x2, double y2)
+{
+  double cx1, cy1, cx2, cy2;
+  cairo->get_clip_extents(cx1, cy1, cx2, cy2);
+  return x2 >= cx1 && x1 <= cx2 && y2 >= cy1 && y1 <= cy2;
+}
+
+/** Check if the context draws big enough for text and curves.
+ * @param cairo cairo context
+ * @return false if the context scales below GVPLUGIN_CAIRO_LOD_SCALE
+ */
+static inline bool
+cairo_detailed(Cairo::RefPtr<Cairo::Context> cairo)
+{
+  double dx = 1.0, dy = 0.0;
+  cairo->user_to_device_distance(dx, dy);
+  return dx * dx + dy * dy >= GVPLUGIN_CAIRO_LOD_SCALE * GVPLUGIN_CAIRO_LOD_SCALE;
+}
+
+/** Check if the bounds of points touch the clip region.
+ * @param cairo cairo context
+ * @param A points in graph coordinates
+ * @param n number of points
+ * @param pad extra border around the points, e.g. for the pen width
+ * @return true if the points may be visible
+ */
+static bool
+cairo_points_visible(Cairo::RefPtr<Cairo::Context> cairo, pointf *A, int n, double pad)
+{
+  double x1 = A[0].x, y1 = -A[0].y, x2 = A[0].x, y2 = -A[0].y;
+  for (int i = 1; i < n; ++i) {
+    x1 = std::min(x1, A[i].x);
+    x2 = std::max(x2, A[i].x);
+    y1 = std::min(y1, -A[i].y);
+    y2 = std::max(y2, -A[i].y);
+  }
+  return cairo_visible(cairo, x1 - pad, y1 - pad, x2 + pad, y2 + pad);
 }
 
 static inline void
@@ -128,18 +180,22 @@ cairo_set_penstyle(Cairo::RefPtr<Cairo::Context> cairo, GVJ_t *job)
 {
   obj_state_t *obj = job->obj;
 
+  // the dash patterns are built per call, nothing is shared between jobs
+  const double *pattern = __cairo_render_dashed;
+  size_t length = 0;
   if (obj->pen == PEN_DASHED) {
-    cairo->set_dash(__cairo_render_dashed, 0.0);
+    pattern = __cairo_render_dashed;
+    length  = 1;
   } else if (obj->pen == PEN_DOTTED) {
-    cairo->set_dash(__cairo_render_dotted, 0.0);
-  } else {
+    pattern = __cairo_render_dotted;
+    length  = 2;
+  }
 #if CAIROMM_MAJOR_VERSION > 1 || (CAIROMM_MAJOR_VERSION == 1 && CAIROMM_MINO_VERSION > 8)
-    std::vector<double> empty;
+  std::vector<double> dash(pattern, pattern + length);
 #else
-    std::valarray<double> empty;
+  std::valarray<double> dash(pattern, length);
 #endif
-    cairo->set_dash(empty, 0.0);
-  }
+  cairo->set_dash(dash, 0.0);
   cairo->set_line_width(obj->penwidth);
 }
 
@@ -149,6 +205,7 @@ cairo_render_begin_page(GVJ_t *job)
 {
   CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
   cri->clickable_nodes.clear();
+  cri->clickable_edges.clear();
 
   float bbwidth  = job->bb.UR.x - job->bb.LL.x;
   float bbheight = job->bb.UR.y - job->bb.LL.y;
@@ -204,6 +261,13 @@ cairo_render_begin_page(GVJ_t *job)
     cairo->translate(translate_x + pad_x * zoom, translate_y - pad_y * zoom);
     cairo->scale(zoom, zoom);
   }
+
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
+  if (overview) {
+    Cairo::Matrix matrix;
+    cairo->get_matrix(matrix);
+    overview->set_matrix(matrix);
+  }
 }
 
 static void
@@ -213,11 +277,31 @@ cairo_render_end_page(GVJ_t* /* job */)
   //cri->queue_draw();  
 }
 
+/** Add a bar in place of a text paragraph to the path.
+ * The bar spans the width Graphviz estimated for the text, so the text
+ * does not need to be measured.
+ * @param cairo cairo context
+ * @param p position of the paragraph
+ * @param para the paragraph
+ */
+static void
+cairo_text_box(Cairo::RefPtr<Cairo::Context> cairo, pointf p, textpara_t *para)
+{
+  double x = p.x;
+  if (para->just == 'r') {
+    x -= para->width;
+  } else if (para->just != 'l') {
+    x -= para->width / 2.0;
+  }
+  cairo->rectangle(x, -p.y - para->fontsize * 0.5, para->width, para->fontsize * 0.5);
+}
+
 static void
 cairo_render_textpara(GVJ_t *job, pointf p, textpara_t *para)
 {
   CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
   Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
   obj_state_t *obj = job->obj;
 
   Cairo::FontWeight weight = Cairo::FONT_WEIGHT_NORMAL;
@@ -268,28 +352,49 @@ cairo_render_textpara(GVJ_t *job, pointf p, textpara_t *para)
       offsety = atof(labeloffsety);
     }
   }
+  if (overview) {
+    pointf q = {p.x + offsetx, p.y - offsety};
+    cairo_text_box(overview, q, para);
+    cairo_set_color(overview, &(obj->pencolor), 0.3);
+    overview->fill();
+  }
+
+  // text outside of the clip region is neither measured nor drawn
+  if ( (rotate == 0.0) &&
+       ! cairo_visible(cairo, p.x + offsetx - para->width, -p.y + offsety - para->fontsize,
+                       p.x + offsetx + para->width, -p.y + offsety + para->fontsize) ) {
+    return;
+  }
+
   Cairo::Matrix old_matrix;
   cairo->get_matrix(old_matrix);
 
-  cairo->select_font_face(para->fontname, slant, weight);
-  cairo->set_font_size(para->fontsize);
-  //cairo->set_font_options ( Cairo::FontOptions() );
-  //cairo->set_line_width(1.0);
-
-  Cairo::TextExtents extents;
-  cairo->get_text_extents(para->str, extents);
+  if (cairo_detailed(cairo)) {
+    // labels of unchanged graphs are not shaped again
+    SceneReconstruction::TextCache::Text text;
+    __text_cache.shape(cairo, para->fontname, slant, weight, para->fontsize, para->str, text);
+    //cairo->set_font_options ( Cairo::FontOptions() );
+    //cairo->set_line_width(1.0);
+
+    if (para->just == 'r') {
+      p.x -= text.extents.width;
+    } else if (para->just != 'l') {
+      p.x -= text.extents.width / 2.0;
+    }
 
-  if (para->just == 'r') {
-    p.x -= extents.width;
-  } else if (para->just != 'l') {
-    p.x -= extents.width / 2.0;
+    cairo->translate(p.x + offsetx, -p.y + offsety);
+    cairo->rotate(rotate);
+    cairo_set_color(cairo, &(obj->pencolor));
+    cairo->glyph_path(text.glyphs);
+    // the path is kept in device space, its extents are taken unrotated
+    cairo->set_matrix(old_matrix);
+  } else {
+    // too small to read
+    pointf q = {p.x + offsetx, p.y - offsety};
+    cairo_text_box(cairo, q, para);
+    cairo_set_color(cairo, &(obj->pencolor), 0.3);
   }
 
-  cairo->move_to(p.x + offsetx, -p.y + offsety);
-  cairo->rotate(rotate);
-  cairo_set_color(cairo, &(obj->pencolor));
-  cairo->text_path( para->str );
-
   //save text bounding box to allow clicking
   if (obj->type == NODE_OBJTYPE) {
     double translate_x, translate_y;
@@ -315,12 +420,18 @@ cairo_render_textpara(GVJ_t *job, pointf p, textpara_t *para)
   cairo->set_matrix(old_matrix);
 }
 
+/** Draw an ellipse.
+ * @param cairo cairo context
+ * @param job job with the current pen and colors
+ * @param c center
+ * @param rx radius in x
+ * @param ry radius in y
+ * @param filled true to fill the ellipse
+ */
 static void
-cairo_render_ellipse(GVJ_t *job, pointf *A, int filled)
+cairo_draw_ellipse(Cairo::RefPtr<Cairo::Context> cairo, GVJ_t *job,
+		   pointf c, double rx, double ry, int filled)
 {
-  //printf("Render ellipse\n");
-  CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
-  Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
   obj_state_t *obj = job->obj;
 
   Cairo::Matrix old_matrix;
@@ -328,10 +439,8 @@ cairo_render_ellipse(GVJ_t *job, pointf *A, int filled)
 
   cairo_set_penstyle(cairo, job);
 
-  cairo->translate(A[0].x, -A[0].y);
+  cairo->translate(c.x, -c.y);
 
-  double rx = A[1].x - A[0].x;
-  double ry = A[1].y - A[0].y;
   cairo->scale(1, ry / rx);
   cairo->move_to(rx, 0);
   cairo->arc(0, 0, rx, 0, 2 * M_PI);
@@ -348,11 +457,35 @@ cairo_render_ellipse(GVJ_t *job, pointf *A, int filled)
 }
 
 static void
-cairo_render_polygon(GVJ_t *job, pointf *A, int n, int filled)
+cairo_render_ellipse(GVJ_t *job, pointf *A, int filled)
 {
-  //printf("Polygon\n");
+  //printf("Render ellipse\n");
   CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
   Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
+
+  double rx = A[1].x - A[0].x;
+  double ry = A[1].y - A[0].y;
+  if (overview)  cairo_draw_ellipse(overview, job, A[0], rx, ry, filled);
+
+  double pad = job->obj->penwidth;
+  if (cairo_visible(cairo, A[0].x - fabs(rx) - pad, -A[0].y - fabs(ry) - pad,
+                    A[0].x + fabs(rx) + pad, -A[0].y + fabs(ry) + pad)) {
+    cairo_draw_ellipse(cairo, job, A[0], rx, ry, filled);
+  }
+}
+
+/** Draw a closed polygon.
+ * @param cairo cairo context
+ * @param job job with the current pen and colors
+ * @param A corners
+ * @param n number of corners
+ * @param filled true to fill the polygon
+ */
+static void
+cairo_draw_polygon(Cairo::RefPtr<Cairo::Context> cairo, GVJ_t *job,
+		   pointf *A, int n, int filled)
+{
   obj_state_t *obj = job->obj;
 
   cairo_set_penstyle(cairo, job);
@@ -367,6 +500,18 @@ cairo_render_polygon(GVJ_t *job, pointf *A, int n, int filled)
     cairo_set_color(cairo, &(obj->fillcolor));
     cairo->fill_preserve();
   }
+  cairo_set_color(cairo, &(obj->pencolor));
+  cairo->stroke();
+}
+
+static void
+cairo_render_polygon(GVJ_t *job, pointf *A, int n, int filled)
+{
+  //printf("Polygon\n");
+  CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
+  Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
+  obj_state_t *obj = job->obj;
 
   // HACK to workaround graphviz bug any get the Tim style...
   if ( obj->type == CLUSTER_OBJTYPE ) {
@@ -375,25 +520,38 @@ cairo_render_polygon(GVJ_t *job, pointf *A, int n, int filled)
     obj->pencolor.u.RGBA[2] = 1.0;
     obj->pencolor.u.RGBA[3] = 1.0;
   }
-  cairo_set_color(cairo, &(obj->pencolor));
-  cairo->stroke();
+
+  if (overview)  cairo_draw_polygon(overview, job, A, n, filled);
+  if (cairo_points_visible(cairo, A, n, obj->penwidth)) {
+    cairo_draw_polygon(cairo, job, A, n, filled);
+  }
 }
 
+/** Draw a bezier curve.
+ * @param cairo cairo context
+ * @param job job with the current pen and colors
+ * @param A start point followed by three control points per segment
+ * @param n number of points
+ * @param filled true to fill the curve
+ * @param detailed false to draw a straight line from start to end instead
+ */
 static void
-cairo_render_bezier(GVJ_t * job, pointf * A, int n, int /* arrow_at_start */,
-		int /* arrow_at_end */, int filled)
+cairo_draw_bezier(Cairo::RefPtr<Cairo::Context> cairo, GVJ_t *job,
+		  pointf *A, int n, int filled, bool detailed)
 {
-  //printf("Bezier\n");
-  CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
-  Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
   obj_state_t *obj = job->obj;
 
   cairo_set_penstyle(cairo, job);
 
   cairo->move_to(A[0].x, -A[0].y);
-  for (int i = 1; i < n; i += 3)
-    cairo->curve_to(A[i].x, -A[i].y, A[i + 1].x, -A[i + 1].y,
-		    A[i + 2].x, -A[i + 2].y);
+  if (detailed || filled) {
+    for (int i = 1; i < n; i += 3)
+      cairo->curve_to(A[i].x, -A[i].y, A[i + 1].x, -A[i + 1].y,
+		      A[i + 2].x, -A[i + 2].y);
+  } else {
+    cairo->line_to(A[n - 1].x, -A[n - 1].y);
+  }
+
   if (filled) {
     cairo_set_color(cairo, &(obj->fillcolor));
     cairo->fill_preserve();
@@ -403,11 +561,50 @@ cairo_render_bezier(GVJ_t * job, pointf * A, int n, int /* arrow_at_start */,
 }
 
 static void
-cairo_render_polyline(GVJ_t * job, pointf * A, int n)
+cairo_render_bezier(GVJ_t * job, pointf * A, int n, int /* arrow_at_start */,
+		int /* arrow_at_end */, int filled)
 {
-  //printf("Polyline\n");
+  //printf("Bezier\n");
   CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
   Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
+  obj_state_t *obj = job->obj;
+
+  // save the segments of edges in device coordinates to allow clicking,
+  // the edges are written "to" -> "from" with dir=back by KIDGraph
+  if (obj->type == EDGE_OBJTYPE) {
+    Agedge_t *e = obj->u.e;
+    char *label = agget(e, (char *)"label");
+    CairoRenderInstructor::edge_segment segment;
+    segment.edge = std::string("\"") + agnameof(aghead(e)) + "\" --"
+      + ((label && *label) ? std::string("\"") + label + "\"" : std::string())
+      + "--> \"" + agnameof(agtail(e)) + "\"";
+    for (int i = 0; i + 3 < n; i += 3) {
+      for (int j = 0; j < 4; ++j) {
+        segment.x[j] = A[i + j].x;
+        segment.y[j] = -A[i + j].y;
+        cairo->user_to_device(segment.x[j], segment.y[j]);
+      }
+      cri->clickable_edges.push_back(segment);
+    }
+  }
+
+  if (overview)  cairo_draw_bezier(overview, job, A, n, filled, false);
+  // the curve lies within the hull of its control points
+  if (cairo_points_visible(cairo, A, n, obj->penwidth)) {
+    cairo_draw_bezier(cairo, job, A, n, filled, cairo_detailed(cairo));
+  }
+}
+
+/** Draw an open polyline.
+ * @param cairo cairo context
+ * @param job job with the current pen and colors
+ * @param A points
+ * @param n number of points
+ */
+static void
+cairo_draw_polyline(Cairo::RefPtr<Cairo::Context> cairo, GVJ_t *job, pointf *A, int n)
+{
   obj_state_t *obj = job->obj;
 
   cairo_set_penstyle(cairo, job);
@@ -421,6 +618,20 @@ cairo_render_polyline(GVJ_t * job, pointf * A, int n)
   cairo->stroke();
 }
 
+static void
+cairo_render_polyline(GVJ_t * job, pointf * A, int n)
+{
+  //printf("Polyline\n");
+  CairoRenderInstructor *cri = (CairoRenderInstructor *)job->context;
+  Cairo::RefPtr<Cairo::Context> cairo = cri->get_cairo();
+  Cairo::RefPtr<Cairo::Context> overview = cri->get_overview();
+
+  if (overview)  cairo_draw_polyline(overview, job, A, n);
+  if (cairo_points_visible(cairo, A, n, job->obj->penwidth)) {
+    cairo_draw_polyline(cairo, job, A, n);
+  }
+}
+
 
 static gvrender_engine_t cairo_render_engine = {
     0,				/* cairo_render_begin_job */
@@ -510,20 +721,51 @@ gvplugin_library_t gvplugin_cairo_LTX_library = { (char *)"cairo", apis };
 
 
 void
-gvplugin_cairo_setup(GVC_t *gvc, CairoRenderInstructor *cri)
+gvplugin_cairo_setup(GVC_t *gvc)
 {
-  __cri = cri;
   gvAddLibrary(gvc, &gvplugin_cairo_LTX_library);
+}
 
-#if CAIROMM_MAJOR_VERSION > 1 || (CAIROMM_MAJOR_VERSION == 1 && CAIROMM_MINO_VERSION > 8)
-  __cairo_render_dashed.clear();
-  __cairo_render_dashed.push_back(6.0);
-  __cairo_render_dotted.clear();
-  __cairo_render_dotted.push_back(2.0);
-  __cairo_render_dotted.push_back(6.0);
-#else
-  __cairo_render_dashed[0] = 6.0;
-  __cairo_render_dotted[0] = 2.0;
-  __cairo_render_dotted[1] = 6.0;
-#endif
+
+/** Get the lock for calls into Graphviz.
+ * Graphviz keeps global state in its parser, layout and render code, so
+ * contexts on different threads must not call into it at the same time.
+ * Replaying and rasterizing recorded drawings does not need the lock.
+ * @return the process wide Graphviz lock
+ */
+boost::mutex &
+gvplugin_cairo_mutex()
+{
+  return __graphviz_mutex;
+}
+
+
+/** Get the cache of shaped labels.
+ * The cache is shared by all renderings and can be used without
+ * gvplugin_cairo_mutex().
+ * @return the process wide text cache
+ */
+SceneReconstruction::TextCache &
+gvplugin_cairo_text_cache()
+{
+  return __text_cache;
+}
+
+
+/** Render a laid out graph with the cairo plugin.
+ * The instructor is only used by this call, each job takes it as its
+ * context. The caller has to hold gvplugin_cairo_mutex().
+ * @param gvc Graphviz context set up with gvplugin_cairo_setup()
+ * @param g laid out graph
+ * @param cri instructor providing the cairo context and transformation
+ * @return result of gvRender
+ */
+int
+gvplugin_cairo_render(GVC_t *gvc, graph_t *g, CairoRenderInstructor *cri)
+{
+  CairoRenderInstructor *old_cri = __cri_current;
+  __cri_current = cri;
+  int rv = gvRender(gvc, g, (char *)"cairo", NULL);
+  __cri_current = old_cri;
+  return rv;
 }
@@ -27,6 +27,14 @@
 #include <cairomm/cairomm.h>
 #include <gvc.h>
 #include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "textcache.h"
+
+/** scale below which text is drawn as boxes and edges as straight lines */
+#define GVPLUGIN_CAIRO_LOD_SCALE 0.4
 
 class CairoRenderInstructor
 {
@@ -35,6 +43,10 @@ class CairoRenderInstructor
     virtual ~CairoRenderInstructor() {}
   
     virtual Cairo::RefPtr<Cairo::Context> get_cairo() = 0;
+    /** Get Cairo context for a simplified overview.
+     * @return context to draw the overview to, NULL to draw none
+     */
+    virtual Cairo::RefPtr<Cairo::Context> get_overview() { return Cairo::RefPtr<Cairo::Context>(); }
   
     virtual bool   scale_override() = 0;
     virtual void   get_dimensions(double &width, double &height) = 0;
@@ -58,9 +70,24 @@ class CairoRenderInstructor
                y2;
     };
 
+    /** bezier segment of an edge */
+    struct edge_segment {
+        /** the edge as "from" --"label"--> "to" */
+        std::string edge;
+        /** X coordinates of the control points */
+        double x[4];
+        /** Y coordinates of the control points */
+        double y[4];
+    };
+
     /** list of boundingboxes for the node labels */
     std::map<std::string, box>  clickable_nodes;
+    /** list of the bezier segments of the edges */
+    std::vector<edge_segment>   clickable_edges;
 };
 
-extern void gvplugin_cairo_setup(GVC_t *gvc,
+extern void gvplugin_cairo_setup(GVC_t *gvc);
+extern boost::mutex &gvplugin_cairo_mutex();
+extern SceneReconstruction::TextCache &gvplugin_cairo_text_cache();
+extern int  gvplugin_cairo_render(GVC_t *gvc, graph_t *g,
 					  CairoRenderInstructor *cri);
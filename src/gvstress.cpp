@@ -0,0 +1,208 @@
+#include "kidgraph.h"
+#include "graph_layouter.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <cairo.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+
+using namespace SceneReconstruction;
+
+namespace {
+  /** builds a random KID graph with some marks
+   *  @param seed seed of the graph
+   *  @return the graph in the dot language
+   */
+  std::string random_graph(unsigned int seed)
+  {
+    KIDGraph graph;
+    int nodes = 5 + rand_r(&seed) % 40;
+    for(int i = 0; i < nodes; i++)
+      graph.add_node("n"+boost::lexical_cast<std::string>(i), (KIDGraph::Level)(rand_r(&seed) % KIDGraph::LEVELS));
+    int edges = nodes + rand_r(&seed) % (2*nodes);
+    for(int i = 0; i < edges; i++) {
+      KIDGraph::KIDEdge edge;
+      edge.from = "n"+boost::lexical_cast<std::string>(rand_r(&seed) % nodes);
+      edge.to = "n"+boost::lexical_cast<std::string>(rand_r(&seed) % nodes);
+      edge.label = "e"+boost::lexical_cast<std::string>(i);
+      if(edge.from != edge.to)
+        graph.add_edge(edge);
+    }
+    if(rand_r(&seed) % 2)
+      graph.mark_node("n"+boost::lexical_cast<std::string>(rand_r(&seed) % nodes));
+
+    return graph.get_dot();
+  }
+
+  /** replays a recording onto an image, the C API is used since
+   *  cairomm counts the references of its RefPtr without atomics
+   *  @param recording the recording
+   *  @param w width in graph units
+   *  @param h height in graph units
+   *  @param scale scale of the image
+   *  @return hash of the pixels
+   */
+  unsigned long long replay(cairo_surface_t *recording, double w, double h, double scale)
+  {
+    int pw = (int)(w*scale) + 1, ph = (int)(h*scale) + 1;
+    cairo_surface_t *img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pw, ph);
+    cairo_t *cr = cairo_create(img);
+    cairo_scale(cr, scale, scale);
+    cairo_set_source_surface(cr, recording, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(img);
+    std::string pixels((const char *)cairo_image_surface_get_data(img), cairo_image_surface_get_stride(img)*ph);
+    cairo_surface_destroy(img);
+    return GraphLayouter::hash(pixels);
+  }
+
+  /** queries the hit grids of a rendering on a raster of points
+   *  @param r the rendering
+   *  @return hash of the hits
+   */
+  unsigned long long hit_test(const GraphRendering &r)
+  {
+    std::ostringstream out;
+    std::vector<int> hits;
+    for(int j = 0; j <= 32; j++) {
+      for(int i = 0; i <= 32; i++) {
+        double x = r.bbw*i/32, y = r.bbh*j/32;
+        r.node_grid.query(x, y, hits);
+        for(size_t k = 0; k < hits.size(); k++)
+          out << hits[k] << " ";
+        r.edge_grid.query(HitGrid::Box(x - 4, y - 4, x + 4, y + 4), hits);
+        for(size_t k = 0; k < hits.size(); k++)
+          out << hits[k] << " ";
+        out << ";";
+      }
+    }
+    return GraphLayouter::hash(out.str());
+  }
+
+  /** uses a rendering the way the drawing area and the exporter do
+   *  @param r the rendering
+   *  @return hash of the results, 0 if there is no recording
+   */
+  unsigned long long check(const GraphRendering &r)
+  {
+    if(!r.recording)
+      return 0;
+
+    unsigned long long h = replay(r.recording->cobj(), r.bbw, r.bbh, 1.0);
+    if(r.overview)
+      h = h*31 + replay(r.overview->cobj(), r.bbw, r.bbh, 0.25);
+    return h*31 + hit_test(r);
+  }
+
+  /** checks all renderings, shared with the other checkers */
+  struct Checker {
+    /** the renderings */
+    const std::vector<GraphRenderingPtr>   *renderings;
+    /** results, by rendering */
+    std::vector<unsigned long long>        *results;
+    /** first rendering of this checker, the checkers start apart so
+     *  they use the same renderings at different times */
+    size_t                                  first;
+
+    /** checks the renderings */
+    void operator()() {
+      size_t n = renderings->size();
+      for(size_t i = 0; i < n; i++)
+        (*results)[(first + i) % n] = check(*(*renderings)[(first + i) % n]);
+    }
+  };
+
+  /** checks all renderings on some threads, every thread checks all
+   *  renderings
+   *  @param renderings the renderings
+   *  @param threads number of threads
+   *  @param results receives the results of each thread
+   *  @return elapsed time in ms
+   */
+  double check_all(const std::vector<GraphRenderingPtr> &renderings, size_t threads, std::vector<std::vector<unsigned long long> > &results)
+  {
+    results.assign(threads, std::vector<unsigned long long>(renderings.size(), 0));
+    timeval start, end;
+    gettimeofday(&start, NULL);
+    boost::thread_group group;
+    for(size_t i = 0; i < threads; i++) {
+      Checker c;
+      c.renderings = &renderings;
+      c.results = &results[i];
+      c.first = i * renderings.size() / threads;
+      group.create_thread(c);
+    }
+    group.join_all();
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start.tv_sec)*1000.0 + (end.tv_usec - start.tv_usec)/1000.0;
+  }
+}
+
+/** lays out random KID graphs and then replays their recordings and
+ *  queries their hit grids on several threads at once, comparing the
+ *  results with a single threaded run. Calls into Graphviz are serialized
+ *  through gvplugin_cairo_mutex(), so the layouts are made on one thread,
+ *  the threads stress what runs without the lock on shared renderings.
+ */
+int main(int argc, char **argv) {
+  if(argc > 3) {
+    std::cerr << "usage: " << argv[0] << " [threads] [graphs]" << std::endl;
+    return 1;
+  }
+  size_t threads = argc > 1 ? atoi(argv[1]) : 4;
+  size_t count = argc > 2 ? atoi(argv[2]) : 64;
+  if(threads < 1 || count < 1) {
+    std::cerr << "threads and graphs have to be positive" << std::endl;
+    return 1;
+  }
+
+  timeval start, end;
+  gettimeofday(&start, NULL);
+  GVC_t *gvc;
+  {
+    boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+    gvc = gvContext();
+    gvplugin_cairo_setup(gvc);
+  }
+  std::vector<GraphRenderingPtr> renderings;
+  for(size_t i = 0; i < count; i++)
+    renderings.push_back(GraphLayouter::render(gvc, random_graph(i)));
+  {
+    boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+    gvFreeContext(gvc);
+  }
+  gettimeofday(&end, NULL);
+  double layout = (end.tv_sec - start.tv_sec)*1000.0 + (end.tv_usec - start.tv_usec)/1000.0;
+
+  std::vector<std::vector<unsigned long long> > reference, results;
+  double single = check_all(renderings, 1, reference);
+  double multi = check_all(renderings, threads, results);
+
+  size_t mismatches = 0;
+  for(size_t i = 0; i < count; i++) {
+    bool differs = reference[0][i] == 0;
+    for(size_t t = 0; t < threads; t++)
+      differs = differs || results[t][i] != reference[0][i];
+    if(differs) {
+      std::cerr << "graph " << i << " differs from the single threaded run" << std::endl;
+      mismatches++;
+    }
+  }
+
+  std::cout << count << " graphs laid out in " << layout << " ms" << std::endl;
+  std::cout << "replay and hit tests, 1 thread: " << single << " ms, " << threads << " threads: " << multi << " ms, " << mismatches << " mismatches" << std::endl;
+
+  unsigned long hits, misses, evictions;
+  size_t cached;
+  gvplugin_cairo_text_cache().get_stats(hits, misses, evictions, cached);
+  std::cout << "text cache: " << hits << " hits, " << misses << " misses, " << evictions << " evictions, " << cached << " texts" << std::endl;
+  return mismatches ? 1 : 0;
+}
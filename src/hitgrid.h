@@ -0,0 +1,197 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace SceneReconstruction {
+/** @class HitGrid "hitgrid.h"
+ *  Uniform grid over axis-aligned boxes for hit-testing. Every box is
+ *  registered in the cells it overlaps, the cells are stored compactly
+ *  one after another, so a query only looks at the boxes of the few
+ *  cells around the queried point. The grid is built once and is
+ *  read-only afterwards, so it can be queried from any thread.
+ *  @author Bastian Klingen
+ */
+  class HitGrid {
+    public:
+      /** axis-aligned box */
+      struct Box {
+        /** left border */
+        double x1;
+        /** top border */
+        double y1;
+        /** right border */
+        double x2;
+        /** bottom border */
+        double y2;
+
+        /** Constructor */
+        Box() : x1(0), y1(0), x2(0), y2(0) {}
+        /** Constructor
+         *  @param _x1 left border
+         *  @param _y1 top border
+         *  @param _x2 right border
+         *  @param _y2 bottom border
+         */
+        Box(double _x1, double _y1, double _x2, double _y2) : x1(_x1), y1(_y1), x2(_x2), y2(_y2) {}
+      };
+
+      /** Constructor */
+      HitGrid() : x0(0), y0(0), cell(1), cols(0), rows(0) {}
+
+      /** adds a box, the grid has to be built again afterwards
+       *  @param box the box
+       *  @return index of the box
+       */
+      int add(const Box &box) {
+        boxes.push_back(box);
+        return boxes.size()-1;
+      }
+
+      /** gets an added box
+       *  @param i index of the box
+       *  @return the box
+       */
+      const Box& get_box(int i) const {
+        return boxes[i];
+      }
+
+      /** number of added boxes
+       *  @return number of boxes
+       */
+      int size() const {
+        return boxes.size();
+      }
+
+      /** distributes the added boxes over the grid cells
+       *  the cell size follows the average box size, the number of
+       *  cells is limited to a few per box
+       */
+      void build() {
+        offsets.clear();
+        entries.clear();
+        cols = rows = 0;
+        if(boxes.empty())
+          return;
+
+        double minx = boxes[0].x1, miny = boxes[0].y1, maxx = boxes[0].x2, maxy = boxes[0].y2;
+        double sizes = 0;
+        for(size_t i = 0; i < boxes.size(); i++) {
+          minx = std::min(minx, boxes[i].x1);
+          miny = std::min(miny, boxes[i].y1);
+          maxx = std::max(maxx, boxes[i].x2);
+          maxy = std::max(maxy, boxes[i].y2);
+          sizes += (boxes[i].x2 - boxes[i].x1) + (boxes[i].y2 - boxes[i].y1);
+        }
+
+        double width = std::max(maxx - minx, 1.0), height = std::max(maxy - miny, 1.0);
+        cell = std::max(sizes / (2*boxes.size()), 1.0);
+        double max_cells = 4.0*boxes.size() + 16;
+        if((width/cell) * (height/cell) > max_cells)
+          cell = std::sqrt(width*height / max_cells);
+        x0 = minx;
+        y0 = miny;
+        cols = (int)(width / cell) + 1;
+        rows = (int)(height / cell) + 1;
+
+        // count the entries of each cell, then fill them in place
+        offsets.assign(cols*rows + 1, 0);
+        for(size_t i = 0; i < boxes.size(); i++) {
+          int cx1, cy1, cx2, cy2;
+          cells(boxes[i], cx1, cy1, cx2, cy2);
+          for(int cy = cy1; cy <= cy2; cy++)
+            for(int cx = cx1; cx <= cx2; cx++)
+              offsets[cy*cols + cx + 1]++;
+        }
+        for(size_t c = 1; c < offsets.size(); c++)
+          offsets[c] += offsets[c-1];
+        entries.resize(offsets.back());
+        std::vector<int> fill(offsets.begin(), offsets.end()-1);
+        for(size_t i = 0; i < boxes.size(); i++) {
+          int cx1, cy1, cx2, cy2;
+          cells(boxes[i], cx1, cy1, cx2, cy2);
+          for(int cy = cy1; cy <= cy2; cy++)
+            for(int cx = cx1; cx <= cx2; cx++)
+              entries[fill[cy*cols + cx]++] = i;
+        }
+      }
+
+      /** finds the boxes overlapping an area
+       *  @param area the queried area
+       *  @param hits receives the indices of the boxes in ascending order
+       */
+      void query(const Box &area, std::vector<int> &hits) const {
+        hits.clear();
+        if(cols == 0 || area.x2 < x0 || area.y2 < y0 || area.x1 > x0 + cols*cell || area.y1 > y0 + rows*cell)
+          return;
+
+        int cx1, cy1, cx2, cy2;
+        cells(area, cx1, cy1, cx2, cy2);
+        for(int cy = cy1; cy <= cy2; cy++) {
+          for(int cx = cx1; cx <= cx2; cx++) {
+            for(int e = offsets[cy*cols + cx]; e < offsets[cy*cols + cx + 1]; e++) {
+              const Box &b = boxes[entries[e]];
+              if(b.x1 <= area.x2 && b.x2 >= area.x1 && b.y1 <= area.y2 && b.y2 >= area.y1)
+                hits.push_back(entries[e]);
+            }
+          }
+        }
+        // boxes spanning several cells are found once per cell
+        if(cx1 != cx2 || cy1 != cy2) {
+          std::sort(hits.begin(), hits.end());
+          hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+        }
+      }
+
+      /** finds the boxes containing a point
+       *  @param x x coordinate of the point
+       *  @param y y coordinate of the point
+       *  @param hits receives the indices of the boxes in ascending order
+       */
+      void query(double x, double y, std::vector<int> &hits) const {
+        query(Box(x, y, x, y), hits);
+      }
+
+    private:
+      /** computes the cells covered by a box, clamped to the grid
+       *  @param b the box
+       *  @param cx1 first column
+       *  @param cy1 first row
+       *  @param cx2 last column
+       *  @param cy2 last row
+       */
+      void cells(const Box &b, int &cx1, int &cy1, int &cx2, int &cy2) const {
+        cx1 = clamp((b.x1 - x0) / cell, cols);
+        cy1 = clamp((b.y1 - y0) / cell, rows);
+        cx2 = clamp((b.x2 - x0) / cell, cols);
+        cy2 = clamp((b.y2 - y0) / cell, rows);
+      }
+
+      /** converts a coordinate in cells to a cell index inside the grid
+       *  @param v coordinate in cells
+       *  @param n number of cells
+       *  @return the index
+       */
+      static int clamp(double v, int n) {
+        if(v < 0)
+          return 0;
+        if(v >= n)
+          return n-1;
+        return (int)v;
+      }
+
+    private:
+      /** the added boxes */
+      std::vector<Box>  boxes;
+      /** first entry of each cell, the last element ends the last cell */
+      std::vector<int>  offsets;
+      /** indices of the boxes in each cell */
+      std::vector<int>  entries;
+      /** origin of the grid */
+      double            x0, y0;
+      /** edge length of the cells */
+      double            cell;
+      /** number of columns and rows */
+      int               cols, rows;
+  };
+}
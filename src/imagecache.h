@@ -0,0 +1,224 @@
+#pragma once
+#include <string>
+#include <list>
+#include <map>
+#include <algorithm>
+
+#include <gdkmm/pixbuf.h>
+
+namespace SceneReconstruction {
+/** @class ImageCache "imagecache.h"
+ *  Least recently used cache of document images with a byte budget.
+ *  Next to the image, each entry keeps the scaled variants requested by
+ *  get_scaled, e.g. the previews of the tabs, so showing an image again
+ *  neither converts nor rescales it. The bytes of the variants count
+ *  against the budget. Images loaded from files are pinned and never
+ *  evicted. The cache is shared by the tabs and only used on the GUI
+ *  thread.
+ *  @author Bastian Klingen
+ */
+  class ImageCache {
+    public:
+      /** default budget, 256 MB */
+      static const size_t DEFAULT_BUDGET = 256 << 20;
+
+      /** Constructor
+       *  @param _budget number of bytes to keep
+       */
+      ImageCache(size_t _budget = DEFAULT_BUDGET) : budget(_budget), bytes(0), hits(0), misses(0), evictions(0) {}
+
+      /** gets the cache shared by the tabs
+       *  @return the cache
+       */
+      static ImageCache& shared() {
+        static ImageCache cache;
+        return cache;
+      }
+
+      /** checks if an image is cached, does not count as use
+       *  @param key key of the image
+       *  @return true if the image is cached
+       */
+      bool contains(const std::string &key) const {
+        return index.find(key) != index.end();
+      }
+
+      /** adds an image, replaces an image with the same key
+       *  @param key key of the image
+       *  @param image the image, an empty pointer is ignored
+       *  @param pinned true to never evict the image
+       */
+      void put(const std::string &key, const Glib::RefPtr<Gdk::Pixbuf> &image, bool pinned = false) {
+        if(!image)
+          return;
+        remove(key);
+        Entry entry;
+        entry.key = key;
+        entry.image = image;
+        entry.bytes = size_of(image);
+        entry.pinned = pinned;
+        entries.push_front(entry);
+        index[key] = entries.begin();
+        bytes += entry.bytes;
+        evict();
+      }
+
+      /** gets an image
+       *  @param key key of the image
+       *  @return the image or an empty pointer if it is not cached
+       */
+      Glib::RefPtr<Gdk::Pixbuf> get(const std::string &key) {
+        EntryList::iterator e = find(key);
+        if(e == entries.end())
+          return Glib::RefPtr<Gdk::Pixbuf>();
+        return e->image;
+      }
+
+      /** gets an image scaled to fit into a box, keeping its aspect ratio,
+       *  the variant is only scaled on the first request
+       *  @param key key of the image
+       *  @param width width of the box
+       *  @param height height of the box
+       *  @return the scaled image or an empty pointer if it is not cached
+       */
+      Glib::RefPtr<Gdk::Pixbuf> get_scaled(const std::string &key, int width, int height) {
+        EntryList::iterator e = find(key);
+        if(e == entries.end())
+          return Glib::RefPtr<Gdk::Pixbuf>();
+
+        std::pair<int, int> size(width, height);
+        VariantMap::iterator v = e->variants.find(size);
+        if(v != e->variants.end())
+          return v->second;
+
+        double scale_w = (double)width/e->image->get_width();
+        double scale_h = (double)height/e->image->get_height();
+        double scale = scale_w<scale_h?scale_w:scale_h;
+        Glib::RefPtr<Gdk::Pixbuf> variant = e->image->scale_simple(std::max(1, (int)(e->image->get_width()*scale)),
+                                                                   std::max(1, (int)(e->image->get_height()*scale)),
+                                                                   Gdk::INTERP_BILINEAR);
+        e->variants[size] = variant;
+        e->bytes += size_of(variant);
+        bytes += size_of(variant);
+        // the entry is the most recently used one and is not evicted
+        evict();
+        return variant;
+      }
+
+      /** loads an image file once and keeps it pinned
+       *  @param filename name of the file
+       *  @return the image
+       */
+      Glib::RefPtr<Gdk::Pixbuf> load_file(const std::string &filename) {
+        std::string key = file_key(filename);
+        Glib::RefPtr<Gdk::Pixbuf> image = get(key);
+        if(!image) {
+          image = Gdk::Pixbuf::create_from_file(filename);
+          put(key, image, true);
+        }
+        return image;
+      }
+
+      /** gets the key of a file loaded by load_file, e.g. for get_scaled
+       *  @param filename name of the file
+       *  @return the key
+       */
+      static std::string file_key(const std::string &filename) {
+        return "file:"+filename;
+      }
+
+      /** removes an image and its variants
+       *  @param key key of the image
+       */
+      void remove(const std::string &key) {
+        EntryIndex::iterator i = index.find(key);
+        if(i == index.end())
+          return;
+        bytes -= i->second->bytes;
+        entries.erase(i->second);
+        index.erase(i);
+      }
+
+      /** gets the counters of the cache
+       *  @param _hits upon return contains the number of images found in the cache
+       *  @param _misses upon return contains the number of images not found
+       *  @param _evictions upon return contains the number of images dropped for newer ones
+       *  @param _bytes upon return contains the bytes of the cached images and variants
+       */
+      void get_stats(unsigned long &_hits, unsigned long &_misses, unsigned long &_evictions, size_t &_bytes) const {
+        _hits = hits;
+        _misses = misses;
+        _evictions = evictions;
+        _bytes = bytes;
+      }
+
+    private:
+      typedef std::map<std::pair<int, int>, Glib::RefPtr<Gdk::Pixbuf> > VariantMap;
+
+      /** a cached image */
+      struct Entry {
+        std::string                key;
+        Glib::RefPtr<Gdk::Pixbuf>  image;
+        /** scaled variants by size of the box */
+        VariantMap                 variants;
+        /** bytes of the image and its variants */
+        size_t                     bytes;
+        bool                       pinned;
+      };
+
+      typedef std::list<Entry>                           EntryList;
+      typedef std::map<std::string, EntryList::iterator> EntryIndex;
+
+      /** finds an entry and marks it as most recently used
+       *  @param key key of the image
+       *  @return the entry or entries.end()
+       */
+      EntryList::iterator find(const std::string &key) {
+        EntryIndex::iterator i = index.find(key);
+        if(i == index.end()) {
+          misses++;
+          return entries.end();
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, i->second);
+        return i->second;
+      }
+
+      /** evicts the least recently used images until the budget is met,
+       *  the most recently used image is always kept */
+      void evict() {
+        EntryList::iterator e = entries.end();
+        while(bytes > budget && e != entries.begin()) {
+          e--;
+          if(e == entries.begin())
+            break;
+          if(e->pinned)
+            continue;
+          bytes -= e->bytes;
+          index.erase(e->key);
+          e = entries.erase(e);
+          evictions++;
+        }
+      }
+
+      /** gets the memory used by the pixels of an image
+       *  @param image the image
+       *  @return the number of bytes
+       */
+      static size_t size_of(const Glib::RefPtr<Gdk::Pixbuf> &image) {
+        return (size_t)image->get_rowstride() * image->get_height();
+      }
+
+    private:
+      /** the cached images, most recently used first */
+      EntryList          entries;
+      /** the cached images by key */
+      EntryIndex         index;
+      /** maximum number of bytes to keep */
+      size_t             budget;
+      /** bytes of the cached images and variants */
+      size_t             bytes;
+      /** counters */
+      unsigned long      hits, misses, evictions;
+  };
+}
@@ -0,0 +1,432 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/cstdint.hpp>
+
+namespace SceneReconstruction {
+/** @class KGBFile "kgbfile.h"
+ *  Read-only view of a binary KID graph file (.kgb). The file is mapped
+ *  into memory and all sections are used in place, there is no parse step.
+ *
+ *  Layout, all values in host byte order, sections aligned to 8 bytes:
+ *  - header: magic "KIDGRAPH", uint32 version, uint32 byte order mark
+ *    0x01020304, uint32 number of sections, uint32 reserved
+ *  - section table: per section uint32 type, uint32 count, uint64 offset, uint64 size
+ *  - STRINGS: uint64 offsets[count+1] into the following characters, every
+ *    string is followed by a 0 byte
+ *  - GRAPH:   uint32 string of the graph name
+ *  - NODES:   uint32 string of the name per node id
+ *  - LEVELS:  uint32 first node id and uint32 number of nodes per level,
+ *    nodes are stored level by level
+ *  - EDGES:   uint32 from, to and label string per edge
+ *  - MARKED:  uint32 ids of the marked nodes (optional)
+ *  - ROOTS:   uint32 ids of the marked roots (optional)
+ *  - POSITIONS: double x and y per node id, NaN if the node has no position (optional)
+ *
+ *  Readers skip unknown section types, incompatible changes increase the version.
+ *  @author Bastian Klingen
+ */
+  class KGBFile {
+    public:
+      /** current version of the format */
+      enum { VERSION = 1 };
+
+      /** section types */
+      enum Section {
+        STRINGS   = 1,
+        GRAPH     = 2,
+        NODES     = 3,
+        LEVELS    = 4,
+        EDGES     = 5,
+        MARKED    = 6,
+        ROOTS     = 7,
+        POSITIONS = 8
+      };
+
+      /** an edge as stored in the file */
+      struct Edge {
+        /** id of the node from which the edge comes */
+        boost::uint32_t from;
+        /** id of the node to which the edge points */
+        boost::uint32_t to;
+        /** string of the label */
+        boost::uint32_t label;
+      };
+
+      /** Constructor */
+      KGBFile() : data(NULL), length(0), mapped(false) {
+        clear_sections();
+      }
+
+      /** Destructor */
+      ~KGBFile() {
+        close();
+      }
+
+      /** checks if a buffer starts like a binary KID graph
+       *  @param data the buffer
+       *  @param length length of the buffer
+       *  @return true if the buffer starts with the magic
+       */
+      static bool is_binary(const char *data, size_t length) {
+        return length >= 8 && memcmp(data, "KIDGRAPH", 8) == 0;
+      }
+
+      /** maps a file and checks its structure
+       *  @param filename name of the file
+       *  @param error receives a description of the problem
+       *  @return true if the file is a valid binary KID graph
+       */
+      bool open(std::string filename, std::string *error = NULL) {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+          return fail(error, "could not open "+filename);
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0) {
+          ::close(fd);
+          return fail(error, "empty file");
+        }
+
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED)
+          return fail(error, "could not map "+filename);
+
+        mapped = true;
+        return attach(static_cast<const char*>(map), st.st_size, error);
+      }
+
+      /** uses a buffer that stays valid as long as this view is used
+       *  @param buffer the buffer, aligned to 8 bytes
+       *  @param size length of the buffer
+       *  @param error receives a description of the problem
+       *  @return true if the buffer is a valid binary KID graph
+       */
+      bool attach(const char *buffer, size_t size, std::string *error = NULL) {
+        data = buffer;
+        length = size;
+        clear_sections();
+
+        if(!is_binary(data, length) || length < 24)
+          return fail(error, "not a binary KID graph");
+        if(u32(8) == 0 || u32(8) > VERSION)
+          return fail(error, "unsupported version");
+        if(u32(12) != 0x01020304)
+          return fail(error, "unsupported byte order");
+
+        boost::uint32_t sections = u32(16);
+        if(24 + (boost::uint64_t)sections*24 > length)
+          return fail(error, "truncated section table");
+
+        for(boost::uint32_t i = 0; i < sections; i++) {
+          size_t entry = 24 + i*24;
+          boost::uint32_t type  = u32(entry);
+          boost::uint32_t count = u32(entry+4);
+          boost::uint64_t offset, size;
+          memcpy(&offset, data+entry+8, 8);
+          memcpy(&size, data+entry+16, 8);
+          if(offset > length || size > length - offset || offset % 8 != 0)
+            return fail(error, "section outside of the file");
+          if(type >= STRINGS && type <= POSITIONS) {
+            section_data[type] = data + offset;
+            section_size[type] = size;
+            section_count[type] = count;
+          }
+        }
+
+        // check the sizes, so the accessors do not need to
+        if(!section_data[STRINGS] || !section_data[GRAPH] || !section_data[NODES] || !section_data[LEVELS] || !section_data[EDGES])
+          return fail(error, "missing section");
+        boost::uint64_t strings = section_count[STRINGS];
+        if(section_size[STRINGS] < (strings+1)*8)
+          return fail(error, "truncated string table");
+        const boost::uint64_t *offsets = reinterpret_cast<const boost::uint64_t*>(section_data[STRINGS]);
+        boost::uint64_t chars = section_size[STRINGS] - (strings+1)*8;
+        // every string takes at least its 0 byte, so the offsets strictly increase
+        if(offsets[0] != 0)
+          return fail(error, "invalid string table");
+        for(boost::uint64_t i = 0; i < strings; i++) {
+          if(offsets[i] >= offsets[i+1] || offsets[i+1] > chars || section_data[STRINGS][(strings+1)*8 + offsets[i+1]-1] != 0)
+            return fail(error, "invalid string table");
+        }
+        if(section_size[GRAPH] < 4 || ids(GRAPH)[0] >= strings)
+          return fail(error, "invalid graph section");
+        if(section_size[NODES] < (boost::uint64_t)section_count[NODES]*4)
+          return fail(error, "truncated node section");
+        for(boost::uint32_t i = 0; i < section_count[NODES]; i++)
+          if(ids(NODES)[i] >= strings)
+            return fail(error, "invalid node name");
+        if(section_count[LEVELS] != 3 || section_size[LEVELS] < 24)
+          return fail(error, "invalid level section");
+        boost::uint64_t next = 0;
+        for(int l = 0; l < 3; l++) {
+          if(level_first(l) != next)
+            return fail(error, "levels are not contiguous");
+          next += level_size(l);
+        }
+        if(next != section_count[NODES])
+          return fail(error, "levels do not cover all nodes");
+        if(section_size[EDGES] < (boost::uint64_t)section_count[EDGES]*sizeof(Edge))
+          return fail(error, "truncated edge section");
+        for(boost::uint32_t i = 0; i < section_count[EDGES]; i++) {
+          const Edge &e = edge(i);
+          if(e.from >= section_count[NODES] || e.to >= section_count[NODES] || e.label >= strings)
+            return fail(error, "invalid edge");
+        }
+        for(int s = MARKED; s <= ROOTS; s++) {
+          if(!section_data[s])
+            continue;
+          if(section_size[s] < (boost::uint64_t)section_count[s]*4)
+            return fail(error, "truncated mark section");
+          for(boost::uint32_t i = 0; i < section_count[s]; i++)
+            if(ids(s)[i] >= section_count[NODES])
+              return fail(error, "invalid mark");
+        }
+        if(section_data[POSITIONS] && (section_count[POSITIONS] != section_count[NODES] || section_size[POSITIONS] < (boost::uint64_t)section_count[NODES]*16))
+          return fail(error, "invalid position section");
+
+        return true;
+      }
+
+      /** unmaps the file */
+      void close() {
+        if(mapped && data)
+          munmap(const_cast<char*>(data), length);
+        data = NULL;
+        length = 0;
+        mapped = false;
+        clear_sections();
+      }
+
+      /** get a string of the string table
+       *  @param index index of the string
+       *  @return the 0 terminated string
+       */
+      const char* string(boost::uint32_t index) const {
+        const boost::uint64_t *offsets = reinterpret_cast<const boost::uint64_t*>(section_data[STRINGS]);
+        return section_data[STRINGS] + (section_count[STRINGS]+1)*8 + offsets[index];
+      }
+
+      /** get the length of a string of the string table
+       *  @param index index of the string
+       *  @return length of the string without the 0 byte
+       */
+      size_t string_length(boost::uint32_t index) const {
+        const boost::uint64_t *offsets = reinterpret_cast<const boost::uint64_t*>(section_data[STRINGS]);
+        return offsets[index+1] - offsets[index] - 1;
+      }
+
+      /** get the name of the graph
+       *  @return index of the name in the string table
+       */
+      boost::uint32_t name() const {
+        return ids(GRAPH)[0];
+      }
+
+      /** get the number of nodes
+       *  @return number of nodes
+       */
+      boost::uint32_t node_count() const {
+        return section_count[NODES];
+      }
+
+      /** get the name of a node
+       *  @param node id of the node
+       *  @return index of the name in the string table
+       */
+      boost::uint32_t node_name(boost::uint32_t node) const {
+        return ids(NODES)[node];
+      }
+
+      /** get the first node of a level
+       *  @param level the level
+       *  @return id of the first node
+       */
+      boost::uint32_t level_first(int level) const {
+        return ids(LEVELS)[level];
+      }
+
+      /** get the number of nodes of a level
+       *  @param level the level
+       *  @return number of nodes
+       */
+      boost::uint32_t level_size(int level) const {
+        return ids(LEVELS)[3+level];
+      }
+
+      /** get the number of edges
+       *  @return number of edges
+       */
+      boost::uint32_t edge_count() const {
+        return section_count[EDGES];
+      }
+
+      /** get an edge
+       *  @param index index of the edge
+       *  @return the edge
+       */
+      const Edge& edge(boost::uint32_t index) const {
+        return reinterpret_cast<const Edge*>(section_data[EDGES])[index];
+      }
+
+      /** get the number of entries of the MARKED or ROOTS section
+       *  @param section MARKED or ROOTS
+       *  @return number of entries, 0 if the section is missing
+       */
+      boost::uint32_t mark_count(Section section) const {
+        return section_data[section] ? section_count[section] : 0;
+      }
+
+      /** get an entry of the MARKED or ROOTS section
+       *  @param section MARKED or ROOTS
+       *  @param index index of the entry
+       *  @return id of the node
+       */
+      boost::uint32_t mark(Section section, boost::uint32_t index) const {
+        return ids(section)[index];
+      }
+
+      /** checks if the file stores node positions
+       *  @return true if the POSITIONS section exists
+       */
+      bool has_positions() const {
+        return section_data[POSITIONS] != NULL;
+      }
+
+      /** get the position of a node, NaN if the node has none
+       *  @param node id of the node
+       *  @return pointer to x and y
+       */
+      const double* position(boost::uint32_t node) const {
+        return reinterpret_cast<const double*>(section_data[POSITIONS]) + 2*node;
+      }
+
+    private:
+      boost::uint32_t u32(size_t offset) const {
+        boost::uint32_t value;
+        memcpy(&value, data+offset, 4);
+        return value;
+      }
+
+      const boost::uint32_t* ids(int section) const {
+        return reinterpret_cast<const boost::uint32_t*>(section_data[section]);
+      }
+
+      void clear_sections() {
+        for(int i = 0; i <= POSITIONS; i++) {
+          section_data[i] = NULL;
+          section_size[i] = 0;
+          section_count[i] = 0;
+        }
+      }
+
+      bool fail(std::string *error, const std::string &message) {
+        if(error)
+          *error = message;
+        close();
+        return false;
+      }
+
+    private:
+      const char         *data;
+      size_t              length;
+      bool                mapped;
+      const char         *section_data[POSITIONS+1];
+      boost::uint64_t     section_size[POSITIONS+1];
+      boost::uint32_t     section_count[POSITIONS+1];
+  };
+
+/** @class KGBWriter "kgbfile.h"
+ *  Collects the sections of a binary KID graph file and writes them.
+ *  @author Bastian Klingen
+ */
+  class KGBWriter {
+    public:
+      /** adds a section
+       *  @param type type of the section
+       *  @param count number of entries
+       *  @param content raw content of the section
+       */
+      void add(KGBFile::Section type, boost::uint32_t count, const std::string &content) {
+        types.push_back(type);
+        counts.push_back(count);
+        contents.push_back(content);
+      }
+
+      /** builds the STRINGS section content
+       *  @param strings the strings
+       *  @return content of the section
+       */
+      static std::string string_table(const std::vector<std::string> &strings) {
+        std::vector<boost::uint64_t> offsets(strings.size()+1, 0);
+        std::string chars;
+        for(size_t i = 0; i < strings.size(); i++) {
+          chars.append(strings[i]);
+          chars.push_back('\0');
+          offsets[i+1] = chars.size();
+        }
+        std::string content(reinterpret_cast<const char*>(&offsets[0]), offsets.size()*8);
+        content.append(chars);
+        return content;
+      }
+
+      /** builds a section content from an array
+       *  @param values the values
+       *  @return content of the section
+       */
+      template<class T>
+      static std::string array(const std::vector<T> &values) {
+        if(values.empty())
+          return "";
+        return std::string(reinterpret_cast<const char*>(&values[0]), values.size()*sizeof(T));
+      }
+
+      /** writes the file
+       *  @param filename name of the file
+       *  @return true if the file was written
+       */
+      bool write(std::string filename) {
+        FILE *f = fopen(filename.c_str(), "wb");
+        if(!f)
+          return false;
+
+        boost::uint32_t header[4] = { KGBFile::VERSION, 0x01020304, (boost::uint32_t)types.size(), 0 };
+        bool ok = fwrite("KIDGRAPH", 1, 8, f) == 8;
+        ok = ok && fwrite(header, 4, 4, f) == 4;
+
+        boost::uint64_t offset = 24 + types.size()*24;
+        for(size_t i = 0; i < types.size(); i++) {
+          boost::uint32_t entry[2] = { (boost::uint32_t)types[i], counts[i] };
+          boost::uint64_t where[2] = { offset, contents[i].size() };
+          ok = ok && fwrite(entry, 4, 2, f) == 2;
+          ok = ok && fwrite(where, 8, 2, f) == 2;
+          offset += (contents[i].size()+7) & ~(boost::uint64_t)7;
+        }
+
+        static const char padding[8] = { 0 };
+        for(size_t i = 0; i < types.size(); i++) {
+          ok = ok && fwrite(contents[i].data(), 1, contents[i].size(), f) == contents[i].size();
+          size_t pad = ((contents[i].size()+7) & ~(size_t)7) - contents[i].size();
+          ok = ok && fwrite(padding, 1, pad, f) == pad;
+        }
+
+        return (fclose(f) == 0) && ok;
+      }
+
+    private:
+      std::vector<KGBFile::Section>     types;
+      std::vector<boost::uint32_t>      counts;
+      std::vector<std::string>          contents;
+  };
+}
@@ -0,0 +1,58 @@
+#include "kidgraph.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace SceneReconstruction;
+
+/** converts KID graphs between the text (.kgf) and the binary (.kgb) format
+ *  the input format is detected from the content, the output format from
+ *  the extension of the output file
+ */
+int main(int argc, char **argv) {
+  if(argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <input.kgf|input.kgb> <output.kgf|output.kgb>" << std::endl;
+    return 1;
+  }
+
+  std::string input = argv[1];
+  std::string output = argv[2];
+
+  KIDGraph graph;
+  std::string error;
+  if(!graph.load_file(input, &error)) {
+    std::cerr << input << ": " << error << std::endl;
+    return 1;
+  }
+  if(!error.empty())
+    std::cerr << input << ": " << error << std::endl;
+
+  std::string extension = "";
+  size_t ext_pos = output.rfind(".");
+  if(ext_pos != std::string::npos) {
+    extension = output.substr(ext_pos+1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  }
+
+  bool ok;
+  if(extension == "kgb") {
+    ok = graph.save_binary(output);
+  }
+  else {
+    // text files have no positions, keep the marks so the conversion is lossless
+    bool positions = false;
+    for(int i = 0; i < graph.node_count(); i++)
+      positions = positions || graph.get_node(i).positioned;
+    if(positions)
+      std::cerr << "warning: the text format does not store node positions" << std::endl;
+    ok = graph.save(output, true);
+  }
+
+  if(!ok) {
+    std::cerr << output << ": could not write file" << std::endl;
+    return 1;
+  }
+
+  std::cout << input << " -> " << output << ": " << graph.node_count() << " nodes, " << graph.get_edges().size() << " edges" << std::endl;
+  return 0;
+}
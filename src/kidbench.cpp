@@ -0,0 +1,305 @@
+#include "kidgraph.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+using namespace SceneReconstruction;
+
+namespace {
+  /** settings of the benchmark */
+  struct Settings {
+    /** number of edges of the graph */
+    int     edges;
+    /** number of marked roots */
+    int     roots;
+    /** number of edits of each kind */
+    int     iterations;
+    /** approximate size of the loaded files in megabytes */
+    int     megabytes;
+  };
+
+  /** gets the current time
+   *  @return the time in seconds
+   */
+  double now()
+  {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  /** gets the name of a generated node
+   *  @param id number of the node
+   *  @param format printf format of the name
+   *  @return the name
+   */
+  std::string node_name(int id, const char *format = "n%d")
+  {
+    char name[64];
+    snprintf(name, sizeof(name), format, id);
+    return name;
+  }
+
+  /** builds a layered graph like the ones of the framework, every information
+   *  and data node has two parents in the level above
+   *  @param graph the graph to fill
+   *  @param edges number of edges
+   *  @param seed seed of the graph
+   *  @param format printf format of the node names
+   */
+  void build_graph(KIDGraph &graph, int edges, unsigned int &seed, const char *format = "n%d")
+  {
+    int count = edges/2 + edges/18 + 1;
+    int first[KIDGraph::LEVELS+1] = { 0, count/10, count*4/10, count };
+    graph.clear();
+    graph.name = "kidbench";
+    for(int l = 0; l < KIDGraph::LEVELS; l++)
+      for(int i = first[l]; i < first[l+1]; i++)
+        graph.add_node(node_name(i, format), (KIDGraph::Level)l);
+
+    KIDGraph::KIDEdge edge;
+    for(int i = first[1]; i < count; i++) {
+      int l = (i < first[2] ? 1 : 2);
+      for(int p = 0; p < 2; p++) {
+        edge.from = node_name(first[l-1] + rand_r(&seed) % (first[l]-first[l-1]), format);
+        edge.to = node_name(i, format);
+        edge.label = (p ? "derived" : "");
+        graph.add_edge(edge);
+      }
+    }
+  }
+
+  /** checks the marks of a graph against a graph built and marked from scratch
+   *  @param graph the edited graph
+   *  @return true if both graphs mark the same nodes
+   */
+  bool check_marks(const KIDGraph &graph)
+  {
+    KIDGraph fresh;
+    for(int l = 0; l < KIDGraph::LEVELS; l++) {
+      const std::vector<int> &ids = graph.level_nodes((KIDGraph::Level)l);
+      for(size_t i = 0; i < ids.size(); i++)
+        fresh.add_node(graph.get_node(ids[i]).node, (KIDGraph::Level)l);
+    }
+    for(size_t i = 0; i < graph.get_edges().size(); i++)
+      fresh.add_edge(graph.get_edges()[i]);
+    for(int i = 0; i < graph.node_count(); i++)
+      if(graph.is_root(i))
+        fresh.mark_node(graph.get_node(i).node);
+
+    for(int i = 0; i < graph.node_count(); i++)
+      if(graph.is_marked(i) != fresh.is_marked(graph.get_node(i).node))
+        return false;
+    return true;
+  }
+
+  /** prints the time of one kind of edit
+   *  @param name name of the edit
+   *  @param time seconds of all edits
+   *  @param count number of edits
+   */
+  void report(const char *name, double time, int count)
+  {
+    std::cout << name << ": " << time/count*1000000.0 << " us" << std::endl;
+  }
+
+  /** gets the size of a file
+   *  @param filename name of the file
+   *  @return the size in megabytes
+   */
+  double file_size(const std::string &filename)
+  {
+    struct stat st;
+    if(stat(filename.c_str(), &st) != 0)
+      return 0;
+    return st.st_size / 1000000.0;
+  }
+
+  /** loads a file and compares it with the saved graph
+   *  @param filename name of the file
+   *  @param saved the saved graph
+   *  @return true if the loaded graph has the same nodes, edges and marks
+   */
+  bool check_load(const std::string &filename, const KIDGraph &saved)
+  {
+    KIDGraph graph;
+    std::string error;
+    double start = now();
+    bool ok = graph.load_file(filename, &error);
+    double time = now() - start;
+    std::cout << "load " << filename << ": " << file_size(filename) << " MB in " << time*1000 << " ms" << std::endl;
+    if(!ok || !error.empty()) {
+      std::cout << filename << ": " << error << std::endl;
+      return false;
+    }
+
+    if(graph.node_count() != saved.node_count() || graph.get_edges().size() != saved.get_edges().size())
+      return false;
+    for(int i = 0; i < saved.node_count(); i++) {
+      int id = graph.node_id(saved.get_node(i).node);
+      if(id < 0 || graph.get_node(id).level != saved.get_node(i).level || graph.is_marked(id) != saved.is_marked(i))
+        return false;
+    }
+    for(size_t i = 0; i < saved.get_edges().size(); i++)
+      if(!graph.is_edge(saved.get_edges()[i]))
+        return false;
+    return true;
+  }
+
+  /** loads corrupted copies of a kgb file, each has to be rejected
+   *  @param filename name of the valid file
+   *  @return true if every copy was rejected without loading a graph
+   */
+  bool check_corrupt(const std::string &filename)
+  {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if(!file)
+      return false;
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    // the sections have to be aligned to 8 bytes
+    std::vector<boost::uint64_t> valid((size+7)/8);
+    bool read = fread(&valid[0], 1, size, file) == size;
+    fclose(file);
+    if(!read)
+      return false;
+
+    // find the string table in the section table
+    const char *data = reinterpret_cast<const char*>(&valid[0]);
+    boost::uint32_t sections, type, strings = 0;
+    boost::uint64_t offset = 0;
+    memcpy(&sections, data+16, 4);
+    for(boost::uint32_t i = 0; i < sections; i++) {
+      memcpy(&type, data+24+i*24, 4);
+      if(type == KGBFile::STRINGS) {
+        memcpy(&strings, data+24+i*24+4, 4);
+        memcpy(&offset, data+24+i*24+8, 8);
+      }
+    }
+    if(strings < 2)
+      return false;
+
+    const char *names[] = { "version 0", "first string offset not 0", "equal string offsets", "string offset past the table" };
+    bool ok = true;
+    for(int c = 0; c < 4; c++) {
+      std::vector<boost::uint64_t> corrupt = valid;
+      char *bytes = reinterpret_cast<char*>(&corrupt[0]);
+      boost::uint64_t *offsets = &corrupt[offset/8];
+      switch(c) {
+        case 0: memset(bytes+8, 0, 4); break;
+        case 1: offsets[0] = 1; break;
+        case 2: offsets[2] = offsets[1]; break;
+        case 3: offsets[strings] += 8; break;
+      }
+
+      KGBFile kgb;
+      KIDGraph graph;
+      std::string error;
+      bool rejected = !(kgb.attach(bytes, size, &error) && graph.load_binary(kgb, &error));
+      std::cout << "corrupt kgb, " << names[c] << ": " << (rejected ? "rejected, "+error : "ACCEPTED") << std::endl;
+      ok = ok && rejected && graph.node_count() == 0;
+    }
+    return ok;
+  }
+}
+
+/** measures the edits of a marked KID graph and checks the incrementally
+ *  counted marks against a graph marked from scratch, then measures
+ *  loading the graph from kgf and kgb files and checks that corrupted
+ *  kgb files are rejected
+ */
+int main(int argc, char **argv) {
+  Settings settings;
+  settings.edges = 100000;
+  settings.roots = 100;
+  settings.iterations = 1000;
+  settings.megabytes = 50;
+  if(argc > 1)
+    settings.edges = atoi(argv[1]);
+  if(argc > 2)
+    settings.roots = atoi(argv[2]);
+  if(argc > 3)
+    settings.iterations = atoi(argv[3]);
+  if(argc > 4)
+    settings.megabytes = atoi(argv[4]);
+  if(argc > 5 || settings.edges < 20 || settings.roots < 0 || settings.iterations < 1 || settings.megabytes < 0) {
+    std::cerr << "usage: " << argv[0] << " [edges] [marked roots] [iterations] [megabytes of the loaded files]" << std::endl;
+    return 1;
+  }
+
+  bool ok = true;
+  for(int index = 0; index < 2; index++) {
+    unsigned int seed = 1;
+    KIDGraph graph;
+    graph.set_reachability_index(index);
+    double start = now();
+    build_graph(graph, settings.edges, seed);
+    std::cout << "graph: " << graph.node_count() << " nodes, " << graph.get_edges().size() << " edges, "
+              << settings.roots << " marked roots, reachability index " << (index ? "on" : "off")
+              << ", built in " << (now() - start)*1000 << " ms" << std::endl;
+
+    start = now();
+    for(int i = 0; i < settings.roots; i++)
+      graph.mark_node(node_name(rand_r(&seed) % graph.node_count()));
+    report("mark node", now() - start, std::max(1, settings.roots));
+
+    // edges are removed and added again, so the graph keeps its size
+    std::vector<KIDGraph::KIDEdge> removed;
+    start = now();
+    for(int i = 0; i < settings.iterations; i++) {
+      removed.push_back(graph.get_edges()[rand_r(&seed) % graph.get_edges().size()]);
+      graph.remove_edge(removed.back());
+    }
+    report("remove edge", now() - start, settings.iterations);
+
+    start = now();
+    for(int i = 0; i < settings.iterations; i++)
+      graph.add_edge(removed[i]);
+    report("add edge", now() - start, settings.iterations);
+
+    start = now();
+    for(int i = 0; i < settings.iterations; i++)
+      graph.unmark_node(node_name(rand_r(&seed) % graph.node_count()));
+    report("unmark node", now() - start, settings.iterations);
+
+    bool equal = check_marks(graph);
+    ok = ok && equal;
+    if(!equal)
+      std::cout << "marks: MISMATCH" << std::endl;
+  }
+
+  if(settings.megabytes > 0) {
+    // names like the ones of the framework, an edge line and its share of the nodes take about 63 bytes
+    unsigned int seed = 1;
+    KIDGraph graph;
+    build_graph(graph, settings.megabytes*1000000/63, seed, "collection_node_%07d");
+    for(int i = 0; i < settings.roots; i++)
+      graph.mark_node(graph.get_node(rand_r(&seed) % graph.node_count()).node);
+    std::cout << "graph: " << graph.node_count() << " nodes, " << graph.get_edges().size() << " edges" << std::endl;
+
+    const char *files[] = { "kidbench.kgf", "kidbench.kgb" };
+    if(!graph.save(files[0], true) || !graph.save_binary(files[1])) {
+      std::cout << "could not write the files" << std::endl;
+      ok = false;
+    }
+    else {
+      for(int i = 0; i < 2; i++) {
+        bool equal = check_load(files[i], graph);
+        ok = ok && equal;
+        if(!equal)
+          std::cout << "load: MISMATCH" << std::endl;
+      }
+      ok = check_corrupt(files[1]) && ok;
+    }
+    remove(files[0]);
+    remove(files[1]);
+  }
+
+  return ok ? 0 : 1;
+}
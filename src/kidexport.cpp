@@ -0,0 +1,288 @@
+#include "kidgraph.h"
+#include "graph_layouter.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+
+using namespace SceneReconstruction;
+
+namespace {
+  /** name of the cached layout of a graph
+   *  @param dir directory of the cache
+   *  @param dot the graph
+   *  @return the file name
+   */
+  std::string cache_name(const std::string &dir, const std::string &dot)
+  {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", GraphLayouter::hash(dot));
+    return dir+"/"+hex+".dot";
+  }
+
+  /** reads a whole file
+   *  @param filename name of the file
+   *  @param content receives the content
+   *  @return true if the file could be read
+   */
+  bool read_file(const std::string &filename, std::string &content)
+  {
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if(!in)
+      return false;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    content = buffer.str();
+    return true;
+  }
+
+  /** writes a whole file, other processes never see a partial file
+   *  @param filename name of the file
+   *  @param content the content
+   *  @return true if the file was written
+   */
+  bool write_file(const std::string &filename, const std::string &content)
+  {
+    std::string tmp = filename+"."+boost::lexical_cast<std::string>(getpid())+"."+boost::lexical_cast<std::string>(boost::this_thread::get_id())+".tmp";
+    std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary);
+    out.write(content.data(), content.size());
+    out.close();
+    if(!out || rename(tmp.c_str(), filename.c_str()) != 0) {
+      unlink(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  /** name of the output file of an input file
+   *  @param input name of the input file
+   *  @param dir output directory, empty to write next to the input
+   *  @param format extension of the output
+   *  @return the output file name
+   */
+  std::string output_name(const std::string &input, const std::string &dir, const std::string &format)
+  {
+    std::string base = input;
+    size_t slash = base.rfind('/');
+    if(!dir.empty() && slash != std::string::npos)
+      base = base.substr(slash+1);
+    size_t dot = base.rfind('.');
+    if(dot != std::string::npos && (slash == std::string::npos || dot > slash || !dir.empty()))
+      base = base.substr(0, dot);
+    return (dir.empty() ? "" : dir+"/")+base+"."+format;
+  }
+
+  /** settings of the export */
+  struct Settings {
+    /** output format */
+    std::string  format;
+    /** output directory */
+    std::string  output_dir;
+    /** directory of the layout cache, empty to disable it */
+    std::string  cache_dir;
+  };
+
+  /** exports the files on its own Graphviz context */
+  struct Exporter {
+    /** the input files */
+    const std::vector<std::string>  *files;
+    /** the output files, by input file */
+    const std::vector<std::string>  *outputs;
+    /** the settings */
+    const Settings                  *settings;
+    /** index of the next file to export */
+    size_t                          *next;
+    /** guards next and the output */
+    boost::mutex                    *mutex;
+    /** number of failed files */
+    size_t                          *failed;
+
+    /** exports files until all are taken */
+    void operator()() {
+      GVC_t *gvc;
+      {
+        boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+        gvc = gvContext();
+        gvplugin_cairo_setup(gvc);
+      }
+
+      while(true) {
+        size_t i;
+        {
+          boost::mutex::scoped_lock lock(*mutex);
+          if(*next >= files->size())
+            break;
+          i = (*next)++;
+        }
+
+        std::string message;
+        bool ok = export_file(gvc, (*files)[i], (*outputs)[i], message);
+        boost::mutex::scoped_lock lock(*mutex);
+        if(ok) {
+          std::cout << message << std::endl;
+        }
+        else {
+          std::cerr << message << std::endl;
+          (*failed)++;
+        }
+      }
+
+      boost::mutex::scoped_lock gvlock(gvplugin_cairo_mutex());
+      gvFreeContext(gvc);
+    }
+
+    /** loads, lays out and writes one file
+     *  @param gvc Graphviz context of this thread
+     *  @param input name of the input file
+     *  @param output name of the output file
+     *  @param message receives the result for the log
+     *  @return true if the file was exported
+     */
+    bool export_file(GVC_t *gvc, const std::string &input, const std::string &output, std::string &message) {
+      timeval start, end;
+      gettimeofday(&start, NULL);
+
+      KIDGraph graph;
+      std::string error;
+      if(!graph.load_file(input, &error)) {
+        message = input+": "+error;
+        return false;
+      }
+      // skipped edges and marks are reported with the result
+      std::string warnings = (error.empty() ? "" : input+": "+error);
+      error.clear();
+      const std::string &dot = graph.get_dot();
+
+      // a cached layout is only drawn again, the graph is not laid out
+      GraphRenderingPtr rendering;
+      std::string cache;
+      bool cached = false;
+      if(!settings->cache_dir.empty()) {
+        cache = cache_name(settings->cache_dir, dot);
+        std::string laid_out;
+        if(read_file(cache, laid_out)) {
+          rendering = GraphLayouter::render(gvc, laid_out, "nop2");
+          cached = rendering->recording ? true : false;
+        }
+      }
+      if(!cached) {
+        std::string laid_out;
+        rendering = GraphLayouter::render(gvc, dot, "dot", cache.empty() ? NULL : &laid_out);
+        // the export still succeeds, the failed cache is reported with the result
+        if(!cache.empty() && !laid_out.empty() && !write_file(cache, laid_out))
+          warnings += (warnings.empty() ? "" : "\n")+cache+": could not write the cached layout";
+      }
+      if(!rendering->recording) {
+        message = input+": could not lay out the graph";
+        return false;
+      }
+
+      bool written = false;
+      try {
+        written = GraphLayouter::write(*rendering, output, settings->format);
+      } catch(std::exception &e) {
+        error = e.what();
+      }
+      if(!written) {
+        message = output+": could not write file"+(error.empty() ? "" : " ("+error+")");
+        return false;
+      }
+
+      gettimeofday(&end, NULL);
+      double ms = (end.tv_sec - start.tv_sec)*1000.0 + (end.tv_usec - start.tv_usec)/1000.0;
+      std::ostringstream out;
+      out << input << " -> " << output << ": " << graph.node_count() << " nodes, "
+          << (cached ? "cached layout" : "laid out") << ", " << ms << " ms";
+      if(!warnings.empty())
+        out << "\n" << warnings;
+      message = out.str();
+      return true;
+    }
+  };
+}
+
+/** exports KID graphs to SVG, PDF or PNG without a display
+ *  the files are exported in parallel, each thread with its own Graphviz
+ *  context, and drawn by the cairo plugin like in the GUI. Layouts are
+ *  serialized through gvplugin_cairo_mutex(), so the threads only overlap
+ *  in loading the graphs and writing the files.
+ */
+int main(int argc, char **argv) {
+  Settings settings;
+  settings.format = "svg";
+  // hardware_concurrency returns 0 if the number of cores is unknown
+  size_t threads = std::max(1u, boost::thread::hardware_concurrency());
+  std::vector<std::string> files;
+
+  bool usage = false;
+  for(int i = 1; i < argc && !usage; i++) {
+    std::string arg = argv[i];
+    if(arg == "-f" && i+1 < argc)
+      settings.format = argv[++i];
+    else if(arg == "-o" && i+1 < argc)
+      settings.output_dir = argv[++i];
+    else if(arg == "-c" && i+1 < argc)
+      settings.cache_dir = argv[++i];
+    else if(arg == "-j" && i+1 < argc)
+      threads = atoi(argv[++i]);
+    else if(!arg.empty() && arg[0] == '-')
+      usage = true;
+    else
+      files.push_back(arg);
+  }
+  if(usage || files.empty() || threads < 1 ||
+     (settings.format != "svg" && settings.format != "pdf" && settings.format != "png")) {
+    std::cerr << "usage: " << argv[0] << " [-f svg|pdf|png] [-o output dir] [-c cache dir] [-j threads] <graph.kgf|graph.kgb>..." << std::endl;
+    std::cerr << "  layouts are serialized by gvplugin_cairo_mutex(), -j threads only overlap loading and writing" << std::endl;
+    return 1;
+  }
+  threads = std::min(threads, files.size());
+
+  // inputs with the same name in different directories or formats would
+  // overwrite each other's output
+  std::vector<std::string> outputs;
+  std::map<std::string, size_t> inputs;
+  bool collision = false;
+  for(size_t i = 0; i < files.size(); i++) {
+    outputs.push_back(output_name(files[i], settings.output_dir, settings.format));
+    std::map<std::string, size_t>::iterator iter = inputs.find(outputs[i]);
+    if(iter != inputs.end()) {
+      std::cerr << files[i] << ": " << outputs[i] << " is also the output of " << files[iter->second] << std::endl;
+      collision = true;
+    }
+    else {
+      inputs[outputs[i]] = i;
+    }
+  }
+  if(collision)
+    return 1;
+
+  size_t next = 0, failed = 0;
+  boost::mutex mutex;
+  boost::thread_group group;
+  for(size_t i = 0; i < threads; i++) {
+    Exporter e;
+    e.files = &files;
+    e.outputs = &outputs;
+    e.settings = &settings;
+    e.next = &next;
+    e.mutex = &mutex;
+    e.failed = &failed;
+    group.create_thread(e);
+  }
+  group.join_all();
+
+  if(failed)
+    std::cerr << failed << " of " << files.size() << " graphs failed" << std::endl;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+
+#include "kidgraph.h"
+
+namespace SceneReconstruction {
+/** @class KIDFocus "kidfocus.h"
+ *  Focus view of a big KID Graph. Only the neighbourhood of the focused
+ *  nodes and the marked nodes are shown, the remaining nodes of each
+ *  level are collapsed into a summary node (see KIDGraph::get_dot with
+ *  a visibility). Expanding a summary shows the next few hidden nodes
+ *  of its level, those next to the shown nodes first. The shown nodes
+ *  are kept by name, so the focus survives edits of the graph.
+ *  @author Bastian Klingen
+ */
+  class KIDFocus {
+    public:
+      /** default size of the neighbourhood and the expansion */
+      enum Defaults {
+        /** number of edges between a shown node and a focused node */
+        HOPS = 2,
+        /** number of nodes shown by one expansion */
+        EXPAND_BATCH = 25
+      };
+
+      /** Constructor */
+      KIDFocus() : active(false) {}
+
+      /** checks if the focus view is used
+       *  @return true if only a part of the graph is shown
+       */
+      bool is_active() const {
+        return active;
+      }
+
+      /** leaves the focus view, the whole graph is shown again */
+      void clear() {
+        active = false;
+        shown.clear();
+      }
+
+      /** focuses on nodes and their neighbourhood
+       *  @param graph the graph
+       *  @param centers names of the focused nodes, unknown names are ignored
+       *  @param hops number of edges to follow from the focused nodes in both directions
+       */
+      void focus(const KIDGraph &graph, const std::vector<std::string> &centers, int hops = HOPS) {
+        active = true;
+        shown.clear();
+
+        std::vector<int> depth(graph.node_count(), -1);
+        std::vector<int> queue;
+        std::vector<std::string>::const_iterator name;
+        for(name = centers.begin(); name != centers.end(); name++) {
+          int id = graph.node_id(*name);
+          if(id >= 0 && depth[id] < 0) {
+            depth[id] = 0;
+            queue.push_back(id);
+          }
+        }
+        for(size_t i = 0; i < queue.size(); i++) {
+          int id = queue[i];
+          const KIDGraph::KIDNode &node = graph.get_node(id);
+          shown.insert(node.node);
+          if(depth[id] == hops)
+            continue;
+          visit(node.parents, depth[id]+1, depth, queue);
+          visit(node.children, depth[id]+1, depth, queue);
+        }
+      }
+
+      /** shows a node, e.g. one added while the focus view is used
+       *  @param node name of the node
+       */
+      void show(const std::string &node) {
+        if(active)
+          shown.insert(node);
+      }
+
+      /** shows more hidden nodes of a level
+       *  @param graph the graph
+       *  @param level level of the expanded summary
+       *  @param batch maximum number of nodes to show
+       *  @return number of nodes shown
+       */
+      int expand(const KIDGraph &graph, KIDGraph::Level level, int batch = EXPAND_BATCH) {
+        std::vector<bool> visible;
+        get_visible(graph, visible);
+
+        // hidden nodes next to the shown ones first, then in level order
+        const std::vector<int> &ids = graph.level_nodes(level);
+        std::vector<int> next;
+        for(int pass = 0; pass < 2 && (int)next.size() < batch; pass++) {
+          for(size_t i = 0; i < ids.size() && (int)next.size() < batch; i++) {
+            if(visible[ids[i]])
+              continue;
+            if(pass == 0 && !has_visible_neighbour(graph.get_node(ids[i]), visible))
+              continue;
+            visible[ids[i]] = true;
+            next.push_back(ids[i]);
+          }
+        }
+
+        for(size_t i = 0; i < next.size(); i++)
+          shown.insert(graph.get_node(next[i]).node);
+        return next.size();
+      }
+
+      /** gets the shown nodes
+       *  @param graph the graph
+       *  @param visible receives the visibility of the nodes by id, the
+       *         shown nodes and all marked nodes are visible
+       */
+      void get_visible(const KIDGraph &graph, std::vector<bool> &visible) const {
+        visible.assign(graph.node_count(), false);
+        std::set<std::string>::const_iterator name;
+        for(name = shown.begin(); name != shown.end(); name++) {
+          int id = graph.node_id(*name);
+          if(id >= 0)
+            visible[id] = true;
+        }
+        for(int id = 0; id < graph.node_count(); id++)
+          if(graph.is_marked(id))
+            visible[id] = true;
+      }
+
+    private:
+      /** queues the unvisited neighbours of a node
+       *  @param next ids of the neighbours
+       *  @param d depth of the neighbours
+       *  @param depth depth of the visited nodes, -1 for unvisited ones
+       *  @param queue the queue
+       */
+      static void visit(const std::vector<int> &next, int d, std::vector<int> &depth, std::vector<int> &queue) {
+        std::vector<int>::const_iterator iter;
+        for(iter = next.begin(); iter != next.end(); iter++) {
+          if(depth[*iter] < 0) {
+            depth[*iter] = d;
+            queue.push_back(*iter);
+          }
+        }
+      }
+
+      /** checks if a node has a visible parent or child
+       *  @param node the node
+       *  @param visible visibility of the nodes by id
+       *  @return true if a neighbour is visible
+       */
+      static bool has_visible_neighbour(const KIDGraph::KIDNode &node, const std::vector<bool> &visible) {
+        std::vector<int>::const_iterator iter;
+        for(iter = node.parents.begin(); iter != node.parents.end(); iter++)
+          if(visible[*iter])
+            return true;
+        for(iter = node.children.begin(); iter != node.children.end(); iter++)
+          if(visible[*iter])
+            return true;
+        return false;
+      }
+
+    private:
+      /** true if only a part of the graph is shown */
+      bool                   active;
+      /** names of the shown nodes besides the marked ones */
+      std::set<std::string>  shown;
+  };
+}
@@ -1,14 +1,46 @@
 #pragma once
-#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
+
+#include "reachability.h"
+#include "kgbfile.h"
 
 namespace SceneReconstruction {
 /** @class KIDGraph "kidgraph.h"
  *  Simple structure to contruct and store the KID Graph that
  *  allows marking and unmarking of nodes.
+ *  Nodes are stored in a dense array and addressed by integer ids,
+ *  names are resolved through a hash index. Ids are only stable as
+ *  long as no node is removed.
  *  @author Bastian Klingen
  */
   class KIDGraph {
     public:
+      /** levels of the KID Graph */
+      enum Level {
+        /** knowledge level */
+        KNOWLEDGE   = 0,
+        /** information level */
+        INFORMATION = 1,
+        /** data level */
+        DATA        = 2,
+        /** number of levels */
+        LEVELS      = 3
+      };
+
       /** simple structure for the edges of the KID Graph
        */
       struct KIDEdge {
@@ -18,6 +50,14 @@ namespace SceneReconstruction {
         std::string to;
         /** label of the edge */
         std::string label;
+        /** id of the node from which the edge comes, set by the graph */
+        int from_id;
+        /** id of the node to which the edge points, set by the graph */
+        int to_id;
+
+        /** Constructor */
+        KIDEdge() : from_id(-1), to_id(-1) {}
+
         /** equality operator
          *  @param rhs an edge to compare with
          *  @return true if edges are equal
@@ -56,7 +96,7 @@ namespace SceneReconstruction {
          *  @param marked true to mark the edge (bold, red)
          *  @return string representation of this edge
          */
-        std::string dot_edge(bool marked) {
+        std::string dot_edge(bool marked) const {
           std::string style = "";
           if(!label.empty() || marked) {
             style += " [dir=back";
@@ -77,10 +117,19 @@ namespace SceneReconstruction {
       struct KIDNode {
         /** name of the node */
         std::string node;
-        /** list of pointers to parent nodes */
-        std::list<KIDNode*> parents;
-        /** list of pointers to child nodes */
-        std::list<KIDNode*> children;
+        /** level of the node */
+        Level level;
+        /** ids of the parent nodes, one entry per edge */
+        std::vector<int> parents;
+        /** ids of the child nodes, one entry per edge */
+        std::vector<int> children;
+        /** true if the node has a layout position */
+        bool positioned;
+        /** layout position of the node */
+        double x, y;
+
+        /** Constructor */
+        KIDNode() : level(KNOWLEDGE), positioned(false), x(0), y(0) {}
 
         /** equality operator
          *  only checks for names since the graph does not allow two
@@ -106,406 +155,1984 @@ namespace SceneReconstruction {
       };
 
     private:
-      /** marks the parents of an node
-       *  @param node pointer to a node
+      /** FNV-1a hash for the node names, cheaper than boost::hash on long names */
+      struct NameHash {
+        /** hashes a string */
+        size_t operator()(const std::string &str) const {
+          return hash(str.data(), str.size());
+        }
+
+        /** hashes a string inside a buffer
+         *  @param str first character of the string
+         *  @param length length of the string
+         *  @return the hash
+         */
+        static boost::uint64_t hash(const char *str, size_t length) {
+          boost::uint64_t h = 14695981039346656037ULL;
+          for(size_t i = 0; i < length; i++) {
+            h ^= (unsigned char)str[i];
+            h *= 1099511628211ULL;
+          }
+          return h;
+        }
+      };
+
+      /** open addressing index of the node ids by name
+       *  it keeps its own copy of the names next to each other, so a lookup
+       *  only touches its slot and the name instead of the node, and it is
+       *  searched with names inside a buffer, so the parsers need no
+       *  temporary strings. Names of erased nodes are dropped when they
+       *  take half of the copy.
        */
-      void mark_parents(KIDGraph::KIDNode* node) {
-        std::list<KIDGraph::KIDNode*>::iterator iter;
-        for(iter = node->parents.begin(); iter != node->parents.end(); iter++) {
-          if(!is_marked((*iter)->node)) {
-            marked_nodes.push_back((*iter)->node);
-            mark_parents(*iter);
+      class NameIndex {
+        public:
+          /** Constructor */
+          NameIndex() : used(0), erased(0) {}
+
+          /** removes all names */
+          void clear() {
+            slots.clear();
+            names.clear();
+            used = 0;
+            erased = 0;
+          }
+
+          /** makes room for a number of nodes
+           *  @param n number of nodes
+           */
+          void reserve(size_t n) {
+            if(2*n > slots.size())
+              resize(2*n);
+          }
+
+          /** hashes a name for find and insert
+           *  @param name first character of the name
+           *  @param length length of the name
+           *  @return the hash
+           */
+          static boost::uint32_t hash(const char *name, size_t length) {
+            boost::uint64_t h = NameHash::hash(name, length);
+            return h ^ (h >> 32);
+          }
+
+          /** loads the slot of a name into the cache, so a following find
+           *  does not wait for the memory
+           *  @param h hash of the name
+           */
+          void prefetch(boost::uint32_t h) const {
+#ifdef __GNUC__
+            if(!slots.empty())
+              __builtin_prefetch(&slots[h & (slots.size()-1)]);
+#endif
+          }
+
+          /** finds a node
+           *  @param name first character of the name
+           *  @param length length of the name
+           *  @param h hash of the name
+           *  @return id of the node or -1
+           */
+          int find(const char *name, size_t length, boost::uint32_t h) const {
+            size_t i = slot_of(name, length, h);
+            return i == slots.size() ? -1 : slots[i].id;
+          }
+
+          /** adds a node that is not yet indexed
+           *  @param name first character of the name
+           *  @param length length of the name
+           *  @param h hash of the name
+           *  @param id id of the node
+           */
+          void insert(const char *name, size_t length, boost::uint32_t h, int id) {
+            if(2*(used+1) > slots.size())
+              resize(std::max((size_t)64, 2*slots.size()));
+
+            Slot slot;
+            slot.hash   = h;
+            slot.id     = id;
+            slot.offset = names.size();
+            slot.length = length;
+            names.append(name, length);
+            place(slot);
+            used++;
+          }
+
+          /** changes the id of a node
+           *  @param name name of the node
+           *  @param id new id of the node
+           */
+          void move(const std::string &name, int id) {
+            slots[slot_of(name.data(), name.size(), hash(name.data(), name.size()))].id = id;
+          }
+
+          /** removes a node, the following slots of its probe sequence are
+           *  shifted back, so no tombstones are left
+           *  @param name name of the node
+           */
+          void erase(const std::string &name) {
+            size_t mask = slots.size()-1;
+            size_t i = slot_of(name.data(), name.size(), hash(name.data(), name.size()));
+            for(size_t j = (i+1) & mask; slots[j].id >= 0; j = (j+1) & mask) {
+              // a slot may only move back if its home is not between the hole and itself
+              size_t home = slots[j].hash & mask;
+              if(((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i] = slots[j];
+                i = j;
+              }
+            }
+            slots[i].id = -1;
+            used--;
+            erased += name.size();
+            if(2*erased > names.size())
+              resize(slots.size());
+          }
+
+        private:
+          /** an entry of the table, id is -1 for empty slots */
+          struct Slot {
+            boost::uint32_t hash;
+            int             id;
+            /** position of the name in names */
+            boost::uint32_t offset;
+            boost::uint32_t length;
+          };
+
+          /** finds the slot of a name
+           *  @param name first character of the name
+           *  @param length length of the name
+           *  @param h hash of the name
+           *  @return index of the slot or the size of the table
+           */
+          size_t slot_of(const char *name, size_t length, boost::uint32_t h) const {
+            if(slots.empty())
+              return 0;
+
+            size_t mask = slots.size()-1;
+            for(size_t i = h & mask; slots[i].id >= 0; i = (i+1) & mask) {
+              const Slot &slot = slots[i];
+              if(slot.hash == h && slot.length == length && memcmp(names.data()+slot.offset, name, length) == 0)
+                return i;
+            }
+            return slots.size();
+          }
+
+          void place(const Slot &slot) {
+            size_t mask = slots.size()-1;
+            size_t i = slot.hash & mask;
+            while(slots[i].id >= 0)
+              i = (i+1) & mask;
+            slots[i] = slot;
+          }
+
+          /** rebuilds the table, the names of erased nodes are dropped */
+          void resize(size_t n) {
+            size_t size = 64;
+            while(size < n)
+              size *= 2;
+
+            Slot empty;
+            empty.id = -1;
+            std::vector<Slot> old(size, empty);
+            old.swap(slots);
+            std::string copy;
+            copy.reserve(names.size() - erased);
+            for(size_t i = 0; i < old.size(); i++) {
+              if(old[i].id >= 0) {
+                Slot slot = old[i];
+                slot.offset = copy.size();
+                copy.append(names, old[i].offset, old[i].length);
+                place(slot);
+              }
+            }
+            names.swap(copy);
+            erased = 0;
+          }
+
+          std::vector<Slot> slots;
+          /** the names of the slots */
+          std::string       names;
+          size_t            used;
+          /** number of characters of erased names in names */
+          size_t            erased;
+      };
+
+      /** open addressing index of the edges by node ids and label
+       *  it stores positions in the edge array, swapped or erased edges are
+       *  updated in place, shifted edges need a rebuild
+       */
+      class EdgeIndex {
+        public:
+          /** Constructor */
+          EdgeIndex() : used(0) {}
+
+          /** removes all edges */
+          void clear() {
+            slots.clear();
+            used = 0;
+          }
+
+          /** makes room for a number of edges
+           *  @param n number of edges
+           */
+          void reserve(size_t n) {
+            if(2*n > slots.size())
+              resize(2*n);
+          }
+
+          /** finds an edge
+           *  @param edges the edge array
+           *  @param from id of the node from which the edge comes
+           *  @param to id of the node to which the edge points
+           *  @param label label of the edge
+           *  @return position of the edge in the array or -1
+           */
+          int find(const std::vector<KIDEdge> &edges, int from, int to, const std::string &label) const {
+            if(slots.empty())
+              return -1;
+
+            boost::uint32_t lh = NameHash()(label);
+            size_t mask = slots.size()-1;
+            for(size_t i = hash(from, to, lh) & mask; slots[i].edge >= 0; i = (i+1) & mask) {
+              const Slot &slot = slots[i];
+              if(slot.from == from && slot.to == to && slot.label == lh && edges[slot.edge].label == label)
+                return slot.edge;
+            }
+            return -1;
+          }
+
+          /** loads the first slot of an edge into the cache, so a following
+           *  find does not wait for the memory
+           *  @param from id of the node from which the edge comes
+           *  @param to id of the node to which the edge points
+           *  @param label hash of the label
+           */
+          void prefetch(int from, int to, boost::uint32_t label) const {
+#ifdef __GNUC__
+            if(!slots.empty())
+              __builtin_prefetch(&slots[hash(from, to, label) & (slots.size()-1)]);
+#endif
+          }
+
+          /** adds an edge that is not yet indexed
+           *  @param edges the edge array
+           *  @param edge position of the edge in the array
+           */
+          void insert(const std::vector<KIDEdge> &edges, int edge) {
+            if(2*(used+1) > slots.size())
+              resize(std::max((size_t)64, 2*slots.size()));
+
+            Slot slot;
+            slot.from  = edges[edge].from_id;
+            slot.to    = edges[edge].to_id;
+            slot.label = NameHash()(edges[edge].label);
+            slot.edge  = edge;
+            place(slot);
+            used++;
+          }
+
+          /** indexes all edges of the array again
+           *  @param edges the edge array
+           */
+          void rebuild(const std::vector<KIDEdge> &edges) {
+            clear();
+            reserve(edges.size());
+            for(size_t i = 0; i < edges.size(); i++)
+              insert(edges, i);
+          }
+
+          /** updates the index before two edges swap their positions
+           *  @param edges the edge array, not yet swapped
+           *  @param a position of the first edge
+           *  @param b position of the second edge
+           */
+          void swap(const std::vector<KIDEdge> &edges, int a, int b) {
+            size_t sa = slot_of(edges, a);
+            size_t sb = slot_of(edges, b);
+            slots[sa].edge = b;
+            slots[sb].edge = a;
+          }
+
+          /** removes an edge before it is erased from the end of the array
+           *  the following slots of its probe sequence are shifted back,
+           *  so no tombstones are left
+           *  @param edges the edge array
+           *  @param edge position of the edge
+           */
+          void erase(const std::vector<KIDEdge> &edges, int edge) {
+            size_t mask = slots.size()-1;
+            size_t i = slot_of(edges, edge);
+            for(size_t j = (i+1) & mask; slots[j].edge >= 0; j = (j+1) & mask) {
+              // a slot may only move back if its home is not between the hole and itself
+              size_t home = hash(slots[j].from, slots[j].to, slots[j].label) & mask;
+              if(((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i] = slots[j];
+                i = j;
+              }
+            }
+            slots[i].edge = -1;
+            used--;
+          }
+
+        private:
+          /** an entry of the table, edge is -1 for empty slots */
+          struct Slot {
+            int             from;
+            int             to;
+            boost::uint32_t label;
+            int             edge;
+          };
+
+          /** finds the slot of an indexed edge
+           *  @param edges the edge array
+           *  @param edge position of the edge
+           *  @return index of the slot
+           */
+          size_t slot_of(const std::vector<KIDEdge> &edges, int edge) const {
+            size_t mask = slots.size()-1;
+            size_t i = hash(edges[edge].from_id, edges[edge].to_id, NameHash()(edges[edge].label)) & mask;
+            while(slots[i].edge != edge)
+              i = (i+1) & mask;
+            return i;
+          }
+
+          static size_t hash(int from, int to, boost::uint32_t label) {
+            boost::uint64_t h = ((boost::uint64_t)(boost::uint32_t)from << 32) | (boost::uint32_t)to;
+            h = (h ^ label) * 0x9E3779B97F4A7C15ULL;
+            return h ^ (h >> 29);
+          }
+
+          void place(const Slot &slot) {
+            size_t mask = slots.size()-1;
+            size_t i = hash(slot.from, slot.to, slot.label) & mask;
+            while(slots[i].edge >= 0)
+              i = (i+1) & mask;
+            slots[i] = slot;
+          }
+
+          void resize(size_t n) {
+            size_t size = 64;
+            while(size < n)
+              size *= 2;
+
+            Slot empty;
+            empty.edge = -1;
+            std::vector<Slot> old(size, empty);
+            old.swap(slots);
+            for(size_t i = 0; i < old.size(); i++)
+              if(old[i].edge >= 0)
+                place(old[i]);
           }
+
+          std::vector<Slot> slots;
+          size_t            used;
+      };
+
+      /** adds a node named by a string inside a buffer
+       *  @param node first character of the name
+       *  @param length length of the name
+       *  @param h hash of the name for the node index
+       *  @param level level of the node
+       *  @param position position inside the level, -1 to append the node
+       *  @return id of the new node or -1 if a node with this name already exists
+       */
+      int insert_node(const char *node, size_t length, boost::uint32_t h, Level level, int position = -1) {
+        if(node_index.find(node, length, h) >= 0)
+          return -1;
+
+        int id = nodes.size();
+        nodes.push_back(KIDNode());
+        nodes.back().node.assign(node, length);
+        nodes.back().level = level;
+        node_index.insert(node, length, h, id);
+        if(position < 0 || position >= (int)level_ids[level].size())
+          level_ids[level].push_back(id);
+        else
+          level_ids[level].insert(level_ids[level].begin()+position, id);
+        reach.invalidate();
+        mark_count.push_back(0);
+        mark_root.push_back(false);
+        mark_pinned.push_back(false);
+        seen_down.push_back(0);
+        seen_up.push_back(0);
+        seen_closure.push_back(0);
+        node_dot.push_back(std::string());
+        node_dot_state.push_back(DOT_DIRTY);
+        dot_valid = false;
+
+        return id;
+      }
+
+      /** makes room for more nodes
+       *  @param n number of nodes to add
+       */
+      void reserve_nodes(size_t n) {
+        n += nodes.size();
+        nodes.reserve(n);
+        node_index.reserve(n);
+        mark_count.reserve(n);
+        mark_root.reserve(n);
+        mark_pinned.reserve(n);
+        seen_down.reserve(n);
+        seen_up.reserve(n);
+        seen_closure.reserve(n);
+        node_dot.reserve(n);
+        node_dot_state.reserve(n);
+      }
+
+      /** makes room for more edges
+       *  @param n number of edges to add
+       */
+      void reserve_edges(size_t n) {
+        n += edges.size();
+        edges.reserve(n);
+        edge_index.reserve(n);
+        edge_dot.reserve(n);
+        edge_dot_state.reserve(n);
+      }
+
+      /** adds an edge whose nodes are known
+       *  @param edge the edge, its strings are swapped into the graph
+       *  @param from id of the node from which the edge comes
+       *  @param to id of the node to which the edge points
+       *  @param link false to leave the adjacency to link_edges
+       *  @return true if the edge was added, false if it already exists
+       */
+      bool insert_edge(KIDEdge &edge, int from, int to, bool link = true) {
+        if(edge_index.find(edges, from, to, edge.label) >= 0)
+          return false;
+
+        edges.push_back(KIDEdge());
+        KIDEdge &e = edges.back();
+        e.from.swap(edge.from);
+        e.to.swap(edge.to);
+        e.label.swap(edge.label);
+        e.from_id = from;
+        e.to_id   = to;
+        edge_index.insert(edges, edges.size()-1);
+        edge_dot.push_back(std::string());
+        edge_dot_state.push_back(DOT_DIRTY);
+        dot_valid = false;
+        if(!link)
+          return true;
+
+        // only the closures containing the edge are counted again
+        std::vector<int> roots;
+        edge_roots(from, to, roots);
+        count_marks(roots, -1);
+        nodes[from].children.push_back(to);
+        nodes[to].parents.push_back(from);
+        reach.add_edge(nodes, from, to);
+        count_marks(roots, 1);
+
+        return true;
+      }
+
+      /** swaps the positions of two edges in the edge order
+       *  @param a position of the first edge
+       *  @param b position of the second edge
+       */
+      void swap_edges(int a, int b) {
+        if(a == b)
+          return;
+        edge_index.swap(edges, a, b);
+        std::swap(edges[a], edges[b]);
+        edge_dot[a].swap(edge_dot[b]);
+        std::swap(edge_dot_state[a], edge_dot_state[b]);
+        dot_valid = false;
+      }
+
+      /** builds the adjacency of all edges at once, each list is allocated only once
+       */
+      void link_edges() {
+        std::vector<int> children(nodes.size(), 0), parents(nodes.size(), 0);
+        std::vector<KIDEdge>::iterator eiter;
+        for(eiter = edges.begin(); eiter != edges.end(); eiter++) {
+          children[eiter->from_id]++;
+          parents[eiter->to_id]++;
+        }
+        for(size_t i = 0; i < nodes.size(); i++) {
+          nodes[i].children.clear();
+          nodes[i].children.reserve(children[i]);
+          nodes[i].parents.clear();
+          nodes[i].parents.reserve(parents[i]);
         }
+        for(eiter = edges.begin(); eiter != edges.end(); eiter++) {
+          nodes[eiter->from_id].children.push_back(eiter->to_id);
+          nodes[eiter->to_id].parents.push_back(eiter->from_id);
+        }
+        reach.invalidate();
       }
 
-      /** marks the children of an node
-       *  @param node pointer to a node
+      /** removes one occurrence of a value from an id list
+       *  @param ids list of ids
+       *  @param id value to remove
        */
-      void mark_children(KIDNode* node) {
-        std::list<KIDNode*>::iterator iter;
-        for(iter = node->children.begin(); iter != node->children.end(); iter++) {
-          if(!is_marked((*iter)->node)) {
-            marked_nodes.push_back((*iter)->node);
-            mark_children(*iter);
-          }
+      static void erase_one(std::vector<int> &ids, int id) {
+        std::vector<int>::iterator iter = std::find(ids.begin(), ids.end(), id);
+        if(iter != ids.end())
+          ids.erase(iter);
+      }
+
+      /** replaces all occurrences of a value in an id list
+       *  @param ids list of ids
+       *  @param from value to replace
+       *  @param to replacement
+       */
+      static void replace_all(std::vector<int> &ids, int from, int to) {
+        std::replace(ids.begin(), ids.end(), from, to);
+      }
+
+      /** starts a new traversal, the stamps are reset when they wrap around
+       */
+      void next_stamp() {
+        if(++stamp == 0) {
+          std::fill(seen_down.begin(), seen_down.end(), 0);
+          std::fill(seen_up.begin(), seen_up.end(), 0);
+          std::fill(seen_closure.begin(), seen_closure.end(), 0);
+          stamp = 1;
         }
       }
 
-      /** unmarks the children of an node (if not otherwise marked)
-       *  @param node pointer to a node
+      /** breadth first traversal collecting the nodes reachable in one direction
+       *  @param node id of the start node
+       *  @param down true to follow the children, false to follow the parents
+       *  @param closure receives the ids not collected yet in this traversal
        */
-      void unmark_children(KIDNode* node) {
-        std::list<KIDNode*>::iterator iter;
-        for(iter = node->children.begin(); iter != node->children.end(); iter++) {
-          if(is_marked((*iter)->node)) {
-            bool unmark = true;
-            for(std::list<KIDNode*>::iterator parent = (*iter)->parents.begin(); parent != (*iter)->parents.end(); parent++) {
-              if(is_marked((*parent)->node)) {
-                unmark = false;
-                break;
-              }
-            }
-            if(unmark) {
-              marked_nodes.remove((*iter)->node);
-              unmark_children(*iter);
+      void traverse(int node, bool down, std::vector<int> &closure) {
+        std::vector<unsigned> &seen = down ? seen_down : seen_up;
+        bfs_queue.clear();
+        bfs_queue.push_back(node);
+        seen[node] = stamp;
+        for(size_t i = 0; i < bfs_queue.size(); i++) {
+          int n = bfs_queue[i];
+          if(seen_closure[n] != stamp) {
+            seen_closure[n] = stamp;
+            closure.push_back(n);
+          }
+
+          const std::vector<int> &next = down ? nodes[n].children : nodes[n].parents;
+          std::vector<int>::const_iterator iter;
+          for(iter = next.begin(); iter != next.end(); iter++) {
+            if(seen[*iter] != stamp) {
+              seen[*iter] = stamp;
+              bfs_queue.push_back(*iter);
             }
           }
         }
       }
 
-      /** unmarks the parents of an node (if not otherwise marked)
-       *  @param node pointer to a node
+      /** collects the node, its ancestors and its descendants
+       *  the closure is symmetric: a is in the closure of b if and only
+       *  if b is in the closure of a
+       *  @param node id of a node
+       *  @param closure receives the ids, each id once
        */
-      void unmark_parents(KIDGraph::KIDNode* node) {
-        std::list<KIDGraph::KIDNode*>::iterator iter;
-        for(iter = node->parents.begin(); iter != node->parents.end(); iter++) {
-          if(is_marked((*iter)->node)) {
-            bool unmark = true;
-            for(std::list<KIDNode*>::iterator child = (*iter)->children.begin(); child != (*iter)->children.end(); child++) {
-              if(is_marked((*child)->node)) {
-                unmark = false;
-                break;
-              }
-            }
+      void closure(int node, std::vector<int> &closure) {
+        if(use_index) {
+          if(reach.outdated())
+            reach.build(nodes);
+          if(reach.closure(node, closure))
+            return;
+        }
+
+        closure.clear();
+        next_stamp();
 
-            if(unmark) {
-              marked_nodes.remove((*iter)->node);
-              unmark_parents(*iter);
+        //nodes pointing to the node
+        traverse(node, true, closure);
+
+        //nodes pointed from the node
+        traverse(node, false, closure);
+      }
+
+      /** adds or removes the marks of a marked root to the mark counts
+       *  @param node id of the root
+       *  @param delta +1 to add the marks, -1 to remove them
+       */
+      void count_marks(int node, int delta) {
+        std::vector<int> ids;
+        closure(node, ids);
+        std::vector<int>::iterator iter;
+        for(iter = ids.begin(); iter != ids.end(); iter++)
+          mark_count[*iter] += delta;
+        dot_valid = false;
+      }
+
+      /** collects the marked roots whose closure an edge from one node
+       *  to another is part of, only their marks change with the edge
+       *  @param from id of the node from which the edge comes
+       *  @param to id of the node to which the edge points
+       *  @param roots receives the ids of the roots
+       */
+      void edge_roots(int from, int to, std::vector<int> &roots) {
+        roots.clear();
+        if(root_count == 0)
+          return;
+
+        // the roots above the edge gain or lose the nodes below it and vice versa
+        std::vector<int> ids;
+        next_stamp();
+        traverse(from, false, ids);
+        traverse(to, true, ids);
+        std::vector<int>::iterator iter;
+        for(iter = ids.begin(); iter != ids.end(); iter++)
+          if(mark_root[*iter])
+            roots.push_back(*iter);
+      }
+
+      /** adds or removes the marks of some roots
+       *  @param roots ids of the roots
+       *  @param delta +1 to add the marks, -1 to remove them
+       */
+      void count_marks(const std::vector<int> &roots, int delta) {
+        std::vector<int>::const_iterator iter;
+        for(iter = roots.begin(); iter != roots.end(); iter++)
+          count_marks(*iter, delta);
+      }
+
+      /** appends the header of the dot document
+       *  @param out the document
+       */
+      static void append_dot_header(std::string &out) {
+        // standard "header" of the graph
+        out.append("digraph G {\n"\
+                   "  ranksep=1;\n"\
+                   "  edge[style=invis];\n"\
+                   "  node[shape=box,fontsize=20,fixedsize=true,width=2];\n"\
+                   "  \"Knowledge\" -> \"Information\" -> \"Data\";\n"\
+                   "  edge[style=solid,dir=back];\n"\
+                   "  node[shape=ellipse,fontsize=14,fixedsize=false,width=0.75];\n");
+      }
+
+      /** appends the start of the subgraph of a level to the dot document
+       *  @param out the document
+       *  @param level the level
+       */
+      static void append_dot_level(std::string &out, int level) {
+        static const char *subgraphs[LEVELS][2] = {
+          { "knowledge",   "Knowledge"   },
+          { "information", "Information" },
+          { "data",        "Data"        }
+        };
+        out.append("  subgraph ").append(subgraphs[level][0]).append(" {\n"\
+                   "    rank = same;\n"\
+                   "    \"").append(subgraphs[level][1]).append("\";\n");
+      }
+
+      /** state of a cached dot fragment, the fragment depends on the marking */
+      enum DotState { DOT_DIRTY = -1, DOT_UNMARKED = 0, DOT_MARKED = 1 };
+
+      /** creates the dot fragment of a node if it is missing or its marking changed
+       *  @param id id of the node
+       */
+      void update_node_dot(int id) {
+        signed char state = is_marked(id) ? DOT_MARKED : DOT_UNMARKED;
+        if(node_dot_state[id] == state)
+          return;
+
+        std::string &dot = node_dot[id];
+        dot.clear();
+        dot.reserve(nodes[id].node.size() + 36);
+        dot.append("    \"").append(nodes[id].node).append("\"");
+        if(state == DOT_MARKED)
+          dot.append(" [style=bold,color=red2]");
+        dot.append(";\n");
+        node_dot_state[id] = state;
+      }
+
+      /** creates the dot fragment of an edge if it is missing or its marking changed
+       *  @param pos position of the edge
+       */
+      void update_edge_dot(int pos) {
+        const KIDEdge &edge = edges[pos];
+        signed char state = (is_marked(edge.from_id) && is_marked(edge.to_id)) ? DOT_MARKED : DOT_UNMARKED;
+        if(edge_dot_state[pos] == state)
+          return;
+
+        std::string &dot = edge_dot[pos];
+        dot.clear();
+        dot.append("    \"").append(edge.to).append("\" -> \"").append(edge.from).append("\"");
+        dot.append(edge.dot_edge(state == DOT_MARKED)).append(";\n");
+        edge_dot_state[pos] = state;
+      }
+
+      /** buffered writer for the kgf format, appends to a string
+       *  and flushes it to a file if one is given
+       */
+      struct KGFWriter {
+        /** buffered output */
+        std::string buffer;
+        /** file to flush to, NULL to keep everything in the buffer */
+        FILE       *file;
+        /** false if writing to the file failed */
+        bool        ok;
+
+        /** Constructor
+         *  @param f file to flush to or NULL
+         */
+        KGFWriter(FILE *f) : file(f), ok(true) {
+          if(file)
+            buffer.reserve(1 << 16);
+        }
+
+        /** appends a string */
+        void put(const std::string &str) {
+          buffer.append(str);
+          if(file && buffer.size() >= (1 << 16))
+            flush();
+        }
+
+        /** appends a character */
+        void put(char c) {
+          buffer.push_back(c);
+        }
+
+        /** writes the buffer to the file */
+        void flush() {
+          if(file && !buffer.empty()) {
+            if(fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+              ok = false;
+            buffer.clear();
+          }
+        }
+      };
+
+      /** writes the graph in the kgf format
+       *  @param out writer to write to
+       *  @param marks true to write the marked nodes as well
+       */
+      void write(KGFWriter &out, bool marks) {
+        out.put(name);
+        out.put('\n');
+        for(int l = 0; l < LEVELS; l++) {
+          std::vector<int>::iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++) {
+            out.put(nodes[*iter].node);
+            out.put(';');
+          }
+          out.put('\n');
+        }
+
+        std::vector<KIDEdge>::iterator eiter;
+        for(eiter = edges.begin(); eiter != edges.end(); eiter++) {
+          out.put(eiter->from);
+          out.put(';');
+          out.put(eiter->to);
+          out.put(';');
+          out.put(eiter->label);
+          out.put(";\n");
+        }
+
+        if(!marks)
+          return;
+
+        // the marked nodes are followed by the roots of the marking,
+        // older versions treat the roots section as unknown marked nodes
+        std::vector<int> marked, roots;
+        for(int l = 0; l < LEVELS; l++) {
+          std::vector<int>::iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++) {
+            if(is_marked(*iter))
+              marked.push_back(*iter);
+            if(mark_root[*iter])
+              roots.push_back(*iter);
+          }
+        }
+
+        if(marked.size() > 0) {
+          std::vector<int>::iterator miter;
+          out.put("###marked nodes###\n");
+          for(miter = marked.begin(); miter != marked.end(); miter++) {
+            out.put(nodes[*miter].node);
+            out.put('\n');
+          }
+          if(roots.size() > 0) {
+            out.put("###marked roots###\n");
+            for(miter = roots.begin(); miter != roots.end(); miter++) {
+              out.put(nodes[*miter].node);
+              out.put('\n');
             }
           }
         }
       }
 
-      
+      /** sets the error message of a failed load and clears the graph
+       *  @param error receives the message, may be NULL
+       *  @param line number of the malformed line
+       *  @param message description of the problem
+       *  @return false
+       */
+      bool parse_error(std::string *error, int line, const std::string &message) {
+        if(error) {
+          std::ostringstream msg;
+          msg << "line " << line << ": " << message;
+          *error = msg.str();
+        }
+        clear();
+        return false;
+      }
+
+      /** adds a warning about a skipped line of a load that continues
+       *  @param error receives the message, may be NULL
+       *  @param line number of the skipped line
+       *  @param message description of the problem
+       */
+      void parse_warning(std::string *error, int line, const std::string &message) {
+        if(error) {
+          std::ostringstream msg;
+          if(!error->empty())
+            msg << "\n";
+          msg << "line " << line << ": " << message;
+          *error += msg.str();
+        }
+      }
+
+      /** a node name inside a kgf buffer */
+      struct BufferName {
+        const char      *name;
+        size_t           length;
+        /** hash of the name for the node index */
+        boost::uint32_t  hash;
+
+        /** Constructor
+         *  @param begin first character of the name
+         *  @param end character after the name
+         */
+        BufferName(const char *begin = NULL, const char *end = NULL) : name(begin), length(end-begin), hash(NameIndex::hash(begin, end-begin)) {}
+      };
+
+      /** an edge line of a kgf buffer whose nodes are not looked up yet */
+      struct EdgeLine {
+        BufferName       from, to;
+        const char      *label;
+        size_t           label_length;
+        int              line;
+        /** ids of the nodes, set when they are looked up */
+        int              from_id, to_id;
+      };
+
+      /** number of names or edge lines that are looked up together */
+      enum { LOAD_BATCH = 64 };
+
+      /** adds the edges of a batch of lines
+       *  the names of a line were prefetched when it was read, so the
+       *  lookups of the batch wait for the memory at the same time
+       *  instead of one after another
+       *  @param batch the lines, cleared afterwards
+       *  @param error receives the warnings about skipped edges
+       */
+      void insert_edges(std::vector<EdgeLine> &batch, std::string *error) {
+        std::vector<EdgeLine>::iterator iter;
+        for(iter = batch.begin(); iter != batch.end(); iter++) {
+          iter->from_id = node_index.find(iter->from.name, iter->from.length, iter->from.hash);
+          iter->to_id = node_index.find(iter->to.name, iter->to.length, iter->to.hash);
+          if(iter->from_id >= 0 && iter->to_id >= 0)
+            edge_index.prefetch(iter->from_id, iter->to_id, NameHash::hash(iter->label, iter->label_length));
+        }
+
+        KIDEdge edge;
+        for(iter = batch.begin(); iter != batch.end(); iter++) {
+          // edges of removed nodes are skipped like older versions did
+          if(iter->from_id < 0) {
+            parse_warning(error, iter->line, "skipped edge from unknown node \""+std::string(iter->from.name, iter->from.length)+"\"");
+          }
+          else if(iter->to_id < 0) {
+            parse_warning(error, iter->line, "skipped edge to unknown node \""+std::string(iter->to.name, iter->to.length)+"\"");
+          }
+          else {
+            edge.from.assign(iter->from.name, iter->from.length);
+            edge.to.assign(iter->to.name, iter->to.length);
+            edge.label.assign(iter->label, iter->label_length);
+            // duplicate edges are dropped
+            insert_edge(edge, iter->from_id, iter->to_id, false);
+          }
+        }
+        batch.clear();
+      }
+
     public:
-      /** save the graph to a dgf file 
-       *  @param filename name of the file to save to
+      /** Constructor */
+      KIDGraph() : root_count(0), stamp(0), use_index(false), dot_valid(false) {}
+
+      /** enables the reachability index for marking
+       *  the index is built on the first marking after a change of the nodes
+       *  and updated on edge changes, big or cyclic graphs are traversed instead
+       *  @param enable true to use the index
        */
-      void save(std::string filename) {
-        std::ofstream out;
-        out.open(filename.c_str(), std::ios::out | std::ios::trunc);
-        out << name << "\n";
-        std::list<KIDNode>::iterator iter;
-        for(iter = knowledge_nodes.begin(); iter != knowledge_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-        for(iter = information_nodes.begin(); iter != information_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-        for(iter = data_nodes.begin(); iter != data_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-
-        std::list<KIDEdge>::iterator eiter;
-        for(eiter = edges.begin(); eiter != edges.end(); eiter++) {
-          out << eiter->from << ";" << eiter->to << ";" << eiter->label << ";\n";
+      void set_reachability_index(bool enable) {
+        use_index = enable;
+        reach.invalidate();
+      }
+
+      /** get the lower case name of a level
+       *  @param level the level
+       *  @return name of the level {knowledge,information,data}
+       */
+      static std::string level_name(Level level) {
+        switch(level) {
+          case KNOWLEDGE:   return "knowledge";
+          case INFORMATION: return "information";
+          case DATA:        return "data";
+          default:          return "";
         }
+      }
 
-        out.close();
+      /** removes all nodes, edges and marks
+       */
+      void clear() {
+        name = "";
+        nodes.clear();
+        node_index.clear();
+        for(int l = 0; l < LEVELS; l++)
+          level_ids[l].clear();
+        edges.clear();
+        edge_index.clear();
+        reach.invalidate();
+        mark_count.clear();
+        mark_root.clear();
+        mark_pinned.clear();
+        seen_down.clear();
+        seen_up.clear();
+        seen_closure.clear();
+        root_count = 0;
+        node_dot.clear();
+        node_dot_state.clear();
+        edge_dot.clear();
+        edge_dot_state.clear();
+        dot_valid = false;
       }
-        
-      /** save the graph to string 
+
+      /** adds a node to the graph
+       *  @param node name of the node
+       *  @param level level of the node
+       *  @param position position inside the level, -1 to append the node
+       *  @return id of the new node or -1 if a node with this name already exists
+       */
+      int add_node(std::string node, Level level, int position = -1) {
+        return insert_node(node.data(), node.size(), NameIndex::hash(node.data(), node.size()), level, position);
+      }
+
+      /** removes a node and all edges connected to it from the graph
+       *  the id of the last node changes to the id of the removed node
+       *  @param node name of the node
+       *  @return true if the node existed
+       */
+      bool remove_node(std::string node) {
+        int id = node_id(node);
+        if(id < 0)
+          return false;
+
+        // remove the marks of the node while its edges still exist
+        if(mark_root[id]) {
+          mark_root[id] = false;
+          root_count--;
+          count_marks(id, -1);
+        }
+
+        // only the roots whose closure contains the node lose marks, they are counted again afterwards
+        std::vector<int> roots;
+        if(root_count > 0) {
+          std::vector<int> ids;
+          closure(id, ids);
+          std::vector<int>::iterator riter;
+          for(riter = ids.begin(); riter != ids.end(); riter++)
+            if(mark_root[*riter])
+              roots.push_back(*riter);
+          count_marks(roots, -1);
+        }
+
+        // detach the node from its neighbours
+        std::vector<int>::iterator iter;
+        for(iter = nodes[id].children.begin(); iter != nodes[id].children.end(); iter++)
+          if(*iter != id)
+            erase_one(nodes[*iter].parents, id);
+        for(iter = nodes[id].parents.begin(); iter != nodes[id].parents.end(); iter++)
+          if(*iter != id)
+            erase_one(nodes[*iter].children, id);
+
+        // move the last node into the free slot
+        int last = nodes.size()-1;
+        node_index.erase(nodes[id].node);
+        if(id != last) {
+          node_index.move(nodes[last].node, id);
+          nodes[id] = nodes[last];
+          mark_count[id]  = mark_count[last];
+          mark_root[id]   = mark_root[last];
+          mark_pinned[id] = mark_pinned[last];
+          node_dot[id].swap(node_dot[last]);
+          node_dot_state[id] = node_dot_state[last];
+          replace_all(nodes[id].children, last, id);
+          replace_all(nodes[id].parents, last, id);
+          for(iter = nodes[id].children.begin(); iter != nodes[id].children.end(); iter++)
+            replace_all(nodes[*iter].parents, last, id);
+          for(iter = nodes[id].parents.begin(); iter != nodes[id].parents.end(); iter++)
+            replace_all(nodes[*iter].children, last, id);
+        }
+        nodes.pop_back();
+        reach.invalidate();
+        mark_count.pop_back();
+        mark_root.pop_back();
+        mark_pinned.pop_back();
+        seen_down.pop_back();
+        seen_up.pop_back();
+        seen_closure.pop_back();
+        node_dot.pop_back();
+        node_dot_state.pop_back();
+        dot_valid = false;
+
+        // keep the order of the levels and edges
+        for(int l = 0; l < LEVELS; l++) {
+          std::vector<int>::iterator pos = std::find(level_ids[l].begin(), level_ids[l].end(), id);
+          if(pos != level_ids[l].end())
+            level_ids[l].erase(pos);
+          replace_all(level_ids[l], last, id);
+        }
+
+        // the dot fragments of the remaining edges stay valid
+        size_t kept = 0;
+        for(size_t i = 0; i < edges.size(); i++) {
+          if(edges[i].from_id == id || edges[i].to_id == id)
+            continue;
+          if(edges[i].from_id == last)
+            edges[i].from_id = id;
+          if(edges[i].to_id == last)
+            edges[i].to_id = id;
+          if(kept != i) {
+            std::swap(edges[kept], edges[i]);
+            edge_dot[kept].swap(edge_dot[i]);
+            edge_dot_state[kept] = edge_dot_state[i];
+          }
+          kept++;
+        }
+        edges.resize(kept);
+        edge_dot.resize(kept);
+        edge_dot_state.resize(kept);
+        edge_index.rebuild(edges);
+
+        std::replace(roots.begin(), roots.end(), last, id);
+        count_marks(roots, 1);
+
+        return true;
+      }
+
+      /** adds an edge to the graph
+       *  @param edge the edge, only from, to and label are used
+       *  @param position position in the edge order, -1 to append the edge
+       *  @return true if the edge was added, false if it already exists or a node is unknown
+       */
+      bool add_edge(KIDEdge edge, int position = -1) {
+        int from = node_id(edge.from);
+        int to   = node_id(edge.to);
+        if(from < 0 || to < 0)
+          return false;
+
+        if(!insert_edge(edge, from, to))
+          return false;
+
+        if(position >= 0 && position < (int)edges.size()-1) {
+          std::rotate(edges.begin()+position, edges.end()-1, edges.end());
+          std::rotate(edge_dot.begin()+position, edge_dot.end()-1, edge_dot.end());
+          std::rotate(edge_dot_state.begin()+position, edge_dot_state.end()-1, edge_dot_state.end());
+          edge_index.rebuild(edges);
+        }
+
+        return true;
+      }
+
+      /** adds an edge at the position remove_edge took it from
+       *  the edge at the position moves back to the end, so the edge order
+       *  before the removal is restored in constant time
+       *  @param edge the edge, only from, to and label are used
+       *  @param position position the edge was removed from
+       *  @return true if the edge was added, false if it already exists or a node is unknown
+       */
+      bool restore_edge(KIDEdge edge, int position) {
+        int from = node_id(edge.from);
+        int to   = node_id(edge.to);
+        if(from < 0 || to < 0 || !insert_edge(edge, from, to))
+          return false;
+
+        if(position >= 0 && position < (int)edges.size()-1)
+          swap_edges(position, edges.size()-1);
+        return true;
+      }
+
+      /** removes an edge from the graph
+       *  the last edge takes the position of the removed one, see restore_edge
+       *  @param edge the edge, only from, to and label are used
+       *  @return true if the edge existed
+       */
+      bool remove_edge(const KIDEdge &edge) {
+        int from = node_id(edge.from);
+        int to   = node_id(edge.to);
+        int pos = (from < 0 || to < 0) ? -1 : edge_index.find(edges, from, to, edge.label);
+        if(pos < 0)
+          return false;
+
+        // only the closures containing the edge are counted again
+        std::vector<int> roots;
+        edge_roots(from, to, roots);
+        count_marks(roots, -1);
+        erase_one(nodes[from].children, to);
+        erase_one(nodes[to].parents, from);
+        int last = edges.size()-1;
+        swap_edges(pos, last);
+        edge_index.erase(edges, last);
+        edges.pop_back();
+        edge_dot.pop_back();
+        edge_dot_state.pop_back();
+        dot_valid = false;
+        reach.remove_edge(nodes, from, to);
+        count_marks(roots, 1);
+
+        return true;
+      }
+
+      /** save the graph to a kgf file
+       *  @param filename name of the file to save to
+       *  @param marks true to save the marked nodes as well
+       *  @return true if the file was written
+       */
+      bool save(std::string filename, bool marks = false) {
+        FILE *f = fopen(filename.c_str(), "wb");
+        if(!f)
+          return false;
+
+        KGFWriter out(f);
+        write(out, marks);
+        out.flush();
+
+        return (fclose(f) == 0) && out.ok;
+      }
+
+      /** save the graph to string
        */
       std::string save_to_string() {
-        std::stringstream out;
-        std::list<KIDNode>::iterator iter;
-        std::list<std::string>::iterator miter;
-        out << name << "\n";
-        for(iter = knowledge_nodes.begin(); iter != knowledge_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-        for(iter = information_nodes.begin(); iter != information_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-        for(iter = data_nodes.begin(); iter != data_nodes.end(); iter++)
-          out << iter->node << ";";
-        out << "\n";
-
-        std::list<KIDEdge>::iterator eiter;
-        for(eiter = edges.begin(); eiter != edges.end(); eiter++) {
-          out << eiter->from << ";" << eiter->to << ";" << eiter->label << ";\n";
+        KGFWriter out(NULL);
+        write(out, true);
+
+        return out.buffer;
+      }
+
+      /** save the graph to a binary kgb file including marks and positions
+       *  @param filename name of the file to save to
+       *  @return true if the file was written
+       */
+      bool save_binary(std::string filename) {
+        // the file stores the nodes level by level
+        std::vector<boost::uint32_t> file_id(nodes.size());
+        std::vector<int> order;
+        order.reserve(nodes.size());
+        std::vector<boost::uint32_t> levels(2*LEVELS);
+        for(int l = 0; l < LEVELS; l++) {
+          levels[l] = order.size();
+          levels[LEVELS+l] = level_ids[l].size();
+          std::vector<int>::iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++) {
+            file_id[*iter] = order.size();
+            order.push_back(*iter);
+          }
         }
 
-        if(marked_nodes.size() > 0) {
-          out << "###marked nodes###\n";
-          for(miter = marked_nodes.begin(); miter != marked_nodes.end(); miter++) {
-            out << (*miter) << "\n";
+        // string 0 is the name of the graph, followed by the node names and the labels
+        std::vector<std::string> strings;
+        strings.reserve(order.size()+2);
+        strings.push_back(name);
+        std::vector<boost::uint32_t> names(order.size());
+        for(size_t i = 0; i < order.size(); i++) {
+          names[i] = strings.size();
+          strings.push_back(nodes[order[i]].node);
+        }
+
+        boost::unordered_map<std::string, boost::uint32_t, NameHash> labels;
+        std::vector<KGBFile::Edge> file_edges(edges.size());
+        for(size_t i = 0; i < edges.size(); i++) {
+          file_edges[i].from = file_id[edges[i].from_id];
+          file_edges[i].to   = file_id[edges[i].to_id];
+          boost::unordered_map<std::string, boost::uint32_t, NameHash>::iterator label = labels.find(edges[i].label);
+          if(label == labels.end()) {
+            label = labels.insert(std::make_pair(edges[i].label, (boost::uint32_t)strings.size())).first;
+            strings.push_back(edges[i].label);
           }
+          file_edges[i].label = label->second;
+        }
+
+        std::vector<boost::uint32_t> marked, roots;
+        bool positioned = false;
+        std::vector<double> positions(2*order.size());
+        for(size_t i = 0; i < order.size(); i++) {
+          const KIDNode &n = nodes[order[i]];
+          if(is_marked(order[i]))
+            marked.push_back(i);
+          if(mark_root[order[i]])
+            roots.push_back(i);
+          positioned = positioned || n.positioned;
+          positions[2*i]   = n.positioned ? n.x : std::numeric_limits<double>::quiet_NaN();
+          positions[2*i+1] = n.positioned ? n.y : std::numeric_limits<double>::quiet_NaN();
         }
 
-        return out.str();
+        KGBWriter out;
+        out.add(KGBFile::STRINGS, strings.size(), KGBWriter::string_table(strings));
+        out.add(KGBFile::GRAPH, 1, KGBWriter::array(std::vector<boost::uint32_t>(1, 0)));
+        out.add(KGBFile::NODES, names.size(), KGBWriter::array(names));
+        out.add(KGBFile::LEVELS, LEVELS, KGBWriter::array(levels));
+        out.add(KGBFile::EDGES, file_edges.size(), KGBWriter::array(file_edges));
+        if(!marked.empty())
+          out.add(KGBFile::MARKED, marked.size(), KGBWriter::array(marked));
+        if(!roots.empty())
+          out.add(KGBFile::ROOTS, roots.size(), KGBWriter::array(roots));
+        if(positioned)
+          out.add(KGBFile::POSITIONS, order.size(), KGBWriter::array(positions));
+
+        return out.write(filename);
       }
-        
-      /** load the graph from a string 
-       *  @param graph representing the graph
+
+      /** load the graph from a mapped binary kgb file
+       *  @param file the checked file
+       *  @param error receives a description of the problem if loading fails
+       *  @return true if the graph was loaded, the graph is empty otherwise
        */
-      void load(std::string graph) {
-        knowledge_nodes.clear();
-        information_nodes.clear();
-        data_nodes.clear();
-        edges.clear();
-        marked_nodes.clear();
-
-        size_t pos = graph.find("\n");
-        name = graph.substr(0, pos);
-        graph = graph.substr(pos+1);
-
-        pos = graph.find("\n");
-        std::string knowledge = graph.substr(0, pos);
-        graph = graph.substr(pos+1);
-        while((pos = knowledge.find(";")) != std::string::npos) {
-          KIDNode n;
-          n.node = knowledge.substr(0, pos);
-          knowledge_nodes.push_back(n);
-          knowledge = knowledge.substr(pos+1);
-        }
-
-        pos = graph.find("\n");
-        std::string information = graph.substr(0, pos);
-        graph = graph.substr(pos+1);
-        while((pos = information.find(";")) != std::string::npos) {
-          KIDNode n;
-          n.node = information.substr(0, pos);
-          information_nodes.push_back(n);
-          information = information.substr(pos+1);
-        }
-
-        pos = graph.find("\n");
-        std::string data = graph.substr(0, pos);
-        graph = graph.substr(pos+1);
-        while((pos = data.find(";")) != std::string::npos) {
-          KIDNode n;
-          n.node = data.substr(0, pos);
-          data_nodes.push_back(n);
-          data = data.substr(pos+1);
-        }
-
-        pos = graph.find("###marked nodes###\n");
-        std::string edges;
-        if(pos != std::string::npos) {
-          edges = graph.substr(0, pos);
-          graph = graph.substr(pos+19);
+      bool load_binary(const KGBFile &file, std::string *error = NULL) {
+        clear();
+        name.assign(file.string(file.name()), file.string_length(file.name()));
+
+        // the nodes are stored level by level, so the ids of the file are the ids of the graph
+        boost::uint32_t count = file.node_count();
+        reserve_nodes(count);
+        for(int l = 0; l < LEVELS; l++)
+          level_ids[l].reserve(file.level_size(l));
+        std::vector<BufferName> names;
+        names.reserve(LOAD_BATCH);
+        int level = 0;
+        for(boost::uint32_t first = 0; first < count; first += LOAD_BATCH) {
+          // the names of a batch are prefetched before they are inserted
+          boost::uint32_t last = std::min(count, first + LOAD_BATCH);
+          names.clear();
+          for(boost::uint32_t i = first; i < last; i++) {
+            const char *node = file.string(file.node_name(i));
+            names.push_back(BufferName(node, node + file.string_length(file.node_name(i))));
+            node_index.prefetch(names.back().hash);
+          }
+          for(boost::uint32_t i = first; i < last; i++) {
+            while(i >= file.level_first(level) + file.level_size(level))
+              level++;
+            const BufferName &node = names[i-first];
+            if(insert_node(node.name, node.length, node.hash, (Level)level) < 0) {
+              if(error)
+                *error = "node \""+std::string(node.name, node.length)+"\" exists twice";
+              clear();
+              return false;
+            }
+            // NaN marks nodes without position
+            if(file.has_positions() && file.position(i)[0] == file.position(i)[0])
+              set_position(i, file.position(i)[0], file.position(i)[1]);
+          }
+        }
+
+        boost::uint32_t edge_count = file.edge_count();
+        reserve_edges(edge_count);
+        KIDEdge edge;
+        for(boost::uint32_t first = 0; first < edge_count; first += LOAD_BATCH) {
+          boost::uint32_t last = std::min(edge_count, first + LOAD_BATCH);
+          for(boost::uint32_t i = first; i < last; i++) {
+            const KGBFile::Edge &e = file.edge(i);
+            edge_index.prefetch(e.from, e.to, NameHash::hash(file.string(e.label), file.string_length(e.label)));
+          }
+          // the names are copied from the string table, which is denser than the nodes
+          for(boost::uint32_t i = first; i < last; i++) {
+            const KGBFile::Edge &e = file.edge(i);
+            edge.from.assign(file.string(file.node_name(e.from)), file.string_length(file.node_name(e.from)));
+            edge.to.assign(file.string(file.node_name(e.to)), file.string_length(file.node_name(e.to)));
+            edge.label.assign(file.string(e.label), file.string_length(e.label));
+            insert_edge(edge, e.from, e.to, false);
+          }
+        }
+        link_edges();
+
+        for(boost::uint32_t i = 0; i < file.mark_count(KGBFile::ROOTS); i++)
+          mark_node(nodes[file.mark(KGBFile::ROOTS, i)].node);
+        for(boost::uint32_t i = 0; i < file.mark_count(KGBFile::MARKED); i++) {
+          int id = file.mark(KGBFile::MARKED, i);
+          if(mark_count[id] == 0)
+            mark_pinned[id] = true;
+        }
+
+        return true;
+      }
+
+      /** load the graph from a kgf or kgb file
+       *  the file is mapped into memory and parsed in place, the format
+       *  is detected from the content
+       *  @param filename name of the file to load
+       *  @param error receives a description of the problem if loading fails,
+       *         or of the skipped edges and marks of unknown nodes if it succeeds
+       *  @return true if the graph was loaded
+       */
+      bool load_file(std::string filename, std::string *error = NULL) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0) {
+          if(error)
+            *error = "could not open "+filename;
+          clear();
+          return false;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0) {
+          close(fd);
+          return parse_error(error, 1, "empty file");
+        }
+
+        // the whole file is parsed, so all pages are read in at once
+#ifdef MAP_POPULATE
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+#else
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+#endif
+        close(fd);
+        if(data == MAP_FAILED) {
+          if(error)
+            *error = "could not map "+filename;
+          clear();
+          return false;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        bool ok;
+        if(KGBFile::is_binary(static_cast<const char*>(data), st.st_size)) {
+          KGBFile file;
+          ok = file.attach(static_cast<const char*>(data), st.st_size, error) && load_binary(file, error);
+          if(!ok)
+            clear();
         }
         else {
-          edges = graph;
-          graph = "";
-        }
-
-        while((pos = edges.find("\n")) != std::string::npos) {
-          std::string edge = edges.substr(0, pos-1);
-          size_t epos;
-          KIDEdge e;
-          epos = edge.find(";");
-          e.from = edge.substr(0,epos);
-          edge = edge.substr(epos+1);
-          epos = edge.find(";");
-          e.to = edge.substr(0,epos);
-          edge = edge.substr(epos+1);
-          epos = edge.find(";");
-          e.label = edge.substr(0,epos);
-          if(is_node(e.from) && is_node(e.to)) {
-            this->edges.push_back(e);
-            KIDNode *from = get_node(e.from);
-            KIDNode *to   = get_node(e.to);
-            from->children.push_back(to);
-            to->parents.push_back(from);
-          }
-          edges = edges.substr(pos+1);
-        }
-
-        while((pos = graph.find("\n")) != std::string::npos) {
-          std::string mark = graph.substr(0, pos);
-          if(is_node(mark))
-            marked_nodes.push_back(mark);
-          graph = graph.substr(pos+1);
-        }
-      }
-        
+          ok = load(static_cast<const char*>(data), st.st_size, error);
+        }
+        munmap(data, st.st_size);
+
+        return ok;
+      }
+
+      /** load the graph from a string
+       *  @param graph representing the graph
+       *  @param error receives a description of the problem if loading fails,
+       *         or of the skipped edges and marks of unknown nodes if it succeeds
+       *  @return true if the graph was loaded
+       */
+      bool load(const std::string &graph, std::string *error = NULL) {
+        return load(graph.data(), graph.size(), error);
+      }
+
+      /** load the graph from a kgf buffer in a single pass
+       *  the format is line based: the name of the graph, the knowledge,
+       *  information and data nodes each terminated by ";", the edges as
+       *  "from;to;label;" and optionally the marked nodes and roots
+       *  @param data the buffer
+       *  @param length length of the buffer
+       *  @param error receives a description of the problem if loading fails,
+       *         or of the skipped edges and marks of unknown nodes if it succeeds
+       *  @return true if the graph was loaded, the graph is empty otherwise
+       */
+      bool load(const char *data, size_t length, std::string *error = NULL) {
+        enum Section { NAME, LEVEL, EDGES, MARKS, ROOTS } section = NAME;
+        int level = 0;
+        int line = 0;
+        std::vector<int> marked;
+        std::vector<BufferName> names;
+        names.reserve(LOAD_BATCH);
+        std::vector<EdgeLine> batch;
+        batch.reserve(LOAD_BATCH);
+        const char *pos = data;
+        const char *end = data+length;
+
+        clear();
+        if(error)
+          error->clear();
+
+        while(pos < end) {
+          const char *eol = static_cast<const char*>(memchr(pos, '\n', end-pos));
+          if(!eol)
+            eol = end;
+          const char *next = eol+1;
+          if(eol > pos && eol[-1] == '\r')
+            eol--;
+          line++;
+
+          switch(section) {
+            case NAME:
+              name.assign(pos, eol);
+              section = LEVEL;
+              break;
+
+            case LEVEL:
+              {
+                size_t count = std::count(pos, eol, ';') + 1;
+                reserve_nodes(count);
+                level_ids[level].reserve(count);
+              }
+              while(pos < eol) {
+                // the names of a batch are prefetched before they are inserted
+                names.clear();
+                while(pos < eol && names.size() < LOAD_BATCH) {
+                  const char *sep = static_cast<const char*>(memchr(pos, ';', eol-pos));
+                  if(!sep)
+                    sep = eol;
+                  if(sep == pos)
+                    return parse_error(error, line, "empty node name");
+                  names.push_back(BufferName(pos, sep));
+                  node_index.prefetch(names.back().hash);
+                  pos = sep+1;
+                }
+                std::vector<BufferName>::iterator iter;
+                for(iter = names.begin(); iter != names.end(); iter++) {
+                  if(insert_node(iter->name, iter->length, iter->hash, (Level)level) < 0) {
+                    std::string node(iter->name, iter->length);
+                    return parse_error(error, line, "node \""+node+"\" already exists at level "+level_of_node(node));
+                  }
+                }
+              }
+              if(++level == LEVELS) {
+                section = EDGES;
+                // every remaining line is at most one edge
+                size_t lines = 0;
+                for(const char *c = next; c < end; c++) {
+                  c = static_cast<const char*>(memchr(c, '\n', end-c));
+                  if(!c)
+                    c = end;
+                  lines++;
+                }
+                reserve_edges(lines);
+              }
+              break;
+
+            case EDGES:
+              if(eol - pos == 18 && memcmp(pos, "###marked nodes###", 18) == 0) {
+                insert_edges(batch, error);
+                link_edges();
+                section = MARKS;
+              }
+              else if(eol > pos) {
+                const char *field[3];
+                const char *end[3];
+                int fields = 0;
+                const char *start = pos;
+                for(const char *c = pos; c < eol && fields < 3; c++) {
+                  if(*c == ';') {
+                    field[fields] = start;
+                    end[fields++] = c;
+                    start = c+1;
+                  }
+                }
+                if(fields == 0)
+                  return parse_error(error, line, "edge is not of the form from;to;label;");
+                // the last field may miss its ";", a missing label is empty
+                for(; fields < 3; fields++) {
+                  field[fields] = start;
+                  end[fields] = eol;
+                  start = eol;
+                }
+
+                EdgeLine edge;
+                edge.from = BufferName(field[0], end[0]);
+                edge.to = BufferName(field[1], end[1]);
+                edge.label = field[2];
+                edge.label_length = end[2]-field[2];
+                edge.line = line;
+                node_index.prefetch(edge.from.hash);
+                node_index.prefetch(edge.to.hash);
+                batch.push_back(edge);
+                if(batch.size() == LOAD_BATCH)
+                  insert_edges(batch, error);
+              }
+              break;
+
+            case MARKS:
+            case ROOTS:
+              if(eol - pos == 18 && memcmp(pos, "###marked roots###", 18) == 0) {
+                section = ROOTS;
+              }
+              else if(eol > pos) {
+                int id = node_id(pos, eol-pos);
+                // older versions kept the marks of removed nodes, they are skipped
+                if(id < 0)
+                  parse_warning(error, line, "skipped mark of unknown node \""+std::string(pos, eol)+"\"");
+                else if(section == ROOTS)
+                  mark_node(nodes[id].node);
+                else
+                  marked.push_back(id);
+              }
+              break;
+          }
+
+          pos = next;
+        }
+
+        // a new graph only consists of its name, missing levels are empty
+        if(section == NAME)
+          return parse_error(error, 1, "empty file");
+
+        if(section == EDGES) {
+          insert_edges(batch, error);
+          link_edges();
+        }
+
+        // marks without a known root only mark themselves
+        std::vector<int>::iterator iter;
+        for(iter = marked.begin(); iter != marked.end(); iter++)
+          if(mark_count[*iter] == 0)
+            mark_pinned[*iter] = true;
+
+        return true;
+      }
+
       /** checks if a node exists
        *  @param node name of the node to search for
        *  @return true if node exists, false otherwise
        */
-      bool is_node(std::string node) {
-        std::list<KIDGraph::KIDNode>::iterator iter;
-        for(iter = knowledge_nodes.begin(); iter != knowledge_nodes.end(); iter++)
-          if(*iter == node)
-            return true;
-        for(iter = information_nodes.begin(); iter != information_nodes.end(); iter++)
-          if(*iter == node)
-            return true;
-        for(iter = data_nodes.begin(); iter != data_nodes.end(); iter++)
-          if(*iter == node)
-            return true;
-
-        return false;
+      bool is_node(const std::string &node) const {
+        return node_id(node) >= 0;
       }
 
       /** checks if an edge exists
        *  @param edge edge to search for
        *  @return true if edge exists, false otherwise
        */
-      bool is_edge(KIDEdge edge) {
-        return (find(edges.begin(), edges.end(), edge) != edges.end());
+      bool is_edge(const KIDEdge &edge) const {
+        int from = node_id(edge.from);
+        int to   = node_id(edge.to);
+        return from >= 0 && to >= 0 && edge_index.find(edges, from, to, edge.label) >= 0;
       }
 
       /** gets the level of a node
        *  @param node node to get the level of
        *  @return level of the node {knowledge,information,data}
        */
-      std::string level_of_node(std::string node) {
-        if (find(knowledge_nodes.begin(), knowledge_nodes.end(), node) != knowledge_nodes.end())
-          return "knowledge";
-        else if (find(information_nodes.begin(), information_nodes.end(), node) != information_nodes.end())
-          return "information";
-        else if (find(data_nodes.begin(), data_nodes.end(), node) != data_nodes.end())
-          return "data";
-        else
+      std::string level_of_node(const std::string &node) const {
+        int id = node_id(node);
+        if(id < 0)
           return "";
+        else
+          return level_name(nodes[id].level);
       }
 
-      /** returns a pointer to a node specified by its name
+      /** gets the id of a node specified by its name
        *  @param node name of the node
-       *  @return pointer to the node or 0 if node does not exist
+       *  @return id of the node or -1 if node does not exist
        */
-      KIDNode* get_node(std::string node) {
-        KIDNode* n = 0;
-        std::list<KIDNode>::iterator iter;
-        iter = find(knowledge_nodes.begin(), knowledge_nodes.end(), node);
-        if(iter != knowledge_nodes.end()) {
-          n=&(*iter);
-          return n;
-        }
-        iter = find(information_nodes.begin(), information_nodes.end(), node);
-        if(iter != information_nodes.end()) {
-          n=&(*iter);
-          return n;
-        }
-        iter = find(data_nodes.begin(), data_nodes.end(), node);
-        if(iter != data_nodes.end()) {
-          n=&(*iter);
-          return n;
-        }
+      int node_id(const std::string &node) const {
+        return node_id(node.data(), node.size());
+      }
+
+      /** gets the id of a node specified by a name inside a buffer
+       *  @param node first character of the name
+       *  @param length length of the name
+       *  @return id of the node or -1 if node does not exist
+       */
+      int node_id(const char *node, size_t length) const {
+        return node_index.find(node, length, NameIndex::hash(node, length));
+      }
+
+      /** returns a node specified by its id
+       *  @param id id of the node
+       *  @return the node
+       */
+      const KIDNode& get_node(int id) const {
+        return nodes[id];
+      }
+
+      /** sets the layout position of a node
+       *  @param id id of the node
+       *  @param x horizontal position
+       *  @param y vertical position
+       */
+      void set_position(int id, double x, double y) {
+        nodes[id].positioned = true;
+        nodes[id].x = x;
+        nodes[id].y = y;
+      }
+
+      /** removes the layout positions of all nodes
+       */
+      void clear_positions() {
+        for(size_t i = 0; i < nodes.size(); i++)
+          nodes[i].positioned = false;
+      }
 
-        return n;
+      /** get the number of nodes
+       *  @return number of nodes
+       */
+      int node_count() const {
+        return nodes.size();
+      }
+
+      /** get the ids of the nodes of one level in insertion order
+       *  @param level the level
+       *  @return ids of the nodes
+       */
+      const std::vector<int>& level_nodes(Level level) const {
+        return level_ids[level];
+      }
+
+      /** get all edges in insertion order
+       *  @return the edges
+       */
+      const std::vector<KIDEdge>& get_edges() const {
+        return edges;
+      }
+
+      /** get the position of a node inside its level
+       *  @param id id of the node
+       *  @return position in level_nodes
+       */
+      int level_position(int id) const {
+        const std::vector<int> &ids = level_ids[nodes[id].level];
+        return std::find(ids.begin(), ids.end(), id) - ids.begin();
+      }
+
+      /** get the position of an edge in the edge order
+       *  @param edge the edge, only from, to and label are used
+       *  @return position in get_edges or -1 if the edge does not exist
+       */
+      int edge_position(const KIDEdge &edge) const {
+        int from = node_id(edge.from);
+        int to   = node_id(edge.to);
+        return (from < 0 || to < 0) ? -1 : edge_index.find(edges, from, to, edge.label);
       }
 
       /** checks if a node is marked
        *  @param node name of the node to search for
        *  @return true if node is marked, false otherwise
        */
-      bool is_marked(std::string node) {
-        return (find(marked_nodes.begin(), marked_nodes.end(), node) != marked_nodes.end());
+      bool is_marked(const std::string &node) const {
+        int id = node_id(node);
+        return id >= 0 && is_marked(id);
+      }
+
+      /** checks if a node is marked
+       *  @param id id of the node
+       *  @return true if node is marked, false otherwise
+       */
+      bool is_marked(int id) const {
+        return mark_count[id] > 0 || mark_pinned[id];
+      }
+
+      /** checks if a node was marked by mark_node
+       *  @param id id of the node
+       *  @return true if the node is a root of the marking
+       */
+      bool is_root(int id) const {
+        return mark_root[id];
+      }
+
+      /** checks if a node carries a loaded mark without a known root
+       *  @param id id of the node
+       *  @return true if the node only marks itself
+       */
+      bool is_pinned(int id) const {
+        return mark_pinned[id];
+      }
+
+      /** adds or removes the root mark of a single node
+       *  unlike unmark_node other roots in the closure keep their marks
+       *  @param id id of the node
+       *  @param root true to mark the node as root, false to remove the mark
+       */
+      void set_root(int id, bool root) {
+        if(mark_root[id] == root)
+          return;
+
+        mark_root[id] = root;
+        root_count += root ? 1 : -1;
+        count_marks(id, root ? 1 : -1);
+      }
+
+      /** marks a node without a root so that only the node itself is marked
+       *  @param id id of the node
+       *  @param pinned true to mark the node, false to remove the mark
+       */
+      void set_pinned(int id, bool pinned) {
+        mark_pinned[id] = pinned;
+        dot_valid = false;
+      }
+
+      /** collects the nodes highlighted together with a node
+       *  @param id id of the node
+       *  @param ids receives the node, its ancestors and its descendants
+       */
+      void get_closure(int id, std::vector<int> &ids) {
+        closure(id, ids);
       }
 
       /** creates the dot representation of the graph
+       *  the fragments of the nodes and edges are cached and only created
+       *  again if the element is new or its marking changed, the document
+       *  is only assembled again if the graph changed since the last call
        *  @return string containing this graph in dot
        */
-      std::string get_dot() {
-        std::list<KIDGraph::KIDNode>::iterator iter;
-        std::list<KIDGraph::KIDEdge>::iterator edgeiter;
-        // standard "header" of the graph
-        std::string dot = "digraph G {\n"\
-                          "  ranksep=1;\n"\
-                          "  edge[style=invis];\n"\
-                          "  node[shape=box,fontsize=20,fixedsize=true,width=2];\n"\
-                          "  \"Knowledge\" -> \"Information\" -> \"Data\";\n"\
-                          "  edge[style=solid,dir=back];\n"\
-                          "  node[shape=ellipse,fontsize=14,fixedsize=false,width=0.75];\n";
-        
-        // create knowledge nodes
-        dot            += "  subgraph knowledge {\n"\
-                          "    rank = same;\n"\
-                          "    \"Knowledge\";\n";
-        for(iter = knowledge_nodes.begin(); iter != knowledge_nodes.end(); iter++) {
-          dot          += "    \""+(iter->node)+"\""+(is_marked(iter->node)?" [style=bold,color=red2]":"")+";\n";
-        }
-        dot            += "  }\n";
-
-        // create information nodes
-        dot            += "  subgraph information {\n"\
-                          "    rank = same;\n"\
-                          "    \"Information\";\n";
-        for(iter = information_nodes.begin(); iter != information_nodes.end(); iter++) {
-          dot          += "    \""+(iter->node)+"\""+(is_marked(iter->node)?" [style=bold,color=red2]":"")+";\n";
-        }
-        dot            += "  }\n";
-
-        // create data nodes
-        dot            += "  subgraph data {\n"\
-                          "    rank = same;\n"\
-                          "    \"Data\";\n";
-        for(iter = data_nodes.begin(); iter != data_nodes.end(); iter++) {
-          dot          += "    \""+(iter->node)+"\""+(is_marked(iter->node)?" [style=bold,color=red2]":"")+";\n";
-        }
-        dot            += "  }\n";
+      const std::string& get_dot() {
+        if(dot_valid)
+          return dot;
 
-        // create edges
-        for(edgeiter = edges.begin(); edgeiter != edges.end(); edgeiter++) {
-          dot          += "    \""+(edgeiter->to)+"\" -> \""+(edgeiter->from)+"\""+edgeiter->dot_edge(is_marked(edgeiter->from) && is_marked(edgeiter->to))+";\n";
+        size_t size = 512 + LEVELS*64;
+        for(size_t i = 0; i < nodes.size(); i++) {
+          update_node_dot(i);
+          size += node_dot[i].size();
+        }
+        for(size_t i = 0; i < edges.size(); i++) {
+          update_edge_dot(i);
+          size += edge_dot[i].size();
+        }
+
+        dot.clear();
+        dot.reserve(size);
+        append_dot_header(dot);
+
+        // create knowledge, information and data nodes
+        for(int l = 0; l < LEVELS; l++) {
+          append_dot_level(dot, l);
+          std::vector<int>::iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++)
+            dot.append(node_dot[*iter]);
+          dot.append("  }\n");
         }
 
+        // create edges
+        for(size_t i = 0; i < edges.size(); i++)
+          dot.append(edge_dot[i]);
+
         // end the graph
-        dot            += "}";
-        
+        dot.append("}");
+        dot_valid = true;
+
         return dot;
       }
 
-      /** mark the node and it's children and parents
-       *  @param node name of the node
+      /** a link between a visible node and the summary of its hidden
+       *  neighbours in one level
        */
-      void mark_node(std::string node) {
-        //find nodes and edges connected to the markupnode
-        if(node != "") {
-          if(!is_marked(node))
-            marked_nodes.push_back(node);
+      struct SummaryLink {
+        /** id of the visible node */
+        int   node;
+        /** level of the hidden neighbours */
+        Level level;
+        /** number of edges to hidden neighbours in the level */
+        int   count;
+      };
+
+      /** name of the node that stands for the hidden nodes of a level
+       *  in a partial view of the graph
+       *  @param level the level
+       *  @param hidden number of hidden nodes
+       *  @return name of the summary node, e.g. "+12 more knowledge"
+       */
+      static std::string summary_name(Level level, int hidden) {
+        std::ostringstream name;
+        name << "+" << hidden << " more " << level_name(level);
+        return name.str();
+      }
+
+      /** checks if a name is the name of a summary node
+       *  @param name the name
+       *  @param level upon return contains the level of the summary
+       *  @return true if the name is a summary_name and not a node of the graph
+       */
+      bool is_summary(const std::string &name, Level &level) const {
+        size_t more = name.find(" more ");
+        if(name.empty() || name[0] != '+' || more == std::string::npos || is_node(name))
+          return false;
+        for(int l = 0; l < LEVELS; l++) {
+          if(name.compare(more+6, std::string::npos, level_name((Level)l)) == 0) {
+            level = (Level)l;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /** counts the hidden nodes of each level of a partial view
+       *  @param visible visibility of the nodes, by id
+       *  @param hidden receives the number of hidden nodes of each level
+       */
+      void count_hidden(const std::vector<bool> &visible, int hidden[LEVELS]) const {
+        for(int l = 0; l < LEVELS; l++) {
+          hidden[l] = 0;
+          std::vector<int>::const_iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++)
+            if(!visible[*iter])
+              hidden[l]++;
+        }
+      }
+
+      /** collects the links between the visible nodes of a partial view
+       *  and the summaries of their hidden neighbours
+       *  @param visible visibility of the nodes, by id
+       *  @param links receives one link per visible node and level with hidden neighbours
+       */
+      void summary_links(const std::vector<bool> &visible, std::vector<SummaryLink> &links) const {
+        links.clear();
+        for(int id = 0; id < (int)nodes.size(); id++) {
+          if(!visible[id])
+            continue;
+          int counts[LEVELS] = { 0 };
+          std::vector<int>::const_iterator iter;
+          for(iter = nodes[id].parents.begin(); iter != nodes[id].parents.end(); iter++)
+            if(!visible[*iter])
+              counts[nodes[*iter].level]++;
+          for(iter = nodes[id].children.begin(); iter != nodes[id].children.end(); iter++)
+            if(!visible[*iter])
+              counts[nodes[*iter].level]++;
+          for(int l = 0; l < LEVELS; l++) {
+            if(counts[l] > 0) {
+              SummaryLink link;
+              link.node = id;
+              link.level = (Level)l;
+              link.count = counts[l];
+              links.push_back(link);
+            }
+          }
+        }
+      }
 
-          //mark nodes pointing to marked nodes
-          mark_children(get_node(node));
+      /** creates the dot representation of a part of the graph
+       *  the hidden nodes of each level are collapsed into one summary node
+       *  named by summary_name, which is linked to the visible nodes with
+       *  hidden neighbours in its level, so the size of the document only
+       *  depends on the visible part
+       *  @param visible visibility of the nodes, by id
+       *  @return string containing the partial graph in dot
+       */
+      std::string get_dot(const std::vector<bool> &visible) {
+        int hidden[LEVELS];
+        count_hidden(visible, hidden);
+        std::vector<SummaryLink> links;
+        summary_links(visible, links);
 
-          //mark nodes pointed from marked nodes
-          mark_parents(get_node(node));
+        std::string out;
+        append_dot_header(out);
+        for(int l = 0; l < LEVELS; l++) {
+          append_dot_level(out, l);
+          std::vector<int>::iterator iter;
+          for(iter = level_ids[l].begin(); iter != level_ids[l].end(); iter++) {
+            if(visible[*iter]) {
+              update_node_dot(*iter);
+              out.append(node_dot[*iter]);
+            }
+          }
+          if(hidden[l] > 0)
+            out.append("    \"").append(summary_name((Level)l, hidden[l])).append("\" [style=dashed];\n");
+          out.append("  }\n");
         }
+
+        for(size_t i = 0; i < edges.size(); i++) {
+          if(visible[edges[i].from_id] && visible[edges[i].to_id]) {
+            update_edge_dot(i);
+            out.append(edge_dot[i]);
+          }
+        }
+
+        // summary edges point downwards like the rank boxes
+        std::vector<SummaryLink>::iterator link;
+        for(link = links.begin(); link != links.end(); link++) {
+          std::string node = "\"" + nodes[link->node].node + "\"";
+          std::string summary = "\"" + summary_name(link->level, hidden[link->level]) + "\"";
+          bool up = link->level < nodes[link->node].level;
+          std::ostringstream count;
+          count << link->count;
+          out.append("    ").append(up ? summary : node).append(" -> ").append(up ? node : summary)
+             .append(" [dir=none,style=dashed,label=\"").append(count.str()).append("\"];\n");
+        }
+
+        out.append("}");
+        return out;
+      }
+
+      /** mark the node and it's children and parents
+       *  @param node name of the node
+       */
+      void mark_node(std::string node) {
+        int id = node_id(node);
+        if(id >= 0)
+          set_root(id, true);
       }
 
       /** unmark the node and it's children and parents (if not otherwise marked)
+       *  removes every mark whose highlight contains the node
        *  @param node name of the node
        */
       void unmark_node(std::string node) {
-        if(node != "") {
-          if(is_marked(node)) {
-            marked_nodes.remove(node);
+        int id = node_id(node);
+        if(id >= 0) {
+          std::vector<int> ids;
+          closure(id, ids);
+          std::vector<int>::iterator iter;
+          for(iter = ids.begin(); iter != ids.end(); iter++) {
+            mark_pinned[*iter] = false;
+            dot_valid = false;
+            if(mark_root[*iter]) {
+              mark_root[*iter] = false;
+              root_count--;
+              count_marks(*iter, -1);
+            }
           }
-
-          //unmark nodes pointed from marked nodes
-          unmark_parents(get_node(node));
-
-          //unmark nodes pointing to marked nodes
-          unmark_children(get_node(node));
         }
       }
 
       /** clear the markup of the graph
        */
       void clear_markup() {
-        marked_nodes.clear();
+        std::fill(mark_count.begin(), mark_count.end(), 0);
+        std::fill(mark_root.begin(), mark_root.end(), false);
+        std::fill(mark_pinned.begin(), mark_pinned.end(), false);
+        root_count = 0;
+        dot_valid = false;
       }
 
     public:
       /** name of the graph */
       std::string             name;
-      /** list of knowledge nodes */
-      std::list<KIDNode>      knowledge_nodes;
-      /** list of information nodes */
-      std::list<KIDNode>      information_nodes;
-      /** list of data nodes */
-      std::list<KIDNode>      data_nodes;
-      /** list of edges */
-      std::list<KIDEdge>      edges;
-    
+
     private:
-      /** list of marked nodes */
-      std::list<std::string>  marked_nodes;
+      /** all nodes, indexed by id */
+      std::vector<KIDNode>                    nodes;
+      /** index from node name to id */
+      NameIndex                               node_index;
+      /** ids of the nodes of each level in insertion order */
+      std::vector<int>                        level_ids[LEVELS];
+      /** all edges in insertion order */
+      std::vector<KIDEdge>                    edges;
+      /** index of the existing edges */
+      EdgeIndex                               edge_index;
+      /** number of marked roots whose closure contains the node, by id */
+      std::vector<int>                        mark_count;
+      /** nodes marked by mark_node, by id */
+      std::vector<bool>                       mark_root;
+      /** loaded marks without a known root, they only mark themselves */
+      std::vector<bool>                       mark_pinned;
+      /** number of marked roots */
+      int                                     root_count;
+      /** traversal stamps of the nodes, by id */
+      std::vector<unsigned>                   seen_down,
+                                              seen_up,
+                                              seen_closure;
+      /** current traversal stamp */
+      unsigned                                stamp;
+      /** queue of the breadth first traversal */
+      std::vector<int>                        bfs_queue;
+      /** true to use the reachability index */
+      bool                                    use_index;
+      /** reachability index used for marking */
+      ReachabilityIndex<KIDNode>              reach;
+      /** cached dot fragments of the nodes, by id */
+      std::vector<std::string>                node_dot;
+      /** marking the node fragments were created with, by id */
+      std::vector<signed char>                node_dot_state;
+      /** cached dot fragments of the edges, in edge order */
+      std::vector<std::string>                edge_dot;
+      /** marking the edge fragments were created with, in edge order */
+      std::vector<signed char>                edge_dot_state;
+      /** cached dot document */
+      std::string                             dot;
+      /** true if the cached dot document is up to date */
+      bool                                    dot_valid;
   };
 }
-
@@ -0,0 +1,416 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+#include "kidgraph.h"
+
+namespace SceneReconstruction {
+/** @class KIDJournal "kidjournal.h"
+ *  Applies the edits of a KID Graph and records each of them as a
+ *  delta, so edits can be undone and redone without serializing the
+ *  graph. An undone edit restores the order of the levels and edges
+ *  and the marks exactly, a redone edit is applied again.
+ *  @author Bastian Klingen
+ */
+  class KIDJournal {
+    public:
+      /** Constructor
+       *  @param _graph the graph to edit
+       *  @param _limit maximal number of edits that can be undone
+       */
+      KIDJournal(KIDGraph &_graph, size_t _limit = 100) : graph(_graph), limit(_limit), serial(0), saved(0), base(0) {}
+
+      /** forgets all recorded edits, the current state counts as saved
+       */
+      void clear() {
+        base = saved = current();
+        done.clear();
+        undone.clear();
+      }
+
+      /** adds a node
+       *  @param node name of the node
+       *  @param level level of the node
+       *  @return true if the node was added
+       */
+      bool add_node(const std::string &node, KIDGraph::Level level) {
+        if(graph.add_node(node, level) < 0)
+          return false;
+
+        Operation op(ADD_NODE);
+        op.node = node;
+        op.level = level;
+        record(op);
+        return true;
+      }
+
+      /** removes a node and its edges
+       *  @param node name of the node
+       *  @return true if the node existed
+       */
+      bool remove_node(const std::string &node) {
+        int id = graph.node_id(node);
+        if(id < 0)
+          return false;
+
+        Operation op(REMOVE_NODE);
+        const KIDGraph::KIDNode &n = graph.get_node(id);
+        op.node = node;
+        op.level = n.level;
+        op.position = graph.level_position(id);
+        op.positioned = n.positioned;
+        op.x = n.x;
+        op.y = n.y;
+        if(graph.is_root(id))
+          op.roots.push_back(node);
+        if(graph.is_pinned(id))
+          op.pinned.push_back(node);
+        // the edges are kept in ascending order so they can be inserted again in order
+        const std::vector<KIDGraph::KIDEdge> &edges = graph.get_edges();
+        for(size_t i = 0; i < edges.size(); i++)
+          if(edges[i].from_id == id || edges[i].to_id == id)
+            op.edges.push_back(std::make_pair((int)i, edges[i]));
+
+        graph.remove_node(node);
+        record(op);
+        return true;
+      }
+
+      /** adds an edge
+       *  @param edge the edge
+       *  @return true if the edge was added
+       */
+      bool add_edge(const KIDGraph::KIDEdge &edge) {
+        if(!graph.add_edge(edge))
+          return false;
+
+        Operation op(ADD_EDGE);
+        op.edges.push_back(std::make_pair((int)graph.get_edges().size()-1, edge));
+        record(op);
+        return true;
+      }
+
+      /** removes an edge
+       *  @param edge the edge
+       *  @return true if the edge existed
+       */
+      bool remove_edge(const KIDGraph::KIDEdge &edge) {
+        int position = graph.edge_position(edge);
+        if(position < 0)
+          return false;
+
+        Operation op(REMOVE_EDGE);
+        op.edges.push_back(std::make_pair(position, edge));
+        graph.remove_edge(edge);
+        record(op);
+        return true;
+      }
+
+      /** marks a node, its ancestors and its descendants
+       *  @param node name of the node
+       *  @return true if the marking changed
+       */
+      bool mark_node(const std::string &node) {
+        int id = graph.node_id(node);
+        if(id < 0 || graph.is_root(id))
+          return false;
+
+        Operation op(MARK);
+        op.node = node;
+        graph.mark_node(node);
+        record(op);
+        return true;
+      }
+
+      /** removes every mark whose highlight contains the node
+       *  @param node name of the node
+       *  @return true if the marking changed
+       */
+      bool unmark_node(const std::string &node) {
+        int id = graph.node_id(node);
+        if(id < 0)
+          return false;
+
+        Operation op(UNMARK);
+        op.node = node;
+        std::vector<int> ids;
+        graph.get_closure(id, ids);
+        collect_marks(ids, op);
+        if(op.roots.empty() && op.pinned.empty())
+          return false;
+
+        graph.unmark_node(node);
+        record(op);
+        return true;
+      }
+
+      /** removes all marks
+       *  @return true if the marking changed
+       */
+      bool clear_markup() {
+        Operation op(CLEAR_MARKUP);
+        std::vector<int> ids(graph.node_count());
+        for(int i = 0; i < graph.node_count(); i++)
+          ids[i] = i;
+        collect_marks(ids, op);
+        if(op.roots.empty() && op.pinned.empty())
+          return false;
+
+        graph.clear_markup();
+        record(op);
+        return true;
+      }
+
+      /** checks if there is an edit to undo
+       *  @return true if undo is possible
+       */
+      bool can_undo() const {
+        return !done.empty();
+      }
+
+      /** checks if there is an edit to redo
+       *  @return true if redo is possible
+       */
+      bool can_redo() const {
+        return !undone.empty();
+      }
+
+      /** describes the edit undo would revert
+       *  @return description of the edit or "" if there is none
+       */
+      std::string undo_description() const {
+        return done.empty() ? "" : describe(done.back());
+      }
+
+      /** describes the edit redo would apply
+       *  @return description of the edit or "" if there is none
+       */
+      std::string redo_description() const {
+        return undone.empty() ? "" : describe(undone.back());
+      }
+
+      /** reverts the last edit
+       *  @return true if an edit was reverted
+       */
+      bool undo() {
+        if(done.empty())
+          return false;
+
+        Operation op = done.back();
+        done.pop_back();
+        revert(op);
+        undone.push_back(op);
+        return true;
+      }
+
+      /** applies the last reverted edit again
+       *  @return true if an edit was applied
+       */
+      bool redo() {
+        if(undone.empty())
+          return false;
+
+        Operation op = undone.back();
+        undone.pop_back();
+        apply(op);
+        done.push_back(op);
+        return true;
+      }
+
+      /** checks if the graph changed since it was saved
+       *  @return true if there are unsaved edits
+       */
+      bool modified() const {
+        return current() != saved;
+      }
+
+      /** remembers the current state as saved
+       */
+      void set_saved() {
+        saved = current();
+      }
+
+      /** identifies the state of the graph, undo and redo return to the
+       *  revisions of the earlier states
+       *  @return the revision
+       */
+      unsigned long revision() const {
+        return current();
+      }
+
+    private:
+      /** types of the recorded edits */
+      enum Type { ADD_NODE, REMOVE_NODE, ADD_EDGE, REMOVE_EDGE, MARK, UNMARK, CLEAR_MARKUP };
+
+      /** a recorded edit with everything needed to revert it */
+      struct Operation {
+        /** type of the edit */
+        Type                                             type;
+        /** unique number of the edit, identifies the state after it */
+        unsigned long                                    serial;
+        /** name of the node */
+        std::string                                      node;
+        /** level of the node */
+        KIDGraph::Level                                  level;
+        /** position of the node inside its level */
+        int                                              position;
+        /** layout position of the removed node */
+        bool                                             positioned;
+        double                                           x, y;
+        /** added or removed edges with their positions in ascending order */
+        std::vector<std::pair<int, KIDGraph::KIDEdge> > edges;
+        /** names of the nodes that lost their root mark */
+        std::vector<std::string>                         roots;
+        /** names of the nodes that lost their pinned mark */
+        std::vector<std::string>                         pinned;
+
+        /** Constructor
+         *  @param t type of the edit
+         */
+        Operation(Type t) : type(t), serial(0), level(KIDGraph::KNOWLEDGE), position(-1), positioned(false), x(0), y(0) {}
+      };
+
+      /** identifies the current state
+       *  @return serial of the last applied edit or of the state before the oldest one
+       */
+      unsigned long current() const {
+        return done.empty() ? base : done.back().serial;
+      }
+
+      /** stores an applied edit, drops the redo history and the oldest edits over the limit
+       *  @param op the edit
+       */
+      void record(Operation &op) {
+        op.serial = ++serial;
+        done.push_back(op);
+        undone.clear();
+        while(done.size() > limit) {
+          base = done.front().serial;
+          done.pop_front();
+        }
+      }
+
+      /** collects the root and pinned marks of some nodes
+       *  @param ids ids of the nodes
+       *  @param op receives the names
+       */
+      void collect_marks(const std::vector<int> &ids, Operation &op) {
+        std::vector<int>::const_iterator iter;
+        for(iter = ids.begin(); iter != ids.end(); iter++) {
+          if(graph.is_root(*iter))
+            op.roots.push_back(graph.get_node(*iter).node);
+          if(graph.is_pinned(*iter))
+            op.pinned.push_back(graph.get_node(*iter).node);
+        }
+      }
+
+      /** restores marks removed by an edit
+       *  @param op the edit
+       */
+      void restore_marks(const Operation &op) {
+        std::vector<std::string>::const_iterator iter;
+        for(iter = op.roots.begin(); iter != op.roots.end(); iter++)
+          graph.set_root(graph.node_id(*iter), true);
+        for(iter = op.pinned.begin(); iter != op.pinned.end(); iter++)
+          graph.set_pinned(graph.node_id(*iter), true);
+      }
+
+      /** applies an edit to the graph
+       *  @param op the edit
+       */
+      void apply(const Operation &op) {
+        switch(op.type) {
+          case ADD_NODE:
+            graph.add_node(op.node, op.level);
+            break;
+          case REMOVE_NODE:
+            graph.remove_node(op.node);
+            break;
+          case ADD_EDGE:
+            graph.add_edge(op.edges.front().second);
+            break;
+          case REMOVE_EDGE:
+            graph.remove_edge(op.edges.front().second);
+            break;
+          case MARK:
+            graph.mark_node(op.node);
+            break;
+          case UNMARK:
+            graph.unmark_node(op.node);
+            break;
+          case CLEAR_MARKUP:
+            graph.clear_markup();
+            break;
+        }
+      }
+
+      /** reverts an edit of the graph
+       *  @param op the edit
+       */
+      void revert(const Operation &op) {
+        switch(op.type) {
+          case ADD_NODE:
+            graph.remove_node(op.node);
+            break;
+          case REMOVE_NODE: {
+            int id = graph.add_node(op.node, op.level, op.position);
+            if(op.positioned)
+              graph.set_position(id, op.x, op.y);
+            std::vector<std::pair<int, KIDGraph::KIDEdge> >::const_iterator iter;
+            for(iter = op.edges.begin(); iter != op.edges.end(); iter++)
+              graph.add_edge(iter->second, iter->first);
+            restore_marks(op);
+            break;
+          }
+          case ADD_EDGE:
+            graph.remove_edge(op.edges.front().second);
+            break;
+          case REMOVE_EDGE:
+            graph.restore_edge(op.edges.front().second, op.edges.front().first);
+            break;
+          case MARK:
+            graph.set_root(graph.node_id(op.node), false);
+            break;
+          case UNMARK:
+          case CLEAR_MARKUP:
+            restore_marks(op);
+            break;
+        }
+      }
+
+      /** describes an edit for the log
+       *  @param op the edit
+       *  @return description of the edit
+       */
+      static std::string describe(const Operation &op) {
+        switch(op.type) {
+          case ADD_NODE:     return "add node \""+op.node+"\"";
+          case REMOVE_NODE:  return "remove node \""+op.node+"\"";
+          case ADD_EDGE:     return "add edge "+op.edges.front().second.toString();
+          case REMOVE_EDGE:  return "remove edge "+op.edges.front().second.toString();
+          case MARK:         return "mark node \""+op.node+"\"";
+          case UNMARK:       return "unmark node \""+op.node+"\"";
+          case CLEAR_MARKUP: return "unmark graph";
+          default:           return "";
+        }
+      }
+
+    private:
+      /** the edited graph */
+      KIDGraph                  &graph;
+      /** maximal number of edits that can be undone */
+      size_t                     limit;
+      /** applied edits, the last one is undone first */
+      std::deque<Operation>      done;
+      /** reverted edits, the last one is redone first */
+      std::vector<Operation>     undone;
+      /** serial of the last recorded edit */
+      unsigned long              serial;
+      /** serial of the saved state */
+      unsigned long              saved;
+      /** serial of the state before the oldest edit in done */
+      unsigned long              base;
+  };
+}
@@ -0,0 +1,797 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+#include "kidgraph.h"
+
+namespace SceneReconstruction {
+/** @class KIDLayout "kidlayout.h"
+ *  Layered layout specialized for KID Graphs. The ranks are fixed by the
+ *  levels, Knowledge on top and Data at the bottom, edges skipping the
+ *  Information rank get a dummy node there. The order inside the ranks
+ *  is found by barycentric sweeps that are only accepted if they reduce
+ *  the crossings, the coordinates by placing every rank as close to the
+ *  average position of the neighbours as the node distances allow.
+ *  The x coordinates of the last layout are kept by node name and are
+ *  used as the start of the next one, so small edits only move nodes
+ *  near the change. Nodes with a position in the KID Graph are pinned
+ *  to it, new nodes make room before pinned ones move. The order is
+ *  only optimized again on request or if the crossings grew too much.
+ *  @author Bastian Klingen
+ */
+  class KIDLayout {
+    public:
+      /** distances of the layout in points */
+      enum Distances {
+        /** distance between the ranks */
+        RANKSEP     = 72,
+        /** minimal distance between the nodes of a rank */
+        NODESEP     = 18,
+        /** height of the ranks */
+        RANK_HEIGHT = 36,
+        /** border around the drawing */
+        MARGIN      = 4,
+        /** crossings an incremental layout may add on top of the quality factor */
+        QUALITY_SLACK = 8,
+        /** weight of a kept position against the position of a new node */
+        KEPT_WEIGHT = 100
+      };
+
+      /** a node, the renderer sets the size, the layout the center */
+      struct Node {
+        /** name of the node */
+        std::string name;
+        /** rank of the node, 0 is Knowledge */
+        int         rank;
+        /** true for the box naming the rank */
+        bool        rank_box;
+        /** true if the node is marked */
+        bool        marked;
+        /** true for the node standing for the hidden nodes of its rank */
+        bool        summary;
+        /** width of the node */
+        double      width;
+        /** height of the node */
+        double      height;
+        /** center of the node */
+        double      x, y;
+        /** true if the node has a position to keep */
+        bool        pinned;
+        /** x coordinate to keep */
+        double      pin_x;
+
+        /** Constructor */
+        Node() : rank(0), rank_box(false), marked(false), summary(false), width(0), height(0), x(0), y(0), pinned(false), pin_x(0) {}
+
+        /** equality operator, compares the input of the layout
+         *  @param rhs a node to compare with
+         *  @return true if the nodes are equal
+         */
+        bool operator==(const Node &rhs) const {
+          return name == rhs.name && rank == rhs.rank && rank_box == rhs.rank_box && marked == rhs.marked && summary == rhs.summary;
+        }
+      };
+
+      /** an edge drawn from the upper to the lower node */
+      struct Edge {
+        /** index of the node from which the edge comes */
+        int                 from;
+        /** index of the node to which the edge points */
+        int                 to;
+        /** label of the edge */
+        std::string         label;
+        /** true if the edge is marked */
+        bool                marked;
+        /** true for an edge to a summary node, it has no direction */
+        bool                summary;
+        /** bezier control points, 3n+1 of them */
+        std::vector<double> px, py;
+        /** true if the arrow head is at the first control point */
+        bool                arrow_at_start;
+        /** position of the label */
+        double              label_x, label_y;
+
+        /** Constructor */
+        Edge() : from(-1), to(-1), marked(false), summary(false), arrow_at_start(false), label_x(0), label_y(0) {}
+
+        /** equality operator, compares the input of the layout
+         *  @param rhs an edge to compare with
+         *  @return true if the edges are equal
+         */
+        bool operator==(const Edge &rhs) const {
+          return from == rhs.from && to == rhs.to && label == rhs.label && marked == rhs.marked && summary == rhs.summary;
+        }
+      };
+
+      /** the graph to lay out and the result */
+      struct Graph {
+        /** the nodes, the rank boxes first */
+        std::vector<Node> nodes;
+        /** the edges */
+        std::vector<Edge> edges;
+        /** size of the drawing */
+        double            width, height;
+
+        /** Constructor */
+        Graph() : width(0), height(0) {}
+
+        /** equality operator, compares the input of the layout
+         *  @param rhs a graph to compare with
+         *  @return true if the graphs are equal
+         */
+        bool operator==(const Graph &rhs) const {
+          return nodes == rhs.nodes && edges == rhs.edges;
+        }
+
+        /** exchanges the content with another graph
+         *  @param other the other graph
+         */
+        void swap(Graph &other) {
+          nodes.swap(other.nodes);
+          edges.swap(other.edges);
+          std::swap(width, other.width);
+          std::swap(height, other.height);
+        }
+      };
+
+      /** copies the structure and marking of a KID Graph
+       *  the nodes follow the order of the levels, so the first layout
+       *  keeps the insertion order where it does not cause crossings
+       *  @param kid the KID Graph
+       *  @param graph receives the graph to lay out
+       *  @param visible visibility of the nodes by id to copy only a part
+       *         of the graph, the hidden nodes of each rank are replaced by a
+       *         summary node like KIDGraph::get_dot does, NULL to copy all
+       */
+      static void snapshot(const KIDGraph &kid, Graph &graph, const std::vector<bool> *visible = NULL) {
+        static const char *names[KIDGraph::LEVELS] = { "Knowledge", "Information", "Data" };
+        graph = Graph();
+        graph.nodes.reserve(kid.node_count() + KIDGraph::LEVELS);
+        for(int l = 0; l < KIDGraph::LEVELS; l++) {
+          Node box;
+          box.name = names[l];
+          box.rank = l;
+          box.rank_box = true;
+          graph.nodes.push_back(box);
+        }
+
+        int hidden[KIDGraph::LEVELS] = { 0 };
+        int summaries[KIDGraph::LEVELS] = { -1, -1, -1 };
+        if(visible)
+          kid.count_hidden(*visible, hidden);
+
+        std::vector<int> index(kid.node_count(), -1);
+        for(int l = 0; l < KIDGraph::LEVELS; l++) {
+          const std::vector<int> &ids = kid.level_nodes((KIDGraph::Level)l);
+          for(size_t i = 0; i < ids.size(); i++) {
+            if(visible && !(*visible)[ids[i]])
+              continue;
+            Node node;
+            node.name = kid.get_node(ids[i]).node;
+            node.rank = l;
+            node.marked = kid.is_marked(ids[i]);
+            node.pinned = kid.get_node(ids[i]).positioned;
+            node.pin_x = kid.get_node(ids[i]).x;
+            index[ids[i]] = graph.nodes.size();
+            graph.nodes.push_back(node);
+          }
+          if(hidden[l] > 0) {
+            Node summary;
+            summary.name = KIDGraph::summary_name((KIDGraph::Level)l, hidden[l]);
+            summary.rank = l;
+            summary.summary = true;
+            summaries[l] = graph.nodes.size();
+            graph.nodes.push_back(summary);
+          }
+        }
+
+        const std::vector<KIDGraph::KIDEdge> &edges = kid.get_edges();
+        graph.edges.reserve(edges.size());
+        for(size_t i = 0; i < edges.size(); i++) {
+          if(index[edges[i].from_id] < 0 || index[edges[i].to_id] < 0)
+            continue;
+          Edge edge;
+          edge.from = index[edges[i].from_id];
+          edge.to = index[edges[i].to_id];
+          edge.label = edges[i].label;
+          edge.marked = kid.is_marked(edges[i].from_id) && kid.is_marked(edges[i].to_id);
+          graph.edges.push_back(edge);
+        }
+
+        if(visible) {
+          std::vector<KIDGraph::SummaryLink> links;
+          kid.summary_links(*visible, links);
+          for(size_t i = 0; i < links.size(); i++) {
+            Edge edge;
+            edge.from = index[links[i].node];
+            edge.to = summaries[links[i].level];
+            std::ostringstream count;
+            count << links[i].count;
+            edge.label = count.str();
+            edge.summary = true;
+            graph.edges.push_back(edge);
+          }
+        }
+      }
+
+      /** forgets the positions of the last layout */
+      void reset() {
+        previous.clear();
+      }
+
+      /** number of edge crossings of the last layout
+       *  @return the crossings
+       */
+      long get_crossings() const {
+        return current_crossings;
+      }
+
+      /** checks if the last layout optimized the order of all nodes
+       *  @return true if it was a full layout
+       */
+      bool was_full() const {
+        return !incremental;
+      }
+
+      /** sets how much an incremental layout may be worse than a full one
+       *  @param factor allowed crossings relative to the crossings per
+       *         edge of the last full layout
+       */
+      void set_quality(double factor) {
+        quality = factor;
+      }
+
+      /** lays out a graph, the sizes of the nodes have to be set
+       *  without a full layout pinned nodes and the nodes of the last
+       *  layout keep their order and position where possible, only the
+       *  new nodes are placed
+       *  @param graph the graph, receives the positions and edge curves
+       *  @param full true to optimize the order of all nodes again
+       */
+      void layout(Graph &graph, bool full = false) {
+        incremental = !full;
+        build(graph);
+        if(incremental && kept == 0)
+          incremental = false;
+
+        if(incremental) {
+          current_crossings = crossings();
+          // too many new crossings, the order is optimized from scratch
+          if(current_crossings > quality * full_ratio * segments + QUALITY_SLACK) {
+            incremental = false;
+            build(graph);
+          }
+        }
+        if(!incremental) {
+          order();
+          full_ratio = segments > 0 ? (double)current_crossings / segments : 0;
+        }
+        place();
+        route(graph);
+
+        previous.clear();
+        for(size_t i = 0; i < graph.nodes.size(); i++)
+          if(!graph.nodes[i].rank_box)
+            previous[graph.nodes[i].name] = graph.nodes[i].x;
+        for(size_t e = 0; e < chains.size(); e++)
+          for(size_t i = 1; i+1 < chains[e].size(); i++)
+            previous[dummy_name(graph, e, i)] = vnodes[chains[e][i]].x;
+      }
+
+      /** Constructor */
+      KIDLayout() : current_crossings(0), incremental(false), quality(1.5), full_ratio(0), kept(0), segments(0) {}
+
+    private:
+      /** a node of the layered graph, dummies have no real node */
+      struct VNode {
+        /** index of the real node or -1 for dummies */
+        int              real;
+        /** rank of the node */
+        int              rank;
+        /** width of the node */
+        double           width;
+        /** neighbours in the rank above and below */
+        std::vector<int> up, down;
+        /** position inside the rank */
+        int              pos;
+        /** x coordinate of the center */
+        double           x;
+        /** sort key while ordering */
+        double           key;
+        /** true if the node has a position from the last layout */
+        bool             kept;
+      };
+
+      /** orders virtual nodes by key, the position breaks ties */
+      struct ByKey {
+        const std::vector<VNode> *v;
+        bool operator()(int a, int b) const {
+          if((*v)[a].key != (*v)[b].key)
+            return (*v)[a].key < (*v)[b].key;
+          return (*v)[a].pos < (*v)[b].pos;
+        }
+      };
+
+      /** creates the layered graph with the initial order of the ranks
+       *  @param graph the graph
+       */
+      void build(const Graph &graph) {
+        vnodes.clear();
+        chains.assign(graph.edges.size(), std::vector<int>());
+        for(int r = 0; r < KIDGraph::LEVELS; r++) {
+          ranks[r].clear();
+          boxes[r] = -1;
+        }
+
+        for(size_t i = 0; i < graph.nodes.size(); i++) {
+          const Node &node = graph.nodes[i];
+          VNode v;
+          v.real = i;
+          v.rank = node.rank;
+          v.width = node.width;
+          v.pos = ranks[node.rank].size();
+          v.x = 0;
+          v.kept = false;
+          v.key = HUGE_VAL;
+          if(incremental && !node.rank_box) {
+            std::map<std::string, double>::const_iterator p = previous.find(node.name);
+            if(node.pinned) {
+              v.kept = true;
+              v.key = node.pin_x;
+            }
+            else if(p != previous.end()) {
+              v.kept = true;
+              v.key = p->second;
+            }
+          }
+          if(node.rank_box)
+            boxes[node.rank] = i;
+          else
+            ranks[node.rank].push_back(i);
+          vnodes.push_back(v);
+        }
+
+        // edges between the ranks, long edges get a dummy node in between
+        for(size_t e = 0; e < graph.edges.size(); e++) {
+          int a = graph.edges[e].from, b = graph.edges[e].to;
+          if(a < 0 || b < 0 || vnodes[a].rank == vnodes[b].rank)
+            continue;
+          if(vnodes[a].rank > vnodes[b].rank)
+            std::swap(a, b);
+
+          std::vector<int> &chain = chains[e];
+          chain.push_back(a);
+          for(int r = vnodes[a].rank+1; r < vnodes[b].rank; r++) {
+            VNode d;
+            d.real = -1;
+            d.rank = r;
+            d.width = (double)NODESEP;
+            d.pos = ranks[r].size();
+            d.x = 0;
+            std::map<std::string, double>::const_iterator p = previous.find(dummy_name(graph, e, chain.size()));
+            d.kept = incremental && p != previous.end();
+            d.key = d.kept ? p->second : HUGE_VAL;
+            ranks[r].push_back(vnodes.size());
+            chain.push_back(vnodes.size());
+            vnodes.push_back(d);
+          }
+          chain.push_back(b);
+          for(size_t i = 0; i+1 < chain.size(); i++) {
+            vnodes[chain[i]].down.push_back(chain[i+1]);
+            vnodes[chain[i+1]].up.push_back(chain[i]);
+          }
+        }
+
+        // new nodes start next to their kept neighbours, dummies between their ends
+        for(size_t i = 0; i < vnodes.size(); i++) {
+          VNode &v = vnodes[i];
+          if(v.kept)
+            continue;
+          double sum = 0;
+          int count = 0;
+          neighbour_keys(v.up, sum, count);
+          neighbour_keys(v.down, sum, count);
+          if(count > 0)
+            v.key = sum / count;
+        }
+        for(int r = 0; r < KIDGraph::LEVELS; r++)
+          sort_rank(r);
+
+        kept = segments = 0;
+        for(size_t i = 0; i < vnodes.size(); i++) {
+          if(vnodes[i].kept && vnodes[i].real >= 0)
+            kept++;
+          segments += vnodes[i].down.size();
+        }
+      }
+
+      /** sums the keys of the neighbours that have a position
+       *  @param ids the neighbours
+       *  @param sum receives the sum
+       *  @param count receives the number of summed keys
+       */
+      void neighbour_keys(const std::vector<int> &ids, double &sum, int &count) const {
+        for(size_t i = 0; i < ids.size(); i++) {
+          if(vnodes[ids[i]].key != HUGE_VAL) {
+            sum += vnodes[ids[i]].key;
+            count++;
+          }
+        }
+      }
+
+      /** sorts a rank by key and updates the positions
+       *  @param r the rank
+       */
+      void sort_rank(int r) {
+        ByKey by_key;
+        by_key.v = &vnodes;
+        std::sort(ranks[r].begin(), ranks[r].end(), by_key);
+        for(size_t i = 0; i < ranks[r].size(); i++)
+          vnodes[ranks[r][i]].pos = i;
+      }
+
+      /** reduces the crossings with barycentric sweeps, a sweep is only
+       *  kept if it reduces the crossings, so an optimal order stays as it is
+       */
+      void order() {
+        std::vector<int> best[KIDGraph::LEVELS];
+        for(int r = 0; r < KIDGraph::LEVELS; r++)
+          best[r] = ranks[r];
+        long best_crossings = crossings();
+
+        for(int iteration = 0, idle = 0; iteration < 24 && idle < 4 && best_crossings > 0; iteration++) {
+          bool down = iteration % 2 == 0;
+          for(int step = 1; step < KIDGraph::LEVELS; step++) {
+            int r = down ? step : KIDGraph::LEVELS-1-step;
+            for(size_t i = 0; i < ranks[r].size(); i++) {
+              VNode &v = vnodes[ranks[r][i]];
+              const std::vector<int> &adjacent = down ? v.up : v.down;
+              if(adjacent.empty()) {
+                v.key = v.pos;
+                continue;
+              }
+              double sum = 0;
+              for(size_t j = 0; j < adjacent.size(); j++)
+                sum += vnodes[adjacent[j]].pos;
+              // scaled to the positions of this rank so unconnected nodes stay in place
+              double other = ranks[down ? r-1 : r+1].size();
+              v.key = other > 1 ? (sum / adjacent.size()) * (ranks[r].size()-1) / (other-1) : v.pos;
+            }
+            sort_rank(r);
+          }
+
+          long c = crossings();
+          if(c < best_crossings) {
+            best_crossings = c;
+            for(int r = 0; r < KIDGraph::LEVELS; r++)
+              best[r] = ranks[r];
+            idle = 0;
+          }
+          else
+            idle++;
+        }
+
+        for(int r = 0; r < KIDGraph::LEVELS; r++) {
+          ranks[r] = best[r];
+          for(size_t i = 0; i < ranks[r].size(); i++)
+            vnodes[ranks[r][i]].pos = i;
+        }
+        current_crossings = best_crossings;
+      }
+
+      /** counts the crossings between all neighbouring ranks
+       *  @return number of crossings
+       */
+      long crossings() const {
+        long total = 0;
+        std::vector<std::pair<int, int> > pairs;
+        std::vector<int> tree;
+        for(int r = 0; r+1 < KIDGraph::LEVELS; r++) {
+          pairs.clear();
+          for(size_t i = 0; i < ranks[r].size(); i++) {
+            const VNode &v = vnodes[ranks[r][i]];
+            for(size_t j = 0; j < v.down.size(); j++)
+              pairs.push_back(std::make_pair(v.pos, vnodes[v.down[j]].pos));
+          }
+          std::sort(pairs.begin(), pairs.end());
+
+          // inversions of the lower positions, counted with a fenwick tree
+          int n = ranks[r+1].size();
+          tree.assign(n+1, 0);
+          for(size_t i = 0; i < pairs.size(); i++) {
+            int greater = i;
+            for(int k = pairs[i].second+1; k > 0; k -= k & -k)
+              greater -= tree[k];
+            total += greater;
+            for(int k = pairs[i].second+1; k <= n; k += k & -k)
+              tree[k]++;
+          }
+        }
+        return total;
+      }
+
+      /** minimal distance between the centers of two neighbours in a rank
+       *  @param a left node
+       *  @param b right node
+       *  @return the distance
+       */
+      double separation(int a, int b) const {
+        return (vnodes[a].width + vnodes[b].width) / 2 + NODESEP;
+      }
+
+      /** places a rank as close to the wanted coordinates as the order and
+       *  the node distances allow, minimizing the squared displacement
+       *  weighted so that new nodes give way to kept ones
+       *  @param r the rank
+       *  @param wanted wanted x coordinate of every node of the rank
+       */
+      void place_rank(int r, const std::vector<double> &wanted) {
+        const std::vector<int> &rank = ranks[r];
+        size_t n = rank.size();
+        if(n == 0)
+          return;
+
+        // with the separations subtracted the order becomes x <= x', which
+        // is solved by pooling adjacent violators
+        std::vector<double> offset(n, 0);
+        for(size_t i = 1; i < n; i++)
+          offset[i] = offset[i-1] + separation(rank[i-1], rank[i]);
+
+        std::vector<double> mean, weight;
+        std::vector<int> size;
+        for(size_t i = 0; i < n; i++) {
+          mean.push_back(wanted[i] - offset[i]);
+          weight.push_back(vnodes[rank[i]].kept ? (double)KEPT_WEIGHT : 1.0);
+          size.push_back(1);
+          while(mean.size() > 1 && mean[mean.size()-2] > mean.back()) {
+            size_t b = mean.size()-1;
+            mean[b-1] = (mean[b-1]*weight[b-1] + mean[b]*weight[b]) / (weight[b-1] + weight[b]);
+            weight[b-1] += weight[b];
+            size[b-1] += size[b];
+            mean.pop_back();
+            weight.pop_back();
+            size.pop_back();
+          }
+        }
+        for(size_t b = 0, i = 0; b < mean.size(); b++)
+          for(int k = 0; k < size[b]; k++, i++)
+            vnodes[rank[i]].x = mean[b] + offset[i];
+      }
+
+      /** assigns the x coordinates, kept nodes want their old position,
+       *  the others the average position of their neighbours
+       */
+      void place() {
+        for(int r = 0; r < KIDGraph::LEVELS; r++) {
+          std::vector<double> wanted(ranks[r].size());
+          double x = 0;
+          for(size_t i = 0; i < ranks[r].size(); i++) {
+            const VNode &v = vnodes[ranks[r][i]];
+            if(i > 0)
+              x += separation(ranks[r][i-1], ranks[r][i]);
+            wanted[i] = v.kept ? v.key : x;
+          }
+          place_rank(r, wanted);
+        }
+
+        static const int passes[] = { 1, 0, 2, 1, 0, 2, 1, 0, 2, 1 };
+        for(size_t p = 0; p < sizeof(passes)/sizeof(passes[0]); p++) {
+          int r = passes[p];
+          std::vector<double> wanted(ranks[r].size());
+          for(size_t i = 0; i < ranks[r].size(); i++) {
+            const VNode &v = vnodes[ranks[r][i]];
+            if(v.kept) {
+              wanted[i] = v.key;
+              continue;
+            }
+            double sum = 0;
+            int count = 0;
+            for(size_t j = 0; j < v.up.size(); j++, count++)
+              sum += vnodes[v.up[j]].x;
+            for(size_t j = 0; j < v.down.size(); j++, count++)
+              sum += vnodes[v.down[j]].x;
+            wanted[i] = count > 0 ? sum / count : v.x;
+          }
+          place_rank(r, wanted);
+        }
+      }
+
+      /** writes the positions of the nodes and the curves of the edges
+       *  @param graph the graph
+       */
+      void route(Graph &graph) {
+        // the rank boxes form a column left of all ranks
+        double left = HUGE_VAL, box_width = 0;
+        for(int r = 0; r < KIDGraph::LEVELS; r++) {
+          if(!ranks[r].empty())
+            left = std::min(left, vnodes[ranks[r][0]].x - vnodes[ranks[r][0]].width/2);
+          if(boxes[r] >= 0)
+            box_width = std::max(box_width, vnodes[boxes[r]].width);
+        }
+        if(left == HUGE_VAL)
+          left = 0;
+        // an incremental layout only moves the drawing if it grew to the left
+        double shift = MARGIN + box_width + NODESEP - left;
+        if(incremental)
+          shift = std::max(shift, 0.0);
+        double right = MARGIN + box_width;
+
+        for(size_t i = 0; i < vnodes.size(); i++) {
+          VNode &v = vnodes[i];
+          if(v.real >= 0 && graph.nodes[v.real].rank_box)
+            v.x = MARGIN + box_width/2;
+          else
+            v.x += shift;
+          if(v.real >= 0) {
+            Node &node = graph.nodes[v.real];
+            node.x = v.x;
+            node.y = rank_y(v.rank);
+            right = std::max(right, v.x + v.width/2);
+          }
+        }
+        graph.width = right + MARGIN;
+        graph.height = 2*MARGIN + KIDGraph::LEVELS*RANK_HEIGHT + (KIDGraph::LEVELS-1)*RANKSEP;
+
+        for(size_t e = 0; e < graph.edges.size(); e++) {
+          Edge &edge = graph.edges[e];
+          edge.px.clear();
+          edge.py.clear();
+          if(edge.from < 0 || edge.to < 0)
+            continue;
+
+          const std::vector<int> &chain = chains[e];
+          if(chain.empty()) {
+            route_flat(graph, edge);
+            continue;
+          }
+
+          edge.arrow_at_start = chain.front() == edge.to;
+          for(size_t i = 0; i+1 < chain.size(); i++) {
+            double x0, y0, x1, y1;
+            port(graph, chain[i], chain[i+1], x0, y0);
+            port(graph, chain[i+1], chain[i], x1, y1);
+            double dy = (y1 - y0) * 0.4;
+            if(i == 0) {
+              edge.px.push_back(x0);
+              edge.py.push_back(y0);
+            }
+            edge.px.push_back(x0);
+            edge.py.push_back(y0 + dy);
+            edge.px.push_back(x1);
+            edge.py.push_back(y1 - dy);
+            edge.px.push_back(x1);
+            edge.py.push_back(y1);
+          }
+
+          // the label sits at the middle of the middle segment
+          size_t s = (edge.px.size()-1) / 3 / 2 * 3;
+          edge.label_x = (edge.px[s] + 3*edge.px[s+1] + 3*edge.px[s+2] + edge.px[s+3]) / 8;
+          edge.label_y = (edge.py[s] + 3*edge.py[s+1] + 3*edge.py[s+2] + edge.py[s+3]) / 8;
+        }
+
+        // arcs of flat edges may leave the ranks, the drawing is moved to include them
+        double top = MARGIN, bottom = graph.height - MARGIN;
+        for(size_t e = 0; e < graph.edges.size(); e++) {
+          const Edge &edge = graph.edges[e];
+          for(size_t i = 0; i < edge.py.size(); i++) {
+            top = std::min(top, edge.py[i]);
+            bottom = std::max(bottom, edge.py[i]);
+          }
+        }
+        double dy = MARGIN - top;
+        graph.height = bottom + dy + MARGIN;
+        if(dy > 0) {
+          for(size_t i = 0; i < graph.nodes.size(); i++)
+            graph.nodes[i].y += dy;
+          for(size_t e = 0; e < graph.edges.size(); e++) {
+            Edge &edge = graph.edges[e];
+            for(size_t i = 0; i < edge.py.size(); i++)
+              edge.py[i] += dy;
+            edge.label_y += dy;
+          }
+        }
+      }
+
+      /** routes an edge inside a rank as an arc above the rank
+       *  @param graph the graph
+       *  @param edge the edge
+       */
+      void route_flat(const Graph &graph, Edge &edge) const {
+        const Node &a = graph.nodes[edge.from];
+        const Node &b = graph.nodes[edge.to];
+        double top = a.y - a.height/2;
+        double lift = 20 + std::min(std::fabs(b.x - a.x) * 0.15, RANKSEP / 2.0);
+        if(edge.from == edge.to) {
+          double x = a.x + a.width/2;
+          double px[] = { x - 4, x + 30, x + 30, x - 4 };
+          double py[] = { a.y - 8, a.y - 30, a.y + 30, a.y + 8 };
+          edge.px.assign(px, px+4);
+          edge.py.assign(py, py+4);
+        }
+        else {
+          double px[] = { a.x, a.x, b.x, b.x };
+          double py[] = { top, top - lift, top - lift, top };
+          edge.px.assign(px, px+4);
+          edge.py.assign(py, py+4);
+        }
+        edge.arrow_at_start = false;
+        edge.label_x = (edge.px[0] + 3*edge.px[1] + 3*edge.px[2] + edge.px[3]) / 8;
+        edge.label_y = (edge.py[0] + 3*edge.py[1] + 3*edge.py[2] + edge.py[3]) / 8;
+      }
+
+      /** point where an edge leaves a node towards another one
+       *  real nodes are ellipses, dummies are points
+       *  @param graph the graph
+       *  @param v the node
+       *  @param towards the other end of the edge
+       *  @param x receives the x coordinate
+       *  @param y receives the y coordinate
+       */
+      void port(const Graph &graph, int v, int towards, double &x, double &y) const {
+        x = vnodes[v].x;
+        y = rank_y(vnodes[v].rank);
+        if(vnodes[v].real < 0)
+          return;
+
+        const Node &node = graph.nodes[vnodes[v].real];
+        double dx = vnodes[towards].x - x;
+        double dy = rank_y(vnodes[towards].rank) - y;
+        double a = node.width/2, b = node.height/2;
+        double t = 1.0 / std::sqrt((dx*dx)/(a*a) + (dy*dy)/(b*b));
+        x += dx*t;
+        y += dy*t;
+      }
+
+      /** key of a dummy node in the positions of the last layout
+       *  @param graph the graph
+       *  @param e index of the edge
+       *  @param i index of the dummy in the chain of the edge
+       *  @return the key, it cannot collide with node names
+       */
+      static std::string dummy_name(const Graph &graph, size_t e, size_t i) {
+        const Edge &edge = graph.edges[e];
+        std::string name(1, '\0');
+        name.append(graph.nodes[edge.from].name).append(1, '\0');
+        name.append(graph.nodes[edge.to].name).append(1, '\0');
+        name.append(edge.label).append(1, '\0');
+        name.append(1, (char)('0' + i));
+        return name;
+      }
+
+      /** vertical center of a rank
+       *  @param r the rank
+       *  @return the y coordinate
+       */
+      static double rank_y(int r) {
+        return MARGIN + RANK_HEIGHT/2.0 + r*(RANK_HEIGHT + RANKSEP);
+      }
+
+    private:
+      /** edge crossings of the last layout */
+      long                             current_crossings;
+      /** true while the running layout keeps the last positions */
+      bool                             incremental;
+      /** allowed crossings of an incremental layout relative to a full one */
+      double                           quality;
+      /** crossings per edge segment of the last full layout */
+      double                           full_ratio;
+      /** number of real nodes with a kept position */
+      int                              kept;
+      /** number of edge segments between the ranks */
+      long                             segments;
+      /** x coordinates of the last layout by node name */
+      std::map<std::string, double>    previous;
+      /** the nodes of the layered graph, the real nodes first */
+      std::vector<VNode>               vnodes;
+      /** order of the ranks without the rank boxes */
+      std::vector<int>                 ranks[KIDGraph::LEVELS];
+      /** rank box of each rank or -1 */
+      int                              boxes[KIDGraph::LEVELS];
+      /** virtual nodes of each edge from the upper to the lower end */
+      std::vector<std::vector<int> >   chains;
+  };
+}
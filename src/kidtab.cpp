@@ -1,8 +1,8 @@
 #include "kidtab.h"
 #include "converter.h"
 #include <fstream>
-#include <gazebo/common/Image.hh>
 #include <boost/filesystem/path.hpp>
+#include <boost/lexical_cast.hpp>
 
 using namespace SceneReconstruction;
 
@@ -17,6 +17,8 @@ KIDTab::KIDTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger, Glib::RefP
   node = _node;
   logger = _logger;  
   this->responseMutex = new boost::mutex();
+  next_document = 0;
+  doc = NULL;
 
   _builder->get_widget("kid_toolbutton_new", btn_new);
   btn_new->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_new_clicked));
@@ -26,10 +28,15 @@ KIDTab::KIDTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger, Glib::RefP
   btn_save->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_save_clicked));
   _builder->get_widget("kid_toolbutton_close", btn_close);
   btn_close->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_close_clicked));
+  _builder->get_widget("kid_toolbutton_undo", btn_undo);
+  btn_undo->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_undo_clicked));
+  _builder->get_widget("kid_toolbutton_redo", btn_redo);
+  btn_redo->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_redo_clicked));
   _builder->get_widget("kid_combobox_graphs", com_graphs);
   com_graphs->signal_changed().connect(sigc::mem_fun(*this,&KIDTab::on_graphs_changed));
   gra_store = Glib::RefPtr<Gtk::ListStore>::cast_dynamic(_builder->get_object("kid_liststore_graphs"));
   gra_store->clear();
+  thumbnailer.signal_ready.connect(sigc::mem_fun(*this,&KIDTab::on_thumbnails_ready));
 
   Gtk::Box *box_type;
   _builder->get_widget("kid_box_top_left", box_type);
@@ -91,12 +98,19 @@ KIDTab::KIDTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger, Glib::RefP
   btn_zoomreset->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_zoom_reset_clicked));
   _builder->get_widget("kid_toolbutton_export", btn_export);
   btn_export->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_export_clicked));
+  _builder->get_widget("kid_toolbutton_native", btn_native);
+  btn_native->signal_toggled().connect(sigc::mem_fun(*this,&KIDTab::on_native_toggled));
+  _builder->get_widget("kid_toolbutton_relayout", btn_relayout);
+  btn_relayout->signal_clicked().connect(sigc::mem_fun(*this,&KIDTab::on_relayout_clicked));
+  _builder->get_widget("kid_toolbutton_focus", btn_focus);
+  btn_focus->signal_toggled().connect(sigc::mem_fun(*this,&KIDTab::on_focus_toggled));
+  gda_graph->signal_layout_positions().connect(sigc::mem_fun(*this,&KIDTab::on_layout_positions));
 
   _builder->get_widget("kid_document_window", win_show);
   _builder->get_widget("kid_document_combobox", win_combo);
   win_combo->signal_changed().connect(sigc::mem_fun(*this,&KIDTab::on_document_changed));
   _builder->get_widget("kid_document_image", win_image);
-  missing_image = Gdk::Pixbuf::create_from_file("res/noimg.png");
+  ImageCache::shared().load_file("res/noimg.png");
   _builder->get_widget("kid_document_textview", win_textview);
   win_textbuffer = Glib::RefPtr<Gtk::TextBuffer>::cast_dynamic(_builder->get_object("kid_document_textbuffer"));
   win_store = Glib::RefPtr<Gtk::ListStore>::cast_dynamic(_builder->get_object("kid_document_liststore"));
@@ -110,10 +124,20 @@ KIDTab::KIDTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger, Glib::RefP
   filter_kgf = Gtk::FileFilter::create();
   filter_kgf->set_name("KID Graph File (KGF)");
   filter_kgf->add_pattern("*.kgf");
+  filter_kgb = Gtk::FileFilter::create();
+  filter_kgb->set_name("KID Graph Binary (KGB)");
+  filter_kgb->add_pattern("*.kgb");
+  filter_kid = Gtk::FileFilter::create();
+  filter_kid->set_name("KID Graphs (KGF, KGB)");
+  filter_kid->add_pattern("*.kgf");
+  filter_kid->add_pattern("*.kgb");
   fcd_save->add_filter(filter_kgf);
+  fcd_save->add_filter(filter_kgb);
   fcd_save->set_filter(filter_kgf);
+  fcd_open->add_filter(filter_kid);
   fcd_open->add_filter(filter_kgf);
-  fcd_open->set_filter(filter_kgf);
+  fcd_open->add_filter(filter_kgb);
+  fcd_open->set_filter(filter_kid);
 
   _builder->get_widget("kid_dialog_newgraph", dia_new);
   _builder->get_widget("kid_dialog_newgraph_entry", dia_new_entry);
@@ -125,9 +149,15 @@ KIDTab::KIDTab(gazebo::transport::NodePtr& _node, LoggerTab* _logger, Glib::RefP
 }
 
 KIDTab::~KIDTab() {
+  win_prefetch_idle.disconnect();
+  thumbnail_timer.disconnect();
+  std::map<int, GraphDocument*>::iterator iter;
+  for(iter = documents.begin(); iter != documents.end(); iter++)
+    delete iter->second;
 }
 
 void KIDTab::OnResponseMsg(ConstResponsePtr& _msg) {
+  // recorded by the FrameworkTab which is subscribed to the same topic
   {
     boost::mutex::scoped_lock lock(*this->responseMutex);
     this->responseMsgs.push_back(*_msg);
@@ -166,42 +196,23 @@ void KIDTab::ProcessResponseMsg() {
         gazebo::msgs::Message_V docs;
         if(_msg->has_type() && _msg->type() == docs.GetTypeName()) {
           docs.ParseFromString(_msg->serialized_data());
-          gazebo::msgs::SceneDocument doc;
-          if(docs.msgtype() == doc.GetTypeName()) {
+          gazebo::msgs::SceneDocument scene_doc;
+          if(docs.msgtype() == scene_doc.GetTypeName()) {
             int n = docs.msgsdata_size();
-            
+            logger->log("kid", "indexing %d documents for selected node: %s", n, docreq->data().c_str());
+
+            // only the timestamps are read here, the documents are decoded when they are shown
             for(int i=0; i<n; i++) {
-              logger->log("kid", "processing document for selected node: "+docreq->data());
-              doc.ParseFromString(docs.msgsdata(i));
-              Gtk::TreeModel::Row row;
-              row = *(win_store->append());
-              row.set_value(0, "Time: "+Converter::to_ustring_time(doc.timestamp()));
-              Glib::RefPtr<Gdk::Pixbuf> img;
-              if(doc.has_image()) {
-                gazebo::common::Image tmpimg;
-                gazebo::msgs::Set(tmpimg, doc.image());
-                tmpimg.SavePNG("tmp_img.png");
-                img = Gdk::Pixbuf::create_from_file("tmp_img.png");
-              }
-              else {
-                img = missing_image;
-              }
-
-              gazebo::msgs::Drawing pcl;
-              if(doc.has_pointcloud()) {
-                pcl.CopyFrom(doc.pointcloud());
-              }
-              else {
-                pcl.set_name("pointcloud");
-                pcl.set_visible(false);
-              }
-              
-              row.set_value(1, i);
-              win_images[i] = img;
-              win_pointclouds[i] = pcl;
-              row.set_value(2, doc.document());
+              int id = win_documents.add(*docs.mutable_msgsdata(i));
+              int next = win_documents.next(id);
+              Gtk::TreeModel::iterator iter = (next == -1 ? win_store->append() : win_store->insert(win_rows[next]));
+              win_rows[id] = iter;
+              Gtk::TreeModel::Row row = *iter;
+              row.set_value(0, "Time: "+Converter::to_ustring_time(win_documents.timestamp(id)));
+              row.set_value(1, id);
             }
-            win_combo->set_active(win_store->children().begin());
+            if(win_combo->get_active_row_number() == -1)
+              win_combo->set_active(win_store->children().begin());
           }
         }
       }
@@ -211,9 +222,23 @@ void KIDTab::ProcessResponseMsg() {
 }
 
 void KIDTab::create_graphviz_dot() {
-  std::string dot = graph.get_dot();
-  gda_graph->set_graph(dot);
-  gda_graph->zoom_fit();  
+  KIDGraph &graph = (doc ? doc->graph : empty_graph);
+  // the focus view only contains the shown part of the graph
+  std::vector<bool> visible;
+  bool focus = doc && doc->focus.is_active();
+  if(focus)
+    doc->focus.get_visible(graph, visible);
+
+  if(btn_native->get_active()) {
+    KIDLayout::Graph kid;
+    KIDLayout::snapshot(graph, kid, focus ? &visible : NULL);
+    gda_graph->set_graph(focus ? graph.get_dot(visible) : graph.get_dot(), kid);
+  }
+  else
+    gda_graph->set_graph(focus ? graph.get_dot(visible) : graph.get_dot());
+
+  if(doc)
+    update_thumbnail(doc);
 }
 
 void KIDTab::on_type_changed() {
@@ -236,18 +261,14 @@ void KIDTab::on_type_changed() {
     com_left->remove_all();
     com_right->remove_all();
     ent_label->set_sensitive(true);
-    std::list<KIDGraph::KIDNode>::iterator iter;
-    for(iter = graph.knowledge_nodes.begin(); iter != graph.knowledge_nodes.end(); iter++) {
-      com_left->append(iter->node);
-      com_right->append(iter->node);
-    }
-    for(iter = graph.information_nodes.begin(); iter != graph.information_nodes.end(); iter++) {
-      com_left->append(iter->node);
-      com_right->append(iter->node);
-    }
-    for(iter = graph.data_nodes.begin(); iter != graph.data_nodes.end(); iter++) {
-      com_left->append(iter->node);
-      com_right->append(iter->node);
+    const KIDGraph &graph = (doc ? doc->graph : empty_graph);
+    for(int l = 0; l < KIDGraph::LEVELS; l++) {
+      const std::vector<int> &ids = graph.level_nodes((KIDGraph::Level)l);
+      std::vector<int>::const_iterator iter;
+      for(iter = ids.begin(); iter != ids.end(); iter++) {
+        com_left->append(graph.get_node(*iter).node);
+        com_right->append(graph.get_node(*iter).node);
+      }
     }
     
     com_left->get_entry()->set_editable(true);
@@ -255,41 +276,35 @@ void KIDTab::on_type_changed() {
 }
 
 void KIDTab::on_add_clicked() {
+  if(!doc) {
+    logger->log("kid", "no graph open");
+    return;
+  }
+
   if(com_type->get_active_text() == "Node") {
-    if(!graph.is_node(com_right->get_entry_text())) {
-      if(com_left->get_active_text() == "Knowledge") {
-        logger->log("kid", "knowledge node \""+com_right->get_entry_text()+"\" added");
-        KIDGraph::KIDNode node;
-        node.node = com_right->get_entry_text();
-        graph.knowledge_nodes.push_back(node);
-        Gtk::TreeModel::Row row;
-        row = *(nds_store->append());
-        row.set_value(0, com_right->get_entry_text());
-      }
-      else if(com_left->get_active_text() == "Information") {
-        logger->log("kid", "information node \""+com_right->get_entry_text()+"\" added");
-        KIDGraph::KIDNode node;
-        node.node = com_right->get_entry_text();
-        graph.information_nodes.push_back(node);
-        Gtk::TreeModel::Row row;
-        row = *(nds_store->append());
-        row.set_value(0, com_right->get_entry_text());
-      }
-      else if(com_left->get_active_text() == "Data") {
-        logger->log("kid", "data node \""+com_right->get_entry_text()+"\" added");
-        KIDGraph::KIDNode node;
-        node.node = com_right->get_entry_text();
-        graph.data_nodes.push_back(node);
-        Gtk::TreeModel::Row row;
-        row = *(nds_store->append());
-        row.set_value(0, com_right->get_entry_text());
-      }
+    if(!doc->graph.is_node(com_right->get_entry_text())) {
+      KIDGraph::Level level;
+      if(com_left->get_active_text() == "Knowledge")
+        level = KIDGraph::KNOWLEDGE;
+      else if(com_left->get_active_text() == "Information")
+        level = KIDGraph::INFORMATION;
+      else if(com_left->get_active_text() == "Data")
+        level = KIDGraph::DATA;
       else {
         logger->log("kid", "level \""+com_left->get_entry_text()+"\" not known");
+        return;
       }
+
+      logger->log("kid", KIDGraph::level_name(level)+" node \""+com_right->get_entry_text()+"\" added");
+      doc->journal.add_node(com_right->get_entry_text(), level);
+      doc->focus.show(com_right->get_entry_text());
+      Gtk::TreeModel::Row row;
+      row = *(doc->nodes->append());
+      row.set_value(0, com_right->get_entry_text());
     }
     else {
-      logger->log("kid", "node \""+com_right->get_entry_text()+"\" already exists at level "+graph.level_of_node(com_right->get_entry_text()));
+      logger->log("kid", "node \""+com_right->get_entry_text()+"\" already exists at level "+doc->graph.level_of_node(com_right->get_entry_text()));
+      return;
     }
   }
   else if(com_type->get_active_text() == "Edge") {
@@ -297,148 +312,97 @@ void KIDTab::on_add_clicked() {
     edge.from = com_left->get_entry_text();
     edge.to = com_right->get_entry_text();
     edge.label = ent_label->get_text();
-    if(!graph.is_edge(edge) && graph.is_node(edge.from) && graph.is_node(edge.to)) {
+    if(!doc->graph.is_edge(edge) && doc->graph.is_node(edge.from) && doc->graph.is_node(edge.to)) {
       logger->log("kid", "edge "+edge.toString()+" added");
-      graph.edges.push_back(edge);
-      KIDGraph::KIDNode *from = graph.get_node(edge.from);
-      KIDGraph::KIDNode *to   = graph.get_node(edge.to);
-      from->children.push_back(to);
-      to->parents.push_back(from);
+      doc->journal.add_edge(edge);
+      doc->focus.show(edge.from);
+      doc->focus.show(edge.to);
       Gtk::TreeModel::Row row;
-      row = *(edg_store->append());
+      row = *(doc->edges->append());
       row.set_value(0, edge.toString());
     }
     else {
       std::string error = "edge not added";
-      if(graph.is_edge(edge))
+      if(doc->graph.is_edge(edge))
         error += ", edge already exists";
-      if(!graph.is_node(com_left->get_entry_text()))
+      if(!doc->graph.is_node(com_left->get_entry_text()))
         error += ", node \""+com_left->get_entry_text()+"\" is not known";
-      if(!graph.is_node(com_right->get_entry_text()))
+      if(!doc->graph.is_node(com_right->get_entry_text()))
         error += ", node \""+com_right->get_entry_text()+"\" is not known";
 
       logger->log("kid", error);
+      return;
     }
   }
 
-  com_graphs->get_active()->set_value(1,graph.save_to_string());
-
+  update_history();
   create_graphviz_dot();
 }
 
 void KIDTab::on_nodes_remove_clicked() {
-  if(trv_nodes->get_selection()->count_selected_rows() == 1){
+  if(doc && trv_nodes->get_selection()->count_selected_rows() == 1){
     Glib::ustring node;
     trv_nodes->get_selection()->get_selected()->get_value(0, node);
-    nds_store->erase(trv_nodes->get_selection()->get_selected());
     logger->log("kid", "removed node: "+node);
-    if(graph.level_of_node(node) == "knowledge") {
-      std::list<KIDGraph::KIDNode>::iterator iter;
-      iter = find(graph.knowledge_nodes.begin(), graph.knowledge_nodes.end(), (std::string)node);
-      if(iter != graph.knowledge_nodes.end()) {
-        std::list<KIDGraph::KIDNode*>::iterator subiter;
-        KIDGraph::KIDNode *p;
-        p = graph.get_node(node);
-        for(subiter = iter->children.begin(); subiter != iter->children.end(); subiter++) {
-          (*subiter)->parents.remove(p);
-        }
-        for(subiter = iter->parents.begin(); subiter != iter->parents.end(); subiter++) {
-          (*subiter)->children.remove(p);
-        }
-
-        graph.knowledge_nodes.erase(iter);
-      }
-    }
-    else if(graph.level_of_node(node) == "information") {
-      std::list<KIDGraph::KIDNode>::iterator iter;
-      iter = find(graph.information_nodes.begin(), graph.information_nodes.end(), (std::string)node);
-      if(iter != graph.information_nodes.end()) {
-        std::list<KIDGraph::KIDNode*>::iterator subiter;
-        KIDGraph::KIDNode *p;
-        p = graph.get_node(node);
-        for(subiter = iter->children.begin(); subiter != iter->children.end(); subiter++) {
-          (*subiter)->parents.remove(p);
-        }
-        for(subiter = iter->parents.begin(); subiter != iter->parents.end(); subiter++) {
-          (*subiter)->children.remove(p);
-        }
-
-        graph.information_nodes.erase(iter);
-      }
-    }
-    else if(graph.level_of_node(node) == "data") {
-      std::list<KIDGraph::KIDNode>::iterator iter;
-      iter = find(graph.data_nodes.begin(), graph.data_nodes.end(), (std::string)node);
-      if(iter != graph.data_nodes.end()) {
-        std::list<KIDGraph::KIDNode*>::iterator subiter;
-        KIDGraph::KIDNode *p;
-        p = graph.get_node(node);
-        for(subiter = iter->children.begin(); subiter != iter->children.end(); subiter++) {
-          (*subiter)->parents.remove(p);
-        }
-        for(subiter = iter->parents.begin(); subiter != iter->parents.end(); subiter++) {
-          (*subiter)->children.remove(p);
-        }
-
-        graph.data_nodes.erase(iter);
-      }
-    }
 
-    // remove edges that are no longer valid
-    std::list<KIDGraph::KIDEdge>::iterator edgeiter;
-    std::list<KIDGraph::KIDEdge> newedges;
-    edg_store->clear();
-    Gtk::TreeModel::Row row;
-    for(edgeiter = graph.edges.begin(); edgeiter != graph.edges.end(); edgeiter++) {
-      if(!(edgeiter->from == node || edgeiter->to == node)) {
-        row = *(edg_store->append());
-        row.set_value(0, edgeiter->toString());
-        newedges.push_back(*edgeiter);
-      }
-    }
-    graph.edges = newedges;
+    // the rows of the edges follow the edge order, remove the node's edges back to front
+    int id = doc->graph.node_id(node);
+    std::vector<int> positions;
+    for(size_t i = 0; id >= 0 && i < doc->graph.get_edges().size(); i++)
+      if(doc->graph.get_edges()[i].from_id == id || doc->graph.get_edges()[i].to_id == id)
+        positions.push_back(i);
+    std::vector<int>::reverse_iterator riter;
+    for(riter = positions.rbegin(); riter != positions.rend(); riter++)
+      doc->edges->erase(doc->edges->children()[*riter]);
+
+    doc->nodes->erase(trv_nodes->get_selection()->get_selected());
+    doc->journal.remove_node(node);
+
+    update_history();
+    create_graphviz_dot();
   }
-
-  com_graphs->get_active()->set_value(1,graph.save_to_string());
-
-  create_graphviz_dot();
 }
 
 void KIDTab::on_unmark_clicked() {
-  graph.clear_markup();
-  com_graphs->get_active()->set_value(1,graph.save_to_string());
-  create_graphviz_dot();
-  logger->log("kid", "unmarked graph");
+  if(doc && doc->journal.clear_markup()) {
+    update_history();
+    create_graphviz_dot();
+    logger->log("kid", "unmarked graph");
+  }
 }
 
 void KIDTab::on_edges_remove_clicked() {
-  if(trv_edges->get_selection()->count_selected_rows() == 1) {
-    Glib::ustring edge;
-    trv_edges->get_selection()->get_selected()->get_value(0, edge);
-    edg_store->erase(trv_edges->get_selection()->get_selected());
-    logger->log("kid", "removed edge: "+edge);
-    std::list<KIDGraph::KIDEdge>::iterator iter;
-    iter = find(graph.edges.begin(), graph.edges.end(), (std::string)edge);
-    
-    if(iter != graph.edges.end()) {
-      KIDGraph::KIDNode *from;
-      KIDGraph::KIDNode *to;
-      from = graph.get_node(iter->from);
-      from->parents.remove(to);
-      to   = graph.get_node(iter->to);
-      to->children.remove(from);
-      graph.edges.erase(iter);
-    }
+  if(doc && trv_edges->get_selection()->count_selected_rows() == 1) {
+    // the rows of the edges follow the edge order, so the row is the position of the edge
+    Gtk::TreeModel::iterator row = trv_edges->get_selection()->get_selected();
+    int pos = doc->edges->get_path(row)[0];
+    const std::vector<KIDGraph::KIDEdge> &edges = doc->graph.get_edges();
+    if(pos < 0 || pos >= (int)edges.size())
+      return;
+
+    KIDGraph::KIDEdge e = edges[pos];
+    logger->log("kid", "removed edge: "+e.toString());
+    doc->journal.remove_edge(e);
+
+    // the last edge took the position of the removed one
+    if(pos < (int)edges.size())
+      (*row).set_value(0, edges[pos].toString());
+    doc->edges->erase(doc->edges->children()[edges.size()]);
+
+    update_history();
+    create_graphviz_dot();
   }
-
-  com_graphs->get_active()->set_value(1,graph.save_to_string());
-
-  create_graphviz_dot();
 }
 
 bool KIDTab::on_graph_release(GdkEventButton *b) {
   std::string node = gda_graph->get_clicked_node(b->x, b->y);
-  if(graph.is_node(node)) {
+  KIDGraph::Level level;
+  if(doc && doc->focus.is_active() && b->button == 1 && doc->graph.is_summary(node, level)) {
+    int shown = doc->focus.expand(doc->graph, level);
+    logger->log("kid", "expanded %s by %d nodes", KIDGraph::level_name(level).c_str(), shown);
+    create_graphviz_dot();
+  }
+  else if(doc && doc->graph.is_node(node)) {
     if(b->button == 1) {
       if(find(db_collections.begin(), db_collections.end(), node) != db_collections.end()) {
         if(!win_show->get_visible()) {
@@ -449,8 +413,11 @@ bool KIDTab::on_graph_release(GdkEventButton *b) {
           logger->log("kid", "refreshing document window for node: "+node);
 
         // clear previous data
+        win_prefetch_idle.disconnect();
+        win_prefetch.clear();
         win_store->clear();
-        win_images.clear();
+        win_rows.clear();
+        win_documents.clear();
 
         // get new data from framework for selected collection node
         docreq = gazebo::msgs::CreateRequest("documents", node);
@@ -461,18 +428,16 @@ bool KIDTab::on_graph_release(GdkEventButton *b) {
         logger->log("kid", "node: "+node+" does not refer to a collection");
     }
     else if(b->button == 3) {
-      if(graph.is_marked(node)) {
+      if(doc->graph.is_marked(node)) {
         logger->log("kid", "unmark node: "+node);
-        graph.unmark_node(node);
-        com_graphs->get_active()->set_value(1,graph.save_to_string());
-        create_graphviz_dot();
+        doc->journal.unmark_node(node);
       }
       else {
         logger->log("kid", "mark node: "+node);
-        graph.mark_node(node);
-        com_graphs->get_active()->set_value(1,graph.save_to_string());
-        create_graphviz_dot();
+        doc->journal.mark_node(node);
       }
+      update_history();
+      create_graphviz_dot();
     }
   }
 
@@ -483,13 +448,34 @@ void KIDTab::on_document_changed() {
   // set textbuffer and image according to selection
   // send pointcloud to gazebo or remove currently shown one
   int id;
+  gazebo::msgs::SceneDocument scene_doc;
   if(win_combo->get_active_row_number() != -1) {
     win_combo->get_active()->get_value(1,id);
-    win_image->set(win_images[id]);
-    pclPub->Publish(win_pointclouds[id]);
-    Glib::ustring doc;
-    win_combo->get_active()->get_value(2,doc);
-    win_textbuffer->set_text(Converter::parse_json(doc));
+    if(!win_documents.decode(id, scene_doc))
+      logger->log("kid", "could not decode document for selected node: "+docreq->data());
+    Glib::RefPtr<Gdk::Pixbuf> img = ImageCache::shared().get(document_image(id, scene_doc));
+    win_image->set(img ? img : ImageCache::shared().load_file("res/noimg.png"));
+    gazebo::msgs::Drawing pcl;
+    if(scene_doc.has_pointcloud()) {
+      pcl.Swap(scene_doc.mutable_pointcloud());
+    }
+    else {
+      pcl.set_name("pointcloud");
+      pcl.set_visible(false);
+    }
+    pclPub->Publish(pcl);
+    win_textbuffer->set_text(Converter::parse_json(scene_doc.document()));
+
+    // the neighbours are likely shown next, so their images are converted while idle
+    win_prefetch.clear();
+    int next = win_documents.next(id);
+    int previous = win_documents.previous(id);
+    if(next != -1)
+      win_prefetch.push_back(next);
+    if(previous != -1)
+      win_prefetch.push_back(previous);
+    if(!win_prefetch.empty() && !win_prefetch_idle.connected())
+      win_prefetch_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &KIDTab::on_document_prefetch));
   }
   else {
     win_image->set(Gtk::Stock::MISSING_IMAGE, Gtk::ICON_SIZE_BUTTON);
@@ -501,6 +487,31 @@ void KIDTab::on_document_changed() {
   }
 }
 
+std::string KIDTab::document_image(int id, gazebo::msgs::SceneDocument &scene_doc) {
+  // documents shown again are not converted again, the ids of win_documents
+  // start over for each request, documents may share their timestamps
+  if(!scene_doc.has_image())
+    return ImageCache::file_key("res/noimg.png");
+  std::string key = "kid/"+docreq->data()+"/"+boost::lexical_cast<std::string>(docreq->id())+"/"+boost::lexical_cast<std::string>(id);
+  if(!ImageCache::shared().contains(key))
+    ImageCache::shared().put(key, Converter::to_pixbuf(*scene_doc.mutable_image()));
+  if(!ImageCache::shared().contains(key))
+    return ImageCache::file_key("res/noimg.png");
+  return key;
+}
+
+bool KIDTab::on_document_prefetch() {
+  // one document per call keeps the GUI responsive
+  if(win_prefetch.empty())
+    return false;
+  int id = win_prefetch.front();
+  win_prefetch.pop_front();
+  gazebo::msgs::SceneDocument scene_doc;
+  if(id < win_documents.size() && win_documents.decode(id, scene_doc))
+    document_image(id, scene_doc);
+  return !win_prefetch.empty();
+}
+
 void KIDTab::on_new_clicked() {
   // create new graph inside combobox
   Gtk::Window *w;
@@ -510,7 +521,6 @@ void KIDTab::on_new_clicked() {
   int result = dia_new->run();
   if (result == Gtk::RESPONSE_OK) {
     std::string __name = dia_new_entry->get_text();
-    std::string __graph = __name+"\n";
     bool validname = true;
     Gtk::TreeModel::Children tmc = gra_store->children();
     Gtk::TreeModel::iterator tmi = tmc.begin();
@@ -523,10 +533,12 @@ void KIDTab::on_new_clicked() {
       tmi++;
     }
     if(validname) {
+      GraphDocument *__doc = new GraphDocument();
+      __doc->graph.name = __name;
       Gtk::TreeModel::Row row;
       row = *(gra_store->append());
       row.set_value(0, __name);
-      row.set_value(1, __graph);
+      row.set_value(1, open_document(__doc));
       com_graphs->set_active(row);
     }
     else {
@@ -542,7 +554,7 @@ void KIDTab::on_new_clicked() {
 }
 
 void KIDTab::on_load_clicked() {
-  // load existing graph file into combobox (.kgf)
+  // load existing graph file into combobox (.kgf or .kgb)
   Gtk::Window *w;
   _builder->get_widget("window", w);
   
@@ -551,25 +563,28 @@ void KIDTab::on_load_clicked() {
   int result = fcd_open->run();
   if (result == Gtk::RESPONSE_OK) {
     std::string filename = fcd_open->get_filename();
-    std::string __graph = "";
-    if (filename != "") {      
-      FILE *f = fopen(filename.c_str(), "r");
-      while (! feof(f)) {
-        char tmp[4096];
-        size_t s;
-        if ((s = fread(tmp, 1, 4096, f)) > 0) {
-         	__graph.append(tmp, s);
-        }
+    if (filename != "") {
+      GraphDocument *__doc = new GraphDocument();
+      std::string error;
+      if(!__doc->graph.load_file(filename, &error)) {
+        delete __doc;
+        logger->log("kid", "could not load "+filename+", "+error);
+        Gtk::MessageDialog md(*w, "Could not load graph",
+			      /* markup */ false, Gtk::MESSAGE_ERROR,
+			      Gtk::BUTTONS_OK, /* modal */ true);
+        md.set_secondary_text(error);
+        md.set_title("Invalid Graph File");
+        md.run();
+        fcd_open->hide();
+        return;
       }
-      fclose(f);
-
-      size_t pos = __graph.find("\n");
-      std::string __name = __graph.substr(0, pos);
+      if(!error.empty())
+        logger->log("kid", "loaded "+filename+", "+error);
 
       Gtk::TreeModel::Row row;
       row = *(gra_store->append());
-      row.set_value(0, __name);
-      row.set_value(1, __graph);
+      row.set_value(0, __doc->graph.name);
+      row.set_value(1, open_document(__doc));
       com_graphs->set_active(row);
     } else {
       Gtk::MessageDialog md(*w, "Invalid filename",
@@ -584,14 +599,14 @@ void KIDTab::on_load_clicked() {
 }
 
 void KIDTab::on_save_clicked() {
-  // save selected graph to file (.kgf)
+  // save selected graph to file (.kgf or .kgb)
   Gtk::Window *w;
   _builder->get_widget("window", w);
   
   fcd_save->set_transient_for(*w);
 
   int result = fcd_save->run();
-  if (result == Gtk::RESPONSE_OK) {
+  if (result == Gtk::RESPONSE_OK && doc) {
 
     std::string filename = fcd_save->get_filename();
     if (filename != "") {
@@ -601,10 +616,21 @@ void KIDTab::on_save_clicked() {
         extension = filename.substr(ext_pos+1);
         std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
       }
-      if(extension != "kgf")
-        filename += ".kgf";
+      if(extension != "kgf" && extension != "kgb") {
+        extension = (fcd_save->get_filter() == filter_kgb ? "kgb" : "kgf");
+        filename += "."+extension;
+      }
 
-     	graph.save(filename.c_str());
+      // both formats keep the marks, so the saved file is the whole state
+      bool saved;
+      if(extension == "kgb")
+        saved = doc->graph.save_binary(filename);
+      else
+        saved = doc->graph.save(filename, true);
+      if(!saved)
+        logger->log("kid", "could not save "+filename);
+      else
+        doc->journal.set_saved();
     } else {
       Gtk::MessageDialog md(*w, "Invalid filename",
 			    /* markup */ false, Gtk::MESSAGE_ERROR,
@@ -619,7 +645,27 @@ void KIDTab::on_save_clicked() {
 
 void KIDTab::on_close_clicked() {
   // remove selected graph from combobox
+  if(!doc)
+    return;
+
+  // unsaved edits are only dropped on request
+  if(doc->journal.modified()) {
+    Gtk::Window *w;
+    _builder->get_widget("window", w);
+    Gtk::MessageDialog md(*w, "Close graph without saving?",
+			  /* markup */ false, Gtk::MESSAGE_QUESTION,
+			  Gtk::BUTTONS_OK_CANCEL, /* modal */ true);
+    md.set_secondary_text("The graph \""+doc->graph.name+"\" has unsaved changes, they are lost when it is closed.");
+    md.set_title("Unsaved Graph");
+    if(md.run() != Gtk::RESPONSE_OK)
+      return;
+    logger->log("kid", "closing graph with unsaved changes: "+doc->graph.name);
+  }
+
+  GraphDocument *olddoc = doc;
+  int oldid;
   Gtk::TreeModel::iterator oldgraph = com_graphs->get_active();
+  oldgraph->get_value(1, oldid);
   Gtk::TreeModel::iterator newgraph = com_graphs->get_active();
   newgraph++;
   if(newgraph == gra_store->children().end())
@@ -632,44 +678,158 @@ void KIDTab::on_close_clicked() {
     com_graphs->set_active(newgraph);
     gra_store->erase(oldgraph);
   }
+
+  thumbnailer.cancel(oldid);
+  documents.erase(oldid);
+  delete olddoc;
 }
 
-void KIDTab::on_graphs_changed() {
-  if(gra_store->children().size() == 0) {
-    graph.load("");
-    nds_store->clear();
-    edg_store->clear();
+void KIDTab::on_undo_clicked() {
+  if(doc && doc->journal.can_undo()) {
+    logger->log("kid", "undo "+doc->journal.undo_description());
+    doc->journal.undo();
+    fill_lists(doc);
+    update_history();
+    create_graphviz_dot();
   }
-  else {
-    Glib::ustring g;
-    com_graphs->get_active()->get_value(1,g);
-    graph.load(g);
-
-    nds_store->clear();
-    std::list<KIDGraph::KIDNode>::iterator iter;
-    Gtk::TreeModel::Row row;
-    for(iter = graph.knowledge_nodes.begin(); iter != graph.knowledge_nodes.end(); iter++) {
-      row = *(nds_store->append());
-      row.set_value(0, iter->node);
+}
+
+void KIDTab::on_redo_clicked() {
+  if(doc && doc->journal.can_redo()) {
+    logger->log("kid", "redo "+doc->journal.redo_description());
+    doc->journal.redo();
+    fill_lists(doc);
+    update_history();
+    create_graphviz_dot();
+  }
+}
+
+int KIDTab::open_document(GraphDocument *__doc) {
+  __doc->graph.set_reachability_index(true);
+  __doc->journal.clear();
+  __doc->nodes = Gtk::ListStore::create(text_columns);
+  __doc->edges = Gtk::ListStore::create(text_columns);
+  fill_lists(__doc);
+
+  int id = next_document++;
+  __doc->id = id;
+  documents[id] = __doc;
+  return id;
+}
+
+void KIDTab::fill_lists(GraphDocument *__doc) {
+  // the node rows follow the levels, the edge rows the edge order
+  __doc->nodes->clear();
+  Gtk::TreeModel::Row row;
+  for(int l = 0; l < KIDGraph::LEVELS; l++) {
+    const std::vector<int> &ids = __doc->graph.level_nodes((KIDGraph::Level)l);
+    std::vector<int>::const_iterator iter;
+    for(iter = ids.begin(); iter != ids.end(); iter++) {
+      row = *(__doc->nodes->append());
+      row.set_value(0, __doc->graph.get_node(*iter).node);
     }
-    for(iter = graph.information_nodes.begin(); iter != graph.information_nodes.end(); iter++) {
-      row = *(nds_store->append());
-      row.set_value(0, iter->node);
+  }
+
+  __doc->edges->clear();
+  std::vector<KIDGraph::KIDEdge>::const_iterator eiter;
+  for(eiter = __doc->graph.get_edges().begin(); eiter != __doc->graph.get_edges().end(); eiter++) {
+    row = *(__doc->edges->append());
+    row.set_value(0, eiter->toString());
+  }
+}
+
+void KIDTab::update_history() {
+  btn_undo->set_sensitive(doc && doc->journal.can_undo());
+  btn_redo->set_sensitive(doc && doc->journal.can_redo());
+  btn_undo->set_tooltip_text(doc && doc->journal.can_undo() ? "Undo "+doc->journal.undo_description() : "Undo");
+  btn_redo->set_tooltip_text(doc && doc->journal.can_redo() ? "Redo "+doc->journal.redo_description() : "Redo");
+}
+
+void KIDTab::update_thumbnail(GraphDocument *__doc) {
+  // the snapshot is taken when the edits pause
+  if(__doc->revision_key() == __doc->thumbnail_key)
+    return;
+  thumbnail_pending.insert(__doc->id);
+  thumbnail_timer.disconnect();
+  thumbnail_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &KIDTab::on_thumbnail_timeout), 300);
+}
+
+bool KIDTab::on_thumbnail_timeout() {
+  std::set<int>::iterator iter;
+  for(iter = thumbnail_pending.begin(); iter != thumbnail_pending.end(); iter++) {
+    std::map<int, GraphDocument*>::iterator diter = documents.find(*iter);
+    if(diter == documents.end())
+      continue;
+    GraphDocument *__doc = diter->second;
+    // the thumbnail always shows the whole graph, unchanged graphs keep theirs
+    unsigned long long key = __doc->revision_key();
+    if(key == __doc->thumbnail_key)
+      continue;
+    __doc->thumbnail_key = key;
+
+    Glib::RefPtr<Gdk::Pixbuf> thumbnail = thumbnailer.lookup(key);
+    if(thumbnail) {
+      set_thumbnail(__doc->id, thumbnail);
     }
-    for(iter = graph.data_nodes.begin(); iter != graph.data_nodes.end(); iter++) {
-      row = *(nds_store->append());
-      row.set_value(0, iter->node);
+    else {
+      // the old thumbnail is shown until the new one is drawn
+      KIDLayout::Graph kid;
+      KIDLayout::snapshot(__doc->graph, kid);
+      thumbnailer.request(__doc->id, key, kid);
     }
+  }
+  thumbnail_pending.clear();
+  return false;
+}
 
-    edg_store->clear();
-    std::list<KIDGraph::KIDEdge>::iterator eiter;
-    for(eiter = graph.edges.begin(); eiter != graph.edges.end(); eiter++) {
-      row = *(edg_store->append());
-      row.set_value(0, eiter->toString());
+void KIDTab::set_thumbnail(int id, const Glib::RefPtr<Gdk::Pixbuf> &thumbnail) {
+  Gtk::TreeModel::Children tmc = gra_store->children();
+  for(Gtk::TreeModel::iterator tmi = tmc.begin(); tmi != tmc.end(); tmi++) {
+    int row_id;
+    tmi->get_value(1, row_id);
+    if(row_id == id) {
+      tmi->set_value(2, thumbnail);
+      return;
     }
   }
+}
+
+void KIDTab::on_thumbnails_ready() {
+  int id;
+  unsigned long long key;
+  Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+  while(thumbnailer.take(id, key, thumbnail)) {
+    // a thumbnail of an older state of the graph is only cached
+    std::map<int, GraphDocument*>::iterator iter = documents.find(id);
+    if(iter != documents.end() && iter->second->thumbnail_key == key)
+      set_thumbnail(id, thumbnail);
+  }
+}
+
+void KIDTab::on_graphs_changed() {
+  // the open graphs stay parsed, switching only swaps the models of the lists
+  std::map<int, GraphDocument*>::iterator iter = documents.end();
+  if(com_graphs->get_active()) {
+    int id;
+    com_graphs->get_active()->get_value(1, id);
+    iter = documents.find(id);
+  }
+
+  if(iter == documents.end()) {
+    doc = NULL;
+    trv_nodes->set_model(nds_store);
+    trv_edges->set_model(edg_store);
+  }
+  else {
+    doc = iter->second;
+    trv_nodes->set_model(doc->nodes);
+    trv_edges->set_model(doc->edges);
+  }
+  btn_focus->set_active(doc && doc->focus.is_active());
 
+  update_history();
   create_graphviz_dot();
+  gda_graph->zoom_fit();
 }
 
 void KIDTab::on_zoom_in_clicked() {
@@ -692,3 +852,62 @@ void KIDTab::on_export_clicked() {
   gda_graph->save();  
 }
 
+void KIDTab::on_native_toggled() {
+  logger->log("kid", std::string("layout engine: ")+(btn_native->get_active() ? "native" : "graphviz"));
+  create_graphviz_dot();
+  gda_graph->zoom_fit();
+}
+
+void KIDTab::on_relayout_clicked() {
+  logger->log("kid", "relayout");
+  gda_graph->relayout();
+}
+
+void KIDTab::on_focus_toggled() {
+  // switching documents only shows the state of the new document
+  if(!doc || btn_focus->get_active() == doc->focus.is_active()) {
+    if(!doc)
+      btn_focus->set_active(false);
+    return;
+  }
+
+  if(btn_focus->get_active()) {
+    // focus on the selected node or on the marked roots
+    std::vector<std::string> centers;
+    if(trv_nodes->get_selection()->count_selected_rows() == 1) {
+      Glib::ustring node;
+      trv_nodes->get_selection()->get_selected()->get_value(0, node);
+      centers.push_back(node);
+    }
+    else {
+      for(int id = 0; id < doc->graph.node_count(); id++)
+        if(doc->graph.is_root(id))
+          centers.push_back(doc->graph.get_node(id).node);
+    }
+    doc->focus.focus(doc->graph, centers);
+    if(centers.size() == 1)
+      logger->log("kid", "focus on %s", centers[0].c_str());
+    else
+      logger->log("kid", "focus on %d marked nodes", (int)centers.size());
+  }
+  else {
+    doc->focus.clear();
+    logger->log("kid", "focus off");
+  }
+  create_graphviz_dot();
+  gda_graph->zoom_fit();
+}
+
+void KIDTab::on_layout_positions(const std::vector<KIDLayout::Node> &nodes) {
+  // the positions are kept in the graph, so the next layout and saved kgb files start from them
+  if(!doc)
+    return;
+  for(size_t i = 0; i < nodes.size(); i++) {
+    if(nodes[i].rank_box)
+      continue;
+    int id = doc->graph.node_id(nodes[i].name);
+    if(id >= 0)
+      doc->graph.set_position(id, nodes[i].x, nodes[i].y);
+  }
+}
+
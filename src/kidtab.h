@@ -1,5 +1,8 @@
 #pragma once
 #include "graph_drawing_area.h"
+#include "graph_thumbnailer.h"
+
+#include <set>
 
 #include <gtkmm.h>
 #include <gdk/gdk.h>
@@ -14,6 +17,10 @@
 #include "scenetab.h"
 #include "loggertab.h"
 #include "kidgraph.h"
+#include "kidjournal.h"
+#include "kidfocus.h"
+#include "imagecache.h"
+#include "documentindex.h"
 
 namespace SceneReconstruction {
 /** @class KIDTab "kidtab.h"
@@ -33,7 +40,42 @@ namespace SceneReconstruction {
       ~KIDTab();
 
     private:
-      KIDGraph                           graph;
+      /** columns of the node and edge lists */
+      class TextColumns : public Gtk::TreeModel::ColumnRecord {
+        public:
+          TextColumns() { add(text); }
+          Gtk::TreeModelColumn<Glib::ustring> text;
+      };
+
+      /** an open graph with its edit journal, its focus view and the rows
+       *  of its lists, switching between open graphs only swaps the models
+       */
+      struct GraphDocument {
+        int                              id;
+        KIDGraph                         graph;
+        KIDJournal                       journal;
+        KIDFocus                         focus;
+        Glib::RefPtr<Gtk::ListStore>     nodes;
+        Glib::RefPtr<Gtk::ListStore>     edges;
+        /** key of the revision shown by the thumbnail */
+        unsigned long long               thumbnail_key;
+
+        GraphDocument() : id(-1), journal(graph), thumbnail_key(0) {}
+
+        /** identifies the state of the graph among all documents, every
+         *  edit goes through the journal, so the graph is not hashed
+         *  @return the key, never 0
+         */
+        unsigned long long revision_key() const {
+          return ((unsigned long long)(id+1) << 32) | journal.revision();
+        }
+      };
+
+      std::map<int, GraphDocument*>      documents;
+      int                                next_document;
+      GraphDocument                     *doc;
+      KIDGraph                           empty_graph;
+      TextColumns                        text_columns;
       std::list<std::string>             db_collections;
       std::list<std::string>             marked_nodes;
       gazebo::transport::NodePtr         node;
@@ -43,8 +85,14 @@ namespace SceneReconstruction {
       Gtk::ToolButton                   *btn_load;
       Gtk::ToolButton                   *btn_save;
       Gtk::ToolButton                   *btn_close;
+      Gtk::ToolButton                   *btn_undo;
+      Gtk::ToolButton                   *btn_redo;
       Gtk::ComboBox                     *com_graphs;
       Glib::RefPtr<Gtk::ListStore>       gra_store;
+      GraphThumbnailer                   thumbnailer;
+      /** documents whose thumbnails are requested when the edits pause */
+      std::set<int>                      thumbnail_pending;
+      sigc::connection                   thumbnail_timer;
 
       Gtk::ComboBoxText                 *com_type;
       Gtk::Label                        *lbl_left;
@@ -69,13 +117,20 @@ namespace SceneReconstruction {
       Gtk::ToolButton                   *btn_zoomfit;
       Gtk::ToolButton                   *btn_zoomreset;
       Gtk::ToolButton                   *btn_export;
+      Gtk::ToggleToolButton             *btn_native;
+      Gtk::ToolButton                   *btn_relayout;
+      Gtk::ToggleToolButton             *btn_focus;
 
       Gtk::Window                       *win_show;
       Gtk::ComboBox                     *win_combo;
       Gtk::Image                        *win_image;
-      std::map<int, Glib::RefPtr<Gdk::Pixbuf> > win_images;
-      std::map<int, gazebo::msgs::Drawing >     win_pointclouds;
-      Glib::RefPtr<Gdk::Pixbuf>          missing_image;
+      /** documents of the selected node, decoded when they are shown */
+      DocumentIndex                      win_documents;
+      /** rows of win_combo by document id */
+      std::map<int, Gtk::TreeModel::iterator>   win_rows;
+      /** documents whose images are converted while the GUI is idle */
+      std::list<int>                     win_prefetch;
+      sigc::connection                   win_prefetch_idle;
       Gtk::TextView                     *win_textview;
       Glib::RefPtr<Gtk::TextBuffer>      win_textbuffer;
       Glib::RefPtr<Gtk::ListStore>       win_store;
@@ -85,6 +140,8 @@ namespace SceneReconstruction {
       Gtk::Dialog                       *dia_new;
       Gtk::Entry                        *dia_new_entry;
       Glib::RefPtr<Gtk::FileFilter>      filter_kgf;
+      Glib::RefPtr<Gtk::FileFilter>      filter_kgb;
+      Glib::RefPtr<Gtk::FileFilter>      filter_kid;
 
 
       gazebo::transport::SubscriberPtr   resSub;
@@ -100,10 +157,19 @@ namespace SceneReconstruction {
       void OnResponseMsg(ConstResponsePtr&);
       void ProcessResponseMsg();
       void create_graphviz_dot();
+      int open_document(GraphDocument*);
+      void fill_lists(GraphDocument*);
+      void update_history();
+      void update_thumbnail(GraphDocument*);
+      void set_thumbnail(int, const Glib::RefPtr<Gdk::Pixbuf>&);
+      bool on_thumbnail_timeout();
+      void on_thumbnails_ready();
       void on_new_clicked();
       void on_load_clicked();
       void on_save_clicked();
       void on_close_clicked();
+      void on_undo_clicked();
+      void on_redo_clicked();
       void on_graphs_changed();
       void on_type_changed();
       void on_add_clicked();
@@ -116,6 +182,12 @@ namespace SceneReconstruction {
       void on_zoom_fit_clicked();
       void on_zoom_reset_clicked();
       void on_export_clicked();
+      void on_native_toggled();
+      void on_relayout_clicked();
+      void on_focus_toggled();
+      void on_layout_positions(const std::vector<KIDLayout::Node>&);
       void on_document_changed();
+      std::string document_image(int, gazebo::msgs::SceneDocument&);
+      bool on_document_prefetch();
   };
 }
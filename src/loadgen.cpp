@@ -0,0 +1,462 @@
+#include "loadgen.h"
+
+#include <gazebo/common/Image.hh>
+#include <gazebo/common/Time.hh>
+#include <gazebo/math/Pose.hh>
+#include <gazebo/Master.hh>
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace SceneReconstruction;
+
+/** @class LoadGenerator "loadgen.h"
+ *  Headless stand-in for the simulator and the RobotController, ObjectInstantiator
+ *  and Framework plugins. It advertises the topics the GUI subscribes to and
+ *  publishes configurable synthetic streams to stress test the GUI. Every
+ *  ~/world_stats message carries its send time in real_time, the generator
+ *  subscribes to it as well and reports the delay until it is received.
+ *  @author Bastian Klingen
+ */
+
+LoadGenerator::LoadGenerator(const Settings &_settings)
+{
+  settings = _settings;
+  running = 0;
+  sent_msgs = sent_bytes = 0;
+  this->requestMutex = new boost::mutex();
+  this->delayMutex = new boost::mutex();
+  srand(settings.seed);
+
+  gazebo::transport::init();
+  gazebo::transport::run();
+  gazebo::transport::NodePtr _node(new gazebo::transport::Node());
+  node = _node;
+  node->Init();
+
+  statsPub = node->Advertise<gazebo::msgs::WorldStatistics>("~/world_stats");
+  timePub = node->Advertise<gazebo::msgs::Double>("~/SceneReconstruction/GUI/Time");
+  robotBufferPub = node->Advertise<gazebo::msgs::Message_V>("~/SceneReconstruction/RobotController/");
+  objectBufferPub = node->Advertise<gazebo::msgs::Message_V>("~/SceneReconstruction/ObjectInstantiator/Object");
+  mongoPub = node->Advertise<gazebo::msgs::Response>("~/SceneReconstruction/GUI/MongoDB");
+  availPub = node->Advertise<gazebo::msgs::Response>("~/SceneReconstruction/GUI/Availability/Response");
+  objectPub = node->Advertise<gazebo::msgs::Response>("~/SceneReconstruction/ObjectInstantiator/Response");
+
+  frameworkSub = node->Subscribe("~/SceneReconstruction/Framework/Request", &LoadGenerator::OnRequestMsg, this);
+  objectSub = node->Subscribe("~/SceneReconstruction/ObjectInstantiator/Request", &LoadGenerator::OnRequestMsg, this);
+  robotSub = node->Subscribe("~/SceneReconstruction/RobotController/Request", &LoadGenerator::OnRequestMsg, this);
+  statsSub = node->Subscribe("~/world_stats", &LoadGenerator::OnWorldStatsMsg, this);
+}
+
+LoadGenerator::~LoadGenerator() {
+  node->Fini();
+  gazebo::transport::stop();
+  gazebo::transport::fini();
+  delete requestMutex;
+  delete delayMutex;
+}
+
+double LoadGenerator::now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+void LoadGenerator::OnRequestMsg(ConstRequestPtr &_msg) {
+  boost::mutex::scoped_lock lock(*this->requestMutex);
+  this->requestMsgs.push_back(*_msg);
+}
+
+void LoadGenerator::OnWorldStatsMsg(ConstWorldStatisticsPtr &_msg) {
+  // real_time is the send time, see publish_world_stats
+  double delay = now() - (_msg->real_time().sec() + _msg->real_time().nsec()/1000000000.0);
+  boost::mutex::scoped_lock lock(*this->delayMutex);
+  Delays *d[] = { &delays, &total_delays };
+  for(int i=0; i<2; i++) {
+    d[i]->count++;
+    d[i]->sum += delay;
+    d[i]->max = std::max(d[i]->max, delay);
+  }
+}
+
+void LoadGenerator::ProcessRequestMsgs() {
+  std::list<gazebo::msgs::Request> requests;
+  {
+    boost::mutex::scoped_lock lock(*this->requestMutex);
+    requests.swap(requestMsgs);
+  }
+
+  std::list<gazebo::msgs::Request>::iterator _msg;
+  for(_msg = requests.begin(); _msg != requests.end(); _msg++) {
+    if(_msg->request() == "collection_names")
+      publish_collections(*_msg);
+    else if(_msg->request() == "documents")
+      publish_documents(*_msg);
+    else if(_msg->request() == "object_list")
+      publish_object_list(*_msg);
+  }
+}
+
+void LoadGenerator::publish(gazebo::transport::PublisherPtr &pub, const google::protobuf::Message &msg) {
+  pub->Publish(msg);
+  sent_msgs++;
+  sent_bytes += msg.ByteSize();
+}
+
+void LoadGenerator::fill_pose(gazebo::msgs::Pose *pose, double t) {
+  gazebo::math::Pose p(gazebo::math::Vector3(cos(t), sin(t), 0.5),
+                       gazebo::math::Quaternion(0.0, 0.0, t));
+  gazebo::msgs::Set(pose, p);
+}
+
+void LoadGenerator::publish_world_stats(double t) {
+  gazebo::msgs::WorldStatistics stats;
+  gazebo::common::Time sim(t);
+  gazebo::msgs::Set(stats.mutable_sim_time(), sim);
+  gazebo::msgs::Set(stats.mutable_pause_time(), gazebo::common::Time(0.0));
+  gazebo::msgs::Set(stats.mutable_real_time(), gazebo::common::Time(now()));
+  stats.set_paused(false);
+  stats.set_iterations(sent_msgs);
+  publish(statsPub, stats);
+}
+
+void LoadGenerator::publish_robot_buffer(double t) {
+  gazebo::msgs::Message_V positions;
+  gazebo::msgs::SceneRobot pos;
+  positions.set_msgtype(pos.GetTypeName());
+  for(int i=0; i<settings.buffer_size; i++) {
+    double time = t + i/1000.0;
+    pos.set_controltime(time);
+    fill_pose(pos.mutable_pose(), time);
+    pos.SerializeToString(positions.add_msgsdata());
+  }
+  publish(robotBufferPub, positions);
+
+  gazebo::msgs::Message_V joints;
+  gazebo::msgs::SceneJoint jnt;
+  joints.set_msgtype(jnt.GetTypeName());
+  for(int i=0; i<settings.buffer_size; i++) {
+    jnt.Clear();
+    jnt.set_controltime(t + i/1000.0);
+    for(int j=0; j<7; j++) {
+      jnt.add_joint("joint_"+boost::lexical_cast<std::string>(j));
+      jnt.add_angle(sin(t + i + j));
+    }
+    jnt.SerializeToString(joints.add_msgsdata());
+  }
+  publish(robotBufferPub, joints);
+}
+
+void LoadGenerator::publish_object_buffer(double t) {
+  gazebo::msgs::Message_V objects;
+  gazebo::msgs::SceneObject obj;
+  objects.set_msgtype(obj.GetTypeName());
+  for(int i=0; i<settings.buffer_size; i++) {
+    obj.Clear();
+    obj.set_object("object_"+boost::lexical_cast<std::string>(i % 100));
+    obj.set_time(t + i/1000.0);
+    obj.set_visible(i % 2 == 0);
+    obj.set_frame("/map");
+    fill_pose(obj.mutable_pose(), t + i);
+    obj.SerializeToString(objects.add_msgsdata());
+  }
+  publish(objectBufferPub, objects);
+}
+
+void LoadGenerator::publish_availability() {
+  const char *plugins[] = { "Framework", "ObjectInstantiator", "RobotController" };
+  for(int i=0; i<3; i++) {
+    gazebo::msgs::Response response;
+    response.set_id(-1);
+    response.set_request("available");
+    response.set_response(plugins[i]);
+    publish(availPub, response);
+  }
+}
+
+void LoadGenerator::publish_collections(const gazebo::msgs::Request &req) {
+  gazebo::msgs::GzString_V names;
+  for(int i=0; i<settings.collections; i++)
+    names.add_data("collection_"+boost::lexical_cast<std::string>(i));
+
+  gazebo::msgs::Response response;
+  response.set_id(req.id());
+  response.set_request(req.request());
+  response.set_response("success");
+  response.set_type(names.GetTypeName());
+  names.SerializeToString(response.mutable_serialized_data());
+  publish(mongoPub, response);
+}
+
+void LoadGenerator::publish_documents(const gazebo::msgs::Request &req) {
+  int w = settings.image_width;
+  int h = settings.image_height;
+  std::string pixels(w*h*3, '\0');
+
+  gazebo::msgs::SceneDocument doc;
+  gazebo::msgs::Message_V docs;
+  docs.set_msgtype(doc.GetTypeName());
+  for(int i=0; i<settings.documents; i++) {
+    doc.Clear();
+    doc.set_timestamp(i*100.0);
+    doc.set_interface(req.data());
+    doc.set_document("{\"collection\":\""+req.data()+"\",\"index\":"+boost::lexical_cast<std::string>(i)+",\"values\":[1,2,3]}");
+
+    if(w > 0 && h > 0) {
+      // gradient that changes per document so every image differs
+      for(int y=0; y<h; y++) {
+        for(int x=0; x<w; x++) {
+          pixels[(y*w+x)*3+0] = (char)(x+i);
+          pixels[(y*w+x)*3+1] = (char)(y+i);
+          pixels[(y*w+x)*3+2] = (char)(i*16);
+        }
+      }
+      gazebo::msgs::Image *img = doc.mutable_image();
+      img->set_width(w);
+      img->set_height(h);
+      img->set_pixel_format(gazebo::common::Image::RGB_INT8);
+      img->set_step(w*3);
+      img->set_data(pixels);
+    }
+
+    if(settings.points > 0) {
+      gazebo::msgs::Drawing *pcl = doc.mutable_pointcloud();
+      pcl->set_name("pointcloud");
+      pcl->set_visible(true);
+      pcl->set_mode(gazebo::msgs::Drawing::POINT_LIST);
+      for(int p=0; p<settings.points; p++) {
+        double r = (double)rand()/RAND_MAX;
+        gazebo::msgs::Set(pcl->add_point()->mutable_position(), gazebo::math::Vector3(r*cos(p), r*sin(p), (double)p/settings.points));
+      }
+    }
+
+    doc.SerializeToString(docs.add_msgsdata());
+
+    bool last = (i == settings.documents-1);
+    if(docs.msgsdata_size() >= settings.documents_per_msg || last) {
+      gazebo::msgs::Response response;
+      response.set_id(req.id());
+      response.set_request(req.request());
+      response.set_response(last?"success":"part");
+      response.set_type(docs.GetTypeName());
+      docs.SerializeToString(response.mutable_serialized_data());
+      publish(mongoPub, response);
+      docs.clear_msgsdata();
+    }
+  }
+}
+
+void LoadGenerator::publish_object_list(const gazebo::msgs::Request &req) {
+  gazebo::msgs::GzString_V names;
+  for(int i=0; i<100; i++)
+    names.add_data("object_"+boost::lexical_cast<std::string>(i));
+
+  gazebo::msgs::Response response;
+  response.set_id(req.id());
+  response.set_request(req.request());
+  response.set_response("success");
+  response.set_type(names.GetTypeName());
+  names.SerializeToString(response.mutable_serialized_data());
+  publish(objectPub, response);
+}
+
+void LoadGenerator::run() {
+  running = 1;
+  start = now();
+
+  // announce the time range of the scene
+  gazebo::msgs::Double range;
+  range.set_data(settings.duration > 0 ? settings.duration*1000.0 : 3600000.0);
+  publish(timePub, range);
+
+  double next_stats  = start,
+         next_buffer = start,
+         next_avail  = start,
+         next_report = start + 1.0;
+  unsigned long last_msgs = 0,
+                last_bytes = 0;
+
+  while(running) {
+    double t = now();
+    if(settings.duration > 0 && t - start >= settings.duration)
+      break;
+
+    ProcessRequestMsgs();
+
+    // skip instead of bursting if we fell behind by more than a second
+    if(settings.stats_rate > 0) {
+      if(t - next_stats > 1.0)
+        next_stats = t;
+      while(next_stats <= t) {
+        publish_world_stats(next_stats - start);
+        next_stats += 1.0/settings.stats_rate;
+      }
+    }
+
+    if(settings.buffer_rate > 0) {
+      if(t - next_buffer > 1.0)
+        next_buffer = t;
+      while(next_buffer <= t) {
+        publish_robot_buffer(next_buffer - start);
+        publish_object_buffer(next_buffer - start);
+        next_buffer += 1.0/settings.buffer_rate;
+      }
+    }
+
+    if(settings.avail_rate > 0 && next_avail <= t) {
+      publish_availability();
+      next_avail = t + 1.0/settings.avail_rate;
+    }
+
+    if(next_report <= t) {
+      Delays d;
+      {
+        boost::mutex::scoped_lock lock(*this->delayMutex);
+        std::swap(d, delays);
+      }
+      std::cout << "sent " << (sent_msgs - last_msgs) << " msgs/s, "
+                << (sent_bytes - last_bytes)/1024 << " KiB/s";
+      if(d.count > 0)
+        std::cout << ", world_stats delay avg " << d.sum/d.count*1000.0
+                  << " ms, max " << d.max*1000.0 << " ms";
+      std::cout << std::endl;
+      last_msgs = sent_msgs;
+      last_bytes = sent_bytes;
+      next_report += 1.0;
+    }
+
+    double next = next_report;
+    if(settings.stats_rate > 0 && next_stats < next)
+      next = next_stats;
+    if(settings.buffer_rate > 0 && next_buffer < next)
+      next = next_buffer;
+    // wake up at least every millisecond to answer requests
+    double wait = std::min(next - now(), 0.001);
+    if(wait > 0)
+      usleep((useconds_t)(wait*1000000));
+  }
+
+  running = 0;
+  std::cout << "sent " << sent_msgs << " msgs, " << sent_bytes/1024 << " KiB in "
+            << (now() - start) << " s" << std::endl;
+  boost::mutex::scoped_lock lock(*this->delayMutex);
+  if(total_delays.count > 0)
+    std::cout << "received " << total_delays.count << " world_stats, delay avg "
+              << total_delays.sum/total_delays.count*1000.0 << " ms, max "
+              << total_delays.max*1000.0 << " ms" << std::endl;
+}
+
+void LoadGenerator::stop() {
+  running = 0;
+}
+
+static LoadGenerator *generator = NULL;
+
+static void on_signal(int /*sig*/) {
+  if(generator)
+    generator->stop();
+}
+
+static void usage(const char *name) {
+  std::cout << "Usage: " << name << " [options]\n"
+            << "  --master               run an embedded gazebo master instead of connecting to one\n"
+            << "  --stats-rate <Hz>      rate of ~/world_stats (default 1000)\n"
+            << "  --buffer-rate <Hz>     rate of robot and object buffers (default 1)\n"
+            << "  --buffer-size <n>      entries per buffer message (default 1000)\n"
+            << "  --avail-rate <Hz>      rate of availability responses (default 1)\n"
+            << "  --collections <n>      collections returned for collection_names (default 50)\n"
+            << "  --documents <n>        documents returned for a documents request (default 100)\n"
+            << "  --documents-per-msg <n> documents per response message (default 10)\n"
+            << "  --image <w>x<h>        size of the document images (default 640x480, 0x0 for none)\n"
+            << "  --points <n>           points per document pointcloud (default 10000)\n"
+            << "  --duration <s>         seconds to run, 0 until interrupted (default 0)\n"
+            << "  --seed <n>             seed for the random number generator (default 1)\n";
+}
+
+int main(int argc, char **argv)
+{
+  LoadGenerator::Settings settings;
+  settings.stats_rate        = 1000.0;
+  settings.buffer_rate       = 1.0;
+  settings.buffer_size       = 1000;
+  settings.avail_rate        = 1.0;
+  settings.collections       = 50;
+  settings.documents         = 100;
+  settings.documents_per_msg = 10;
+  settings.image_width       = 640;
+  settings.image_height      = 480;
+  settings.points            = 10000;
+  settings.duration          = 0.0;
+  settings.seed              = 1;
+  bool master                = false;
+
+  for(int i=1; i<argc; i++) {
+    bool has_value = (i+1 < argc);
+    if(strcmp(argv[i], "--master") == 0)
+      master = true;
+    else if(strcmp(argv[i], "--stats-rate") == 0 && has_value)
+      settings.stats_rate = atof(argv[++i]);
+    else if(strcmp(argv[i], "--buffer-rate") == 0 && has_value)
+      settings.buffer_rate = atof(argv[++i]);
+    else if(strcmp(argv[i], "--buffer-size") == 0 && has_value)
+      settings.buffer_size = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--avail-rate") == 0 && has_value)
+      settings.avail_rate = atof(argv[++i]);
+    else if(strcmp(argv[i], "--collections") == 0 && has_value)
+      settings.collections = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--documents") == 0 && has_value)
+      settings.documents = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--documents-per-msg") == 0 && has_value)
+      settings.documents_per_msg = std::max(1, atoi(argv[++i]));
+    else if(strcmp(argv[i], "--image") == 0 && has_value) {
+      if(sscanf(argv[++i], "%dx%d", &settings.image_width, &settings.image_height) != 2) {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if(strcmp(argv[i], "--points") == 0 && has_value)
+      settings.points = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--duration") == 0 && has_value)
+      settings.duration = atof(argv[++i]);
+    else if(strcmp(argv[i], "--seed") == 0 && has_value)
+      settings.seed = atoi(argv[++i]);
+    else {
+      usage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    }
+  }
+
+  gazebo::Master *gzmaster = NULL;
+  if(master) {
+    std::string host;
+    unsigned int port;
+    gazebo::transport::get_master_uri(host, port);
+    gzmaster = new gazebo::Master();
+    gzmaster->Init(port);
+    gzmaster->RunThread();
+  }
+
+  {
+    LoadGenerator gen(settings);
+    generator = &gen;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    gen.run();
+    generator = NULL;
+  }
+
+  if(gzmaster) {
+    gzmaster->Fini();
+    delete gzmaster;
+  }
+
+  return 0;
+}
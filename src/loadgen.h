@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <list>
+#include <csignal>
+
+#include <google/protobuf/message.h>
+
+#include <gazebo/transport/Node.hh>
+#include <gazebo/transport/Transport.hh>
+#include <gazebo/transport/TransportTypes.hh>
+#include <gazebo/gazebo_config.h>
+
+namespace SceneReconstruction {
+  /** @class LoadGenerator "loadgen.h"
+   *  Headless stand-in for the simulator and the RobotController, ObjectInstantiator
+   *  and Framework plugins. It advertises the topics the GUI subscribes to and
+   *  publishes configurable synthetic streams to stress test the GUI. Every
+   *  ~/world_stats message carries its send time in real_time, the generator
+   *  subscribes to it as well and reports the delay until it is received.
+   *  @author Bastian Klingen
+   */
+  class LoadGenerator
+  {
+    public:
+      /** settings of the generated streams */
+      struct Settings {
+        /** rate of ~/world_stats messages in Hz */
+        double       stats_rate;
+        /** rate of robot and object buffer messages in Hz */
+        double       buffer_rate;
+        /** number of entries per buffer message */
+        int          buffer_size;
+        /** rate of availability responses in Hz */
+        double       avail_rate;
+        /** number of collections returned for collection_names */
+        int          collections;
+        /** number of documents returned for a documents request */
+        int          documents;
+        /** number of documents sent in one response message */
+        int          documents_per_msg;
+        /** width of the document images */
+        int          image_width;
+        /** height of the document images */
+        int          image_height;
+        /** number of points of the document pointclouds */
+        int          points;
+        /** seconds to run, 0 to run until interrupted */
+        double       duration;
+        /** seed for the random number generator */
+        unsigned int seed;
+      };
+
+      /** Constructor
+       *  @param settings settings of the generated streams
+       */
+      LoadGenerator(const Settings&);
+      /** Destructor */
+      ~LoadGenerator();
+
+      /** publishes the streams until the duration is reached or stop() is called */
+      void run();
+      /** stops run(), may be called from a signal handler */
+      void stop();
+
+    private:
+      Settings                           settings;
+      gazebo::transport::NodePtr         node;
+      gazebo::transport::PublisherPtr    statsPub,
+                                         timePub,
+                                         robotBufferPub,
+                                         objectBufferPub,
+                                         mongoPub,
+                                         availPub,
+                                         objectPub;
+      gazebo::transport::SubscriberPtr   frameworkSub,
+                                         objectSub,
+                                         robotSub,
+                                         statsSub;
+
+      boost::mutex                      *requestMutex;
+      std::list<gazebo::msgs::Request>   requestMsgs;
+
+      /** receive delays of ~/world_stats in seconds */
+      struct Delays {
+        unsigned long                    count;
+        double                           sum,
+                                         max;
+
+        Delays() : count(0), sum(0), max(0) {}
+      };
+      boost::mutex                      *delayMutex;
+      /** delays since the last report and since the start */
+      Delays                             delays,
+                                         total_delays;
+
+      /** written by the signal handlers, so it is polled as sig_atomic_t */
+      volatile sig_atomic_t              running;
+      double                             start;
+      unsigned long                      sent_msgs,
+                                         sent_bytes;
+
+    private:
+      void OnRequestMsg(ConstRequestPtr&);
+      void OnWorldStatsMsg(ConstWorldStatisticsPtr&);
+      void ProcessRequestMsgs();
+      void publish(gazebo::transport::PublisherPtr&, const google::protobuf::Message&);
+      void publish_world_stats(double);
+      void publish_robot_buffer(double);
+      void publish_object_buffer(double);
+      void publish_availability();
+      void publish_collections(const gazebo::msgs::Request&);
+      void publish_documents(const gazebo::msgs::Request&);
+      void publish_object_list(const gazebo::msgs::Request&);
+      void fill_pose(gazebo::msgs::Pose*, double);
+      static double now();
+  };
+}
@@ -30,11 +30,27 @@ LoggerTab::LoggerTab(Glib::RefPtr<Gtk::Builder>& builder)
 
   std::cout.rdbuf(tbs_cout);
   std::cerr.rdbuf(tbs_cout);
+
+  // keep the last 60 seconds of traffic, at most 32 MB
+  recorder = new FlightRecorder(32*1024*1024, 60.0, 65536);
+  this->dumpMutex = new boost::mutex();
+  dumping = false;
+  on_recorder_dump.connect( sigc::mem_fun( *this , &LoggerTab::ProcessRecorderDump ));
+  on_recorder_dumped.connect( sigc::mem_fun( *this , &LoggerTab::ProcessRecorderDumped ));
+
+  // Ctrl+D dumps the flight recorder, connected after the default handler
+  // so accelerators and the focused widget get the key first
+  Gtk::Window *window;
+  _builder->get_widget("window", window);
+  window->signal_key_press_event().connect(sigc::mem_fun(*this,&LoggerTab::on_window_key_press), true);
 }
 
 LoggerTab::~LoggerTab() {
   std::cout.rdbuf(old_cout);
   std::cerr.rdbuf(old_cerr);
+  if(dumpThread.joinable())
+    dumpThread.join();
+  delete recorder;
 }
 
 void LoggerTab::log(std::string event, std::string text, ...)
@@ -108,6 +124,9 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::R
     msg << _msg.dbl_data();
   }
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "Request", topic, msg.str());
 }
 
@@ -137,6 +156,9 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::W
     msg << (_msg.reset().all()||_msg.reset().model_only()?"true":"false");
   }
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "WorldControl", topic, msg.str());
 }
 
@@ -153,14 +175,16 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::R
     msg << ", Type: ";
     msg << _msg.type();
 
-    gazebo::msgs::GzString error;
-    if(_msg.response() != "success" && _msg.type() == error.GetTypeName() && _msg.has_serialized_data()) {
-      error.ParseFromString(_msg.serialized_data());
+    std::string error;
+    if(response_error(_msg, error)) {
       msg << ", Error: ";
-      msg << error.data();
+      msg << error;
     }
   }
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "Response", topic, msg.str());
 }
 
@@ -170,6 +194,9 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::D
   msg << "Data: ";
   msg << _msg.data();
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "Double", topic, msg.str());
 }
 
@@ -181,6 +208,9 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::M
   msg << ", Number of Messages: ";
   msg << _msg.msgsdata_size();
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "Message_V", topic, msg.str());
 }
 
@@ -263,9 +293,121 @@ void LoggerTab::msglog(std::string dir, std::string topic, const gazebo::msgs::S
     }
   }
 
+  if(dir == ">>")
+    recorder->record(topic.c_str(), _msg);
+
   logmsg(dir, "SceneRobotController", topic, msg.str());
 }
 
+bool LoggerTab::response_error(const gazebo::msgs::Response &_msg, std::string &error)
+{
+  // compare against the descriptor to avoid creating a GzString for every response
+  if(_msg.response() != "success" && _msg.has_type() && _msg.has_serialized_data() &&
+     _msg.type() == gazebo::msgs::GzString::descriptor()->full_name()) {
+    gazebo::msgs::GzString err;
+    err.ParseFromString(_msg.serialized_data());
+    error = err.data();
+    return true;
+  }
+
+  return false;
+}
+
+void LoggerTab::record(const char *topic, const google::protobuf::Message &_msg)
+{
+  recorder->record(topic, _msg);
+}
+
+void LoggerTab::record(const char *topic, const gazebo::msgs::Response &_msg)
+{
+  recorder->record(topic, _msg);
+
+  std::string error;
+  if(response_error(_msg, error)) {
+    {
+      boost::mutex::scoped_lock lock(*this->dumpMutex);
+      dumpReasons.push_back("error response to \""+_msg.request()+"\" on "+topic+": "+error);
+    }
+    on_recorder_dump();
+  }
+}
+
+void LoggerTab::ProcessRecorderDump()
+{
+  std::list<std::string> reasons;
+  {
+    boost::mutex::scoped_lock lock(*this->dumpMutex);
+    reasons.swap(dumpReasons);
+  }
+
+  // several errors arriving at once only need one dump
+  if(!reasons.empty())
+    dump_recorder(reasons.front());
+}
+
+void LoggerTab::dump_recorder(std::string reason)
+{
+  bool busy;
+  {
+    boost::mutex::scoped_lock lock(*this->dumpMutex);
+    busy = dumping;
+    dumping = true;
+  }
+  if(busy) {
+    log("flight recorder", "still dumping, not dumped again ("+reason+")");
+    return;
+  }
+
+  char filename[64];
+  time_t now = time(NULL);
+  strftime(filename, sizeof(filename), "flightrecorder_%Y%m%d_%H%M%S.log", localtime(&now));
+
+  // the previous dump is finished, its thread only has to be joined
+  if(dumpThread.joinable())
+    dumpThread.join();
+  dumpThread = boost::thread(&LoggerTab::write_recorder, this, std::string(filename), reason);
+}
+
+void LoggerTab::write_recorder(std::string filename, std::string reason)
+{
+  std::ostringstream text;
+  size_t n = 0;
+  if(recorder->dump(filename, &n))
+    text << "dumped " << n << " messages to " << filename << " (" << reason << ")";
+  else
+    text << "could not write " << filename << " (" << reason << ")";
+
+  {
+    boost::mutex::scoped_lock lock(*this->dumpMutex);
+    dumpResults.push_back(text.str());
+    dumping = false;
+  }
+  on_recorder_dumped();
+}
+
+void LoggerTab::ProcessRecorderDumped()
+{
+  std::list<std::string> results;
+  {
+    boost::mutex::scoped_lock lock(*this->dumpMutex);
+    results.swap(dumpResults);
+  }
+
+  std::list<std::string>::iterator iter;
+  for(iter = results.begin(); iter != results.end(); iter++)
+    log("flight recorder", *iter);
+}
+
+bool LoggerTab::on_window_key_press(GdkEventKey *event)
+{
+  if((event->state & GDK_CONTROL_MASK) && (event->keyval == GDK_KEY_d || event->keyval == GDK_KEY_D)) {
+    dump_recorder("requested by user");
+    return true;
+  }
+
+  return false;
+}
+
 void LoggerTab::show_available(std::string comp) {
   Gtk::Image *img;
   std::transform(comp.begin(), comp.end(), comp.begin(), ::tolower);
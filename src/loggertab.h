@@ -3,6 +3,8 @@
 #include <gdk/gdk.h>
 #include <time.h>
 
+#include <boost/thread/thread.hpp>
+
 #include <google/protobuf/message.h>
 
 #include <gazebo/common/Time.hh>
@@ -13,6 +15,7 @@
 
 #include "scenetab.h"
 #include "loggingtools.h"
+#include "flightrecorder.h"
 
 namespace SceneReconstruction {
   /** @class LoggerTab "loggertab.h"
@@ -39,9 +42,24 @@ namespace SceneReconstruction {
       time_t                        offset;         // offset for current time
       std::streambuf               *old_cout,
                                    *old_cerr;
+      FlightRecorder               *recorder;
+
+      Glib::Dispatcher              on_recorder_dump,
+                                    on_recorder_dumped;
+      boost::mutex                 *dumpMutex;
+      std::list<std::string>        dumpReasons;
+      /** writes the dumps, so the GUI does not wait for the disk */
+      boost::thread                 dumpThread;
+      bool                          dumping;
+      std::list<std::string>        dumpResults;
 
     private:
       void logmsg(std::string, std::string, std::string, std::string);
+      bool response_error(const gazebo::msgs::Response&, std::string&);
+      void ProcessRecorderDump();
+      void write_recorder(std::string, std::string);
+      void ProcessRecorderDumped();
+      bool on_window_key_press(GdkEventKey*);
 
     public:
       /** logs events to the treeview with timestamp and additional text
@@ -92,6 +110,26 @@ namespace SceneReconstruction {
        */
       void msglog(std::string, std::string, const gazebo::msgs::Message_V&);
 
+      /** records a received message in the flight recorder, thread-safe
+       *  @param topic topic of the message, should be a string literal
+       *  @param _msg the msg to record
+       */
+      void record(const char*, const google::protobuf::Message&);
+
+      /** records a received response in the flight recorder, thread-safe.
+       *  Responses carrying an error trigger a dump of the flight recorder.
+       *  @param topic topic of the message, should be a string literal
+       *  @param _msg the msg to record
+       */
+      void record(const char*, const gazebo::msgs::Response&);
+
+      /** writes the content of the flight recorder to a file in the
+       *  working directory on a worker thread, the result is logged when
+       *  the file is written, only one dump runs at a time
+       *  @param reason reason for the dump, used for the event log
+       */
+      void dump_recorder(std::string);
+
       /** switches the image for the given component to represent that the
        *  component has respondedto the availability request
        *  @param comp name of the component
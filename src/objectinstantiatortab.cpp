@@ -33,14 +33,8 @@ ObjectInstantiatorTab::ObjectInstantiatorTab(gazebo::transport::NodePtr& _node,
   Gtk::TreeModel::Row row;    
   row = *(img_store->append());
   row.set_value(0, (Glib::ustring)"None");
-  images["None"] = Gdk::Pixbuf::create_from_file("res/noimg.png");
-  int w, h;
-  w = images["None"]->get_width();
-  h = images["None"]->get_height();
-  double scale_w = 455.0/w;
-  double scale_h = 240.0/h;
-  double scale = scale_w<scale_h?scale_w:scale_h;
-  img_data->set(images["None"]->scale_simple((int)(w*scale),(int)(h*scale),Gdk::INTERP_BILINEAR));
+  ImageCache::shared().load_file("res/noimg.png");
+  img_data->set(ImageCache::shared().get_scaled(image_key("None"), 455, 240));
   com_data->set_active(img_store->children().begin());
   com_data->signal_changed().connect( sigc::mem_fun(*this, &ObjectInstantiatorTab::on_combo_changed) );
 
@@ -51,7 +45,7 @@ ObjectInstantiatorTab::ObjectInstantiatorTab(gazebo::transport::NodePtr& _node,
   win_show->set_visible(false);
   _builder->get_widget("objectinstantiator_objectdata_window_scrolledwindow", win_scroll);
   _builder->get_widget("objectinstantiator_objectdata_window_image", win_image);
-  win_image->set(images["None"]);
+  win_image->set(ImageCache::shared().get(image_key("None")));
   _builder->get_widget("objectinstantiator_objectdata_window_combobox", win_combo);
   win_combo->set_active(img_store->children().begin());
   win_combo->signal_changed().connect( sigc::mem_fun(*this, &ObjectInstantiatorTab::on_win_combo_changed) );
@@ -73,6 +67,7 @@ ObjectInstantiatorTab::~ObjectInstantiatorTab() {
 }
 
 void ObjectInstantiatorTab::OnResponseMsg(ConstResponsePtr& _msg) {
+  logger->record("~/SceneReconstruction/ObjectInstantiator/Response", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->responseMutex);
     this->responseMsgs.push_back(*_msg);
@@ -157,12 +152,12 @@ void ObjectInstantiatorTab::ProcessResponseMsg() {
               doc.ParseFromString(src2.msgsdata(m));
 
               if(doc.has_image()) {
+                Glib::ustring name = Converter::to_ustring_time(doc.timestamp())+" => "+doc.interface();
                 irow = *(img_store->append());
-                irow.set_value(0, Converter::to_ustring_time(doc.timestamp())+" => "+doc.interface());
-                gazebo::common::Image img;
-                gazebo::msgs::Set(img, doc.image());
-                img.SavePNG("tmp_img.png");
-                images[doc.interface()] = Gdk::Pixbuf::create_from_file("tmp_img.png");
+                irow.set_value(0, name);
+                // documents requested again are not converted again
+                if(!ImageCache::shared().contains(image_key(name)))
+                  ImageCache::shared().put(image_key(name), Converter::to_pixbuf(*doc.mutable_image()));
               }
               
               Gtk::TreeModel::Row childrow;
@@ -182,7 +177,6 @@ void ObjectInstantiatorTab::ProcessResponseMsg() {
             if(_msg->response() != "part")
               object_data_part2 = true;
           }    
-          image_iter = images.begin();
           com_data->set_active(img_store->children().begin());
 
           if(object_data_part1 && object_data_part2) {
@@ -207,26 +201,9 @@ void ObjectInstantiatorTab::on_combo_changed() {
     if(iter) {
       win_change = true;
       win_combo->set_active(iter);
-      Gtk::TreeModel::Row row = *iter;
-      if(row) {
-        Glib::ustring name;
-        row.get_value(0, name);
-        image_iter = images.find(name);
-        if(image_iter != images.end()) {
-          int w, h;
-          w = image_iter->second->get_width();
-          h = image_iter->second->get_height();
-          double scale_w = 455.0/w;
-          double scale_h = 240.0/h;
-          double scale = scale_w<scale_h?scale_w:scale_h;
-          img_data->set(image_iter->second->scale_simple((int)(w*scale),(int)(h*scale),Gdk::INTERP_BILINEAR));
-        }
-        logger->log("object instantiator", "displaying image "+image_iter->first);
-        if(win_show->get_visible()) {
-          if(image_iter != images.end())
-            win_image->set(image_iter->second);
-        }
-      }
+      Glib::ustring name;
+      iter->get_value(0, name);
+      show_image(name);
     }
     win_change = false;
   }
@@ -238,44 +215,47 @@ void ObjectInstantiatorTab::on_win_combo_changed() {
     if(iter) {
       win_change = true;
       com_data->set_active(iter);
-      Gtk::TreeModel::Row row = *iter;
-      if(row) {
-        Glib::ustring name;
-        row.get_value(0, name);
-        image_iter = images.find(name);
-        if(image_iter != images.end()) {
-          int w, h;
-          w = image_iter->second->get_width();
-          h = image_iter->second->get_height();
-          double scale_w = 455.0/w;
-          double scale_h = 240.0/h;
-          double scale = scale_w<scale_h?scale_w:scale_h;
-          img_data->set(image_iter->second->scale_simple((int)(w*scale),(int)(h*scale),Gdk::INTERP_BILINEAR));
-        }
-        logger->log("object instantiator", "displaying image "+image_iter->first);
-        if(win_show->get_visible()) {
-          if(image_iter != images.end())
-            win_image->set(image_iter->second);
-        }
-      }
+      Glib::ustring name;
+      iter->get_value(0, name);
+      show_image(name);
     }
     win_change = false;
   }
 }
 
+void ObjectInstantiatorTab::show_image(const Glib::ustring &name) {
+  // the preview is scaled once and kept next to the image
+  std::string key = image_key(name);
+  if(!ImageCache::shared().contains(key)) {
+    if(name != "None")
+      logger->log("object instantiator", "image "+name+" is not available");
+    key = image_key("None");
+  }
+  else
+    logger->log("object instantiator", "displaying image "+name);
+  img_data->set(ImageCache::shared().get_scaled(key, 455, 240));
+  if(win_show->get_visible())
+    win_image->set(ImageCache::shared().get(key));
+}
+
+std::string ObjectInstantiatorTab::image_key(const Glib::ustring &name) {
+  if(name == "None")
+    return ImageCache::file_key("res/noimg.png");
+  return image_prefix+name;
+}
+
 void ObjectInstantiatorTab::on_button_show_clicked() {
   if(trv_object->get_selection()->count_selected_rows() == 1) {
-    images.clear();
     img_store->clear();
     Gtk::TreeModel::Row row = *(img_store->append());
     row.set_value(0, (Glib::ustring)"None");
-    images["None"] = Gdk::Pixbuf::create_from_file("res/noimg.png");
     dat_store->clear();
     set_documents = false;
 
     objReq = gazebo::msgs::CreateRequest("object_data");
     Glib::ustring tmp;
     trv_object->get_selection()->get_selected()->get_value(0, tmp);
+    image_prefix = "objectinstantiator/"+tmp+"/";
     objReq->set_data(tmp);
     sceneReqPub->Publish(*objReq);
     logger->log("object instantiator", "requesting data of selected spawned object from ObjectInstantiatorPlugin");
@@ -305,9 +285,8 @@ bool ObjectInstantiatorTab::on_image_button_release(GdkEventButton *b) {
         if(row) {
           Glib::ustring name;
           row.get_value(0, name);
-          image_iter = images.find(name);
-          if(image_iter != images.end())
-            win_image->set(image_iter->second);
+          std::string key = image_key(name);
+          win_image->set(ImageCache::shared().contains(key) ? ImageCache::shared().get(key) : ImageCache::shared().get(image_key("None")));
         }
       }
       win_show->present();
@@ -11,6 +11,7 @@
 
 #include "scenetab.h"
 #include "loggertab.h"
+#include "imagecache.h"
 
 namespace SceneReconstruction {
   /** @class ObjectInstantiatorTab "objectinstantiatortab.h"
@@ -38,8 +39,7 @@ namespace SceneReconstruction {
       Glib::RefPtr<Gtk::TreeStore>                                 dat_store;
       Gtk::Image                                                  *img_data;
       Gtk::EventBox                                               *evt_data;
-      std::map< std::string, Glib::RefPtr<Gdk::Pixbuf> >           images;
-      std::map< std::string, Glib::RefPtr<Gdk::Pixbuf> >::iterator image_iter;
+      std::string                                                  image_prefix;
       Gtk::ComboBox                                               *com_data;
       Glib::RefPtr<Gtk::ListStore>                                 img_store;
 
@@ -74,6 +74,8 @@ namespace SceneReconstruction {
       void on_button_show_clicked();
       void on_combo_changed();
       void on_win_combo_changed();
+      void show_image(const Glib::ustring&);
+      std::string image_key(const Glib::ustring&);
       void on_win_button_close_clicked();
       bool on_image_button_release(GdkEventButton*);
   };
@@ -0,0 +1,166 @@
+#include "pixelconverter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+
+using namespace SceneReconstruction;
+
+namespace {
+  /** settings of the benchmark */
+  struct Settings {
+    /** width of the images */
+    int     width;
+    /** height of the images */
+    int     height;
+    /** number of conversions of each kind */
+    int     iterations;
+  };
+
+  /** gets the current time
+   *  @return the time in seconds
+   */
+  double now()
+  {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  /** one conversion of a whole image */
+  struct Kernel {
+    /** name of the conversion */
+    const char *name;
+    /** bytes per source pixel */
+    int         src_bpp;
+    /** bytes per destination pixel */
+    int         dst_bpp;
+    /** converts an image
+     *  @param src the source pixels
+     *  @param dst the destination pixels
+     *  @param w width of the image
+     *  @param h height of the image
+     *  @param scalar true to use the scalar version
+     */
+    void      (*convert)(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar);
+  };
+
+  void bgr(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::bgr_to_rgb_scalar(src + y*w*3, dst + y*w*3, w);
+      else        PixelConverter::bgr_to_rgb(src + y*w*3, dst + y*w*3, w);
+    }
+  }
+
+  void bgra(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::bgra_to_rgba_scalar(src + y*w*4, dst + y*w*4, w);
+      else        PixelConverter::bgra_to_rgba(src + y*w*4, dst + y*w*4, w);
+    }
+  }
+
+  void gray(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::gray_to_rgb_scalar(src + y*w, dst + y*w*3, w);
+      else        PixelConverter::gray_to_rgb(src + y*w, dst + y*w*3, w);
+    }
+  }
+
+  void rgb16(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::narrow16_scalar(src + y*w*6, dst + y*w*3, w*3);
+      else        PixelConverter::narrow16(src + y*w*6, dst + y*w*3, w*3);
+    }
+  }
+
+  void depth(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    uint16_t min = 0, max = 0;
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::depth_range_scalar(src + y*w*2, w, min, max);
+      else        PixelConverter::depth_range(src + y*w*2, w, min, max);
+    }
+    for(int y = 0; y < h; y++) {
+      if(scalar)  PixelConverter::depth_to_rgb_scalar(src + y*w*2, dst + y*w*3, w, min, max);
+      else        PixelConverter::depth_to_rgb(src + y*w*2, dst + y*w*3, w, min, max);
+    }
+  }
+
+  void bayer(const unsigned char *src, unsigned char *dst, int w, int h, bool scalar) {
+    if(scalar)  PixelConverter::bayer_to_rgba_scalar(src, w, dst, w*4, w, h, PixelConverter::BAYER_GRBG);
+    else        PixelConverter::bayer_to_rgba(src, w, dst, w*4, w, h, PixelConverter::BAYER_GRBG);
+  }
+}
+
+/** measures the throughput of the pixel conversions and compares the
+ *  vectorized conversions with the scalar ones
+ */
+int main(int argc, char **argv) {
+  Settings settings;
+  settings.width = 1920;
+  settings.height = 1080;
+  settings.iterations = 50;
+  if(argc > 1)
+    settings.width = atoi(argv[1]);
+  if(argc > 2)
+    settings.height = atoi(argv[2]);
+  if(argc > 3)
+    settings.iterations = atoi(argv[3]);
+  if(argc > 4 || settings.width < 1 || settings.height < 1 || settings.iterations < 1) {
+    std::cerr << "usage: " << argv[0] << " [width] [height] [iterations]" << std::endl;
+    return 1;
+  }
+
+  static const Kernel kernels[] = {
+    { "bgr to rgb",    3, 3, bgr },
+    { "bgra to rgba",  4, 4, bgra },
+    { "gray to rgb",   1, 3, gray },
+    { "rgb16 to rgb",  6, 3, rgb16 },
+    { "depth to rgb",  2, 3, depth },
+    { "bayer to rgba", 1, 4, bayer }
+  };
+
+  std::cout << "pixels: " << settings.width << "x" << settings.height
+#if defined(__AVX2__)
+            << ", simd: avx2"
+#elif defined(__SSSE3__)
+            << ", simd: ssse3"
+#elif defined(__SSE2__)
+            << ", simd: sse2"
+#else
+            << ", simd: none"
+#endif
+            << std::endl;
+
+  bool ok = true;
+  size_t pixels = (size_t)settings.width * settings.height;
+  unsigned int seed = 1;
+  for(size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++) {
+    const Kernel &kernel = kernels[k];
+    std::vector<unsigned char> src(pixels * kernel.src_bpp);
+    std::vector<unsigned char> dst(pixels * kernel.dst_bpp), ref(pixels * kernel.dst_bpp);
+    for(size_t i = 0; i < src.size(); i++)
+      src[i] = rand_r(&seed);
+
+    kernel.convert(&src[0], &ref[0], settings.width, settings.height, true);
+    kernel.convert(&src[0], &dst[0], settings.width, settings.height, false);
+    bool equal = (memcmp(&ref[0], &dst[0], dst.size()) == 0);
+    ok = ok && equal;
+
+    double time[2];
+    for(int scalar = 0; scalar < 2; scalar++) {
+      double start = now();
+      for(int i = 0; i < settings.iterations; i++)
+        kernel.convert(&src[0], &dst[0], settings.width, settings.height, scalar);
+      time[scalar] = (now() - start) / settings.iterations;
+    }
+
+    double mb = (src.size() + dst.size()) / 1000000.0;
+    std::cout << kernel.name << ": " << time[0]*1000 << " ms, " << mb / time[0] << " MB/s"
+              << " (scalar " << time[1]*1000 << " ms, " << mb / time[1] << " MB/s)"
+              << (equal ? "" : " MISMATCH") << std::endl;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,505 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace SceneReconstruction {
+/** @class PixelConverter "pixelconverter.h"
+ *  Conversions of image rows to the 8 bit RGB(A) layout of Gdk::Pixbuf.
+ *  Each conversion uses SSE2, SSSE3 or AVX2 if the compiler targets it
+ *  (e.g. -mssse3, -mavx2 or -march=native) and converts the remaining
+ *  pixels of a row with the scalar version, which is public to compare
+ *  the results. 16 bit values are read in machine byte order and rows
+ *  need no alignment. Conversions of a row that keep the pixel size
+ *  may convert it in place.
+ *  @author Bastian Klingen
+ */
+  class PixelConverter {
+    public:
+      /** position of the red pixel in the 2x2 tile of a bayer pattern */
+      enum BayerPattern {
+        /** red at the top left */
+        BAYER_RGGB,
+        /** red at the top right */
+        BAYER_GRBG,
+        /** red at the bottom left */
+        BAYER_GBRG,
+        /** red at the bottom right */
+        BAYER_BGGR
+      };
+
+      /** converts BGR pixels to RGB, may convert in place
+       *  @param src the BGR pixels
+       *  @param dst receives the RGB pixels
+       *  @param n number of pixels
+       */
+      static void bgr_to_rgb(const unsigned char *src, unsigned char *dst, size_t n) {
+        size_t i = 0;
+#ifdef __SSSE3__
+        // 16 pixels are three registers, each output register takes bytes of two inputs
+        const __m128i m00 = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, -128);
+        const __m128i m01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1);
+        const __m128i m10 = _mm_setr_epi8(-128, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+        const __m128i m11 = _mm_setr_epi8(0, -128, 4, 3, 2, 7, 6, 5, 10, 9, 8, 13, 12, 11, -128, 15);
+        const __m128i m12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, -128);
+        const __m128i m21 = _mm_setr_epi8(14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+        const __m128i m22 = _mm_setr_epi8(-128, 3, 2, 1, 6, 5, 4, 9, 8, 7, 12, 11, 10, 15, 14, 13);
+        for(; i + 16 <= n; i += 16) {
+          __m128i a = _mm_loadu_si128((const __m128i*)(src + i*3));
+          __m128i b = _mm_loadu_si128((const __m128i*)(src + i*3 + 16));
+          __m128i c = _mm_loadu_si128((const __m128i*)(src + i*3 + 32));
+          _mm_storeu_si128((__m128i*)(dst + i*3), _mm_or_si128(_mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01)));
+          _mm_storeu_si128((__m128i*)(dst + i*3 + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m10), _mm_shuffle_epi8(b, m11)), _mm_shuffle_epi8(c, m12)));
+          _mm_storeu_si128((__m128i*)(dst + i*3 + 32), _mm_or_si128(_mm_shuffle_epi8(b, m21), _mm_shuffle_epi8(c, m22)));
+        }
+#endif
+        bgr_to_rgb_scalar(src + i*3, dst + i*3, n - i);
+      }
+
+      /** scalar version of bgr_to_rgb
+       *  @param src the BGR pixels
+       *  @param dst receives the RGB pixels
+       *  @param n number of pixels
+       */
+      static void bgr_to_rgb_scalar(const unsigned char *src, unsigned char *dst, size_t n) {
+        for(size_t i = 0; i < n; i++, src += 3, dst += 3) {
+          unsigned char b = src[0];
+          dst[1] = src[1];
+          dst[0] = src[2];
+          dst[2] = b;
+        }
+      }
+
+      /** converts BGRA pixels to RGBA, may convert in place
+       *  @param src the BGRA pixels
+       *  @param dst receives the RGBA pixels
+       *  @param n number of pixels
+       */
+      static void bgra_to_rgba(const unsigned char *src, unsigned char *dst, size_t n) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i ga8 = _mm256_set1_epi32((int)0xff00ff00);
+        const __m256i low8 = _mm256_set1_epi32(0x000000ff);
+        for(; i + 8 <= n; i += 8) {
+          __m256i p = _mm256_loadu_si256((const __m256i*)(src + i*4));
+          __m256i rb = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 16), low8), _mm256_slli_epi32(_mm256_and_si256(p, low8), 16));
+          _mm256_storeu_si256((__m256i*)(dst + i*4), _mm256_or_si256(_mm256_and_si256(p, ga8), rb));
+        }
+#elif defined(__SSE2__)
+        // the bytes are swapped by shifting 32 bit lanes, which needs no shuffle
+        const __m128i ga = _mm_set1_epi32((int)0xff00ff00);
+        const __m128i low = _mm_set1_epi32(0x000000ff);
+        for(; i + 4 <= n; i += 4) {
+          __m128i p = _mm_loadu_si128((const __m128i*)(src + i*4));
+          __m128i rb = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), low), _mm_slli_epi32(_mm_and_si128(p, low), 16));
+          _mm_storeu_si128((__m128i*)(dst + i*4), _mm_or_si128(_mm_and_si128(p, ga), rb));
+        }
+#endif
+        bgra_to_rgba_scalar(src + i*4, dst + i*4, n - i);
+      }
+
+      /** scalar version of bgra_to_rgba
+       *  @param src the BGRA pixels
+       *  @param dst receives the RGBA pixels
+       *  @param n number of pixels
+       */
+      static void bgra_to_rgba_scalar(const unsigned char *src, unsigned char *dst, size_t n) {
+        for(size_t i = 0; i < n; i++, src += 4, dst += 4) {
+          unsigned char b = src[0];
+          dst[0] = src[2];
+          dst[1] = src[1];
+          dst[2] = b;
+          dst[3] = src[3];
+        }
+      }
+
+      /** expands gray pixels to RGB
+       *  @param src the gray pixels
+       *  @param dst receives the RGB pixels, must not overlap src
+       *  @param n number of pixels
+       */
+      static void gray_to_rgb(const unsigned char *src, unsigned char *dst, size_t n) {
+        size_t i = 0;
+#ifdef __SSSE3__
+        const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+        for(; i + 16 <= n; i += 16) {
+          __m128i g = _mm_loadu_si128((const __m128i*)(src + i));
+          _mm_storeu_si128((__m128i*)(dst + i*3), _mm_shuffle_epi8(g, m0));
+          _mm_storeu_si128((__m128i*)(dst + i*3 + 16), _mm_shuffle_epi8(g, m1));
+          _mm_storeu_si128((__m128i*)(dst + i*3 + 32), _mm_shuffle_epi8(g, m2));
+        }
+#endif
+        gray_to_rgb_scalar(src + i, dst + i*3, n - i);
+      }
+
+      /** scalar version of gray_to_rgb
+       *  @param src the gray pixels
+       *  @param dst receives the RGB pixels
+       *  @param n number of pixels
+       */
+      static void gray_to_rgb_scalar(const unsigned char *src, unsigned char *dst, size_t n) {
+        for(size_t i = 0; i < n; i++, dst += 3)
+          dst[0] = dst[1] = dst[2] = src[i];
+      }
+
+      /** reduces 16 bit values to their upper 8 bits, may convert in place
+       *  @param src the 16 bit values
+       *  @param dst receives the 8 bit values
+       *  @param n number of values, e.g. three per RGB pixel
+       */
+      static void narrow16(const unsigned char *src, unsigned char *dst, size_t n) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        for(; i + 32 <= n; i += 32) {
+          __m256i a = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(src + i*2)), 8);
+          __m256i b = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(src + i*2 + 32)), 8);
+          // packing works per 128 bit lane, the quarters are put back in order
+          _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8));
+        }
+#elif defined(__SSE2__)
+        for(; i + 16 <= n; i += 16) {
+          __m128i a = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(src + i*2)), 8);
+          __m128i b = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(src + i*2 + 16)), 8);
+          _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+        }
+#endif
+        narrow16_scalar(src + i*2, dst + i, n - i);
+      }
+
+      /** scalar version of narrow16
+       *  @param src the 16 bit values
+       *  @param dst receives the 8 bit values
+       *  @param n number of values
+       */
+      static void narrow16_scalar(const unsigned char *src, unsigned char *dst, size_t n) {
+        for(size_t i = 0; i < n; i++)
+          dst[i] = read16(src + i*2) >> 8;
+      }
+
+      /** gets the range of the measured values of a depth image row,
+       *  0 is no measurement and ignored
+       *  @param src the 16 bit depth values
+       *  @param n number of values
+       *  @param min upon return contains the smallest value, not changed if all are 0
+       *  @param max upon return contains the largest value, not changed if all are 0
+       */
+      static void depth_range(const unsigned char *src, size_t n, uint16_t &min, uint16_t &max) {
+        size_t i = 0;
+#ifdef __SSE2__
+        if(n >= 8) {
+          // SSE2 only compares signed words, the sign bit is flipped for unsigned order
+          const __m128i sign = _mm_set1_epi16((short)0x8000);
+          const __m128i zero = _mm_setzero_si128();
+          __m128i lo = _mm_set1_epi16(0x7fff), hi = _mm_set1_epi16((short)0x8000);
+          for(; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i*2));
+            __m128i none = _mm_cmpeq_epi16(v, zero);
+            lo = _mm_min_epi16(lo, _mm_xor_si128(_mm_or_si128(v, none), sign));
+            hi = _mm_max_epi16(hi, _mm_xor_si128(v, sign));
+          }
+          uint16_t l[8], h[8];
+          _mm_storeu_si128((__m128i*)l, _mm_xor_si128(lo, sign));
+          _mm_storeu_si128((__m128i*)h, _mm_xor_si128(hi, sign));
+          for(int j = 0; j < 8; j++) {
+            if(h[j] == 0)
+              continue;
+            if(min == 0 || l[j] < min)
+              min = l[j];
+            if(h[j] > max)
+              max = h[j];
+          }
+        }
+#endif
+        depth_range_scalar(src + i*2, n - i, min, max);
+      }
+
+      /** scalar version of depth_range
+       *  @param src the 16 bit depth values
+       *  @param n number of values
+       *  @param min smallest value, 0 if there is none yet
+       *  @param max largest value
+       */
+      static void depth_range_scalar(const unsigned char *src, size_t n, uint16_t &min, uint16_t &max) {
+        for(size_t i = 0; i < n; i++) {
+          uint16_t v = read16(src + i*2);
+          if(v == 0)
+            continue;
+          if(min == 0 || v < min)
+            min = v;
+          if(v > max)
+            max = v;
+        }
+      }
+
+      /** maps depth values to RGB with a blue to red color map,
+       *  0 is no measurement and black
+       *  @param src the 16 bit depth values
+       *  @param dst receives the RGB pixels, must not overlap src
+       *  @param n number of values
+       *  @param min depth mapped to blue
+       *  @param max depth mapped to red
+       */
+      static void depth_to_rgb(const unsigned char *src, unsigned char *dst, size_t n, uint16_t min, uint16_t max) {
+        size_t i = 0;
+#ifdef __SSE2__
+        uint32_t k = scale(min, max);
+        const unsigned char *map = colormap();
+        if(k <= 0xffff) {
+          // the indices are computed in parallel, the look ups stay scalar
+          const __m128i vmin = _mm_set1_epi16((short)min);
+          const __m128i vmax = _mm_set1_epi16((short)max);
+          const __m128i vk = _mm_set1_epi16((short)k);
+          unsigned char index[16];
+          uint16_t raw[16];
+          for(; i + 16 <= n; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(src + i*2));
+            __m128i b = _mm_loadu_si128((const __m128i*)(src + i*2 + 16));
+            _mm_storeu_si128((__m128i*)raw, a);
+            _mm_storeu_si128((__m128i*)(raw + 8), b);
+            // unsigned minimum with max, a - (a - max)
+            a = _mm_sub_epi16(a, _mm_subs_epu16(a, vmax));
+            b = _mm_sub_epi16(b, _mm_subs_epu16(b, vmax));
+            a = _mm_mulhi_epu16(_mm_subs_epu16(a, vmin), vk);
+            b = _mm_mulhi_epu16(_mm_subs_epu16(b, vmin), vk);
+            _mm_storeu_si128((__m128i*)index, _mm_packus_epi16(a, b));
+            for(int j = 0; j < 16; j++) {
+              const unsigned char *c = map + (raw[j] ? index[j] : 256)*3;
+              dst[(i+j)*3]   = c[0];
+              dst[(i+j)*3+1] = c[1];
+              dst[(i+j)*3+2] = c[2];
+            }
+          }
+        }
+#endif
+        depth_to_rgb_scalar(src + i*2, dst + i*3, n - i, min, max);
+      }
+
+      /** scalar version of depth_to_rgb
+       *  @param src the 16 bit depth values
+       *  @param dst receives the RGB pixels
+       *  @param n number of values
+       *  @param min depth mapped to blue
+       *  @param max depth mapped to red
+       */
+      static void depth_to_rgb_scalar(const unsigned char *src, unsigned char *dst, size_t n, uint16_t min, uint16_t max) {
+        uint32_t k = scale(min, max);
+        const unsigned char *map = colormap();
+        for(size_t i = 0; i < n; i++) {
+          uint16_t raw = read16(src + i*2);
+          uint16_t v = (raw > max ? max : raw);
+          uint64_t index = (v > min ? (uint64_t)(v - min) * k >> 16 : 0);
+          const unsigned char *c = map + (raw ? (index > 255 ? 255 : index) : 256)*3;
+          dst[i*3]   = c[0];
+          dst[i*3+1] = c[1];
+          dst[i*3+2] = c[2];
+        }
+      }
+
+      /** demosaics an 8 bit bayer image to RGBA by bilinear interpolation,
+       *  the borders are mirrored
+       *  @param src the bayer image
+       *  @param src_step bytes per row of src
+       *  @param dst receives the RGBA image, must not overlap src
+       *  @param dst_step bytes per row of dst
+       *  @param width width of the image
+       *  @param height height of the image
+       *  @param pattern the bayer pattern
+       */
+      static void bayer_to_rgba(const unsigned char *src, size_t src_step, unsigned char *dst, size_t dst_step,
+                                int width, int height, BayerPattern pattern) {
+        bayer(src, src_step, dst, dst_step, width, height, pattern, true);
+      }
+
+      /** scalar version of bayer_to_rgba
+       *  @param src the bayer image
+       *  @param src_step bytes per row of src
+       *  @param dst receives the RGBA image
+       *  @param dst_step bytes per row of dst
+       *  @param width width of the image
+       *  @param height height of the image
+       *  @param pattern the bayer pattern
+       */
+      static void bayer_to_rgba_scalar(const unsigned char *src, size_t src_step, unsigned char *dst, size_t dst_step,
+                                       int width, int height, BayerPattern pattern) {
+        bayer(src, src_step, dst, dst_step, width, height, pattern, false);
+      }
+
+      /** gets the color map of depth_to_rgb
+       *  @return 256 RGB colors from blue to red, followed by black
+       */
+      static const unsigned char* colormap() {
+        struct Map {
+          unsigned char rgb[257*3];
+          Map() {
+            for(int i = 0; i < 256; i++) {
+              double t = i / 255.0;
+              rgb[i*3]   = jet(4*t - 3);
+              rgb[i*3+1] = jet(4*t - 2);
+              rgb[i*3+2] = jet(4*t - 1);
+            }
+            rgb[256*3] = rgb[256*3+1] = rgb[256*3+2] = 0;
+          }
+          static unsigned char jet(double d) {
+            double v = 1.5 - (d < 0 ? -d : d);
+            return (unsigned char)(255 * (v < 0 ? 0 : (v > 1 ? 1 : v)) + 0.5);
+          }
+        };
+        static const Map map;
+        return map.rgb;
+      }
+
+    private:
+      /** demosaics a bayer image, see bayer_to_rgba
+       *  @param simd false to use the scalar version only
+       */
+      static void bayer(const unsigned char *src, size_t src_step, unsigned char *dst, size_t dst_step,
+                        int width, int height, BayerPattern pattern, bool simd) {
+        if(width <= 0)
+          return;
+#ifndef __SSE2__
+        (void)simd;
+#endif
+        int rx = (pattern == BAYER_GRBG || pattern == BAYER_BGGR) ? 1 : 0;
+        int ry = (pattern == BAYER_GBRG || pattern == BAYER_BGGR) ? 1 : 0;
+        for(int y = 0; y < height; y++) {
+          const unsigned char *up = src + mirror(y-1, height)*src_step;
+          const unsigned char *row = src + y*src_step;
+          const unsigned char *down = src + mirror(y+1, height)*src_step;
+          unsigned char *out = dst + y*dst_step;
+          bool red_row = ((y & 1) == ry);
+          int x = 1;
+#ifdef __SSE2__
+          if(simd && y > 0 && y < height-1) {
+            // red sites and the green sites next to them share the column
+            // parity rx, the mask selects their values
+            const __m128i even = _mm_set1_epi16(0x00ff);
+            const __m128i mask = ((x & 1) == rx) ? even : _mm_slli_epi16(even, 8);
+            const __m128i alpha = _mm_set1_epi8((char)0xff);
+            for(; x + 16 < width; x += 16) {
+              __m128i c = _mm_loadu_si128((const __m128i*)(row + x));
+              __m128i h = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row + x - 1)), _mm_loadu_si128((const __m128i*)(row + x + 1)));
+              __m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(up + x)), _mm_loadu_si128((const __m128i*)(down + x)));
+              __m128i d = _mm_avg_epu8(_mm_avg_epu8(_mm_loadu_si128((const __m128i*)(up + x - 1)), _mm_loadu_si128((const __m128i*)(up + x + 1))),
+                                       _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(down + x - 1)), _mm_loadu_si128((const __m128i*)(down + x + 1))));
+              __m128i p = _mm_avg_epu8(h, v);
+              __m128i r, g, b;
+              if(red_row) {
+                r = select(mask, c, h);
+                g = select(mask, p, c);
+                b = select(mask, d, v);
+              }
+              else {
+                r = select(mask, v, d);
+                g = select(mask, c, p);
+                b = select(mask, h, c);
+              }
+              __m128i rg_lo = _mm_unpacklo_epi8(r, g), rg_hi = _mm_unpackhi_epi8(r, g);
+              __m128i ba_lo = _mm_unpacklo_epi8(b, alpha), ba_hi = _mm_unpackhi_epi8(b, alpha);
+              _mm_storeu_si128((__m128i*)(out + x*4), _mm_unpacklo_epi16(rg_lo, ba_lo));
+              _mm_storeu_si128((__m128i*)(out + x*4 + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+              _mm_storeu_si128((__m128i*)(out + x*4 + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+              _mm_storeu_si128((__m128i*)(out + x*4 + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+            }
+          }
+#endif
+          bayer_pixel(up, row, down, out, 0, width, red_row, rx);
+          for(; x < width; x++)
+            bayer_pixel(up, row, down, out, x, width, red_row, rx);
+        }
+      }
+
+      /** reads a 16 bit value in machine byte order
+       *  @param src the value, needs no alignment
+       *  @return the value
+       */
+      static uint16_t read16(const unsigned char *src) {
+        uint16_t v;
+        memcpy(&v, src, sizeof(v));
+        return v;
+      }
+
+      /** mirrors a coordinate at the borders, which keeps the bayer color
+       *  @param i the coordinate
+       *  @param size size of the image in this direction
+       *  @return the coordinate inside of the image
+       */
+      static int mirror(int i, int size) {
+        if(i < 0)
+          return size > 1 ? 1 : 0;
+        if(i >= size)
+          return size > 1 ? size-2 : 0;
+        return i;
+      }
+
+      /** gets the factor of the color map index
+       *  @param min depth mapped to index 0
+       *  @param max depth mapped to index 255
+       *  @return index per depth step in 16 bit fixed point
+       */
+      static uint32_t scale(uint16_t min, uint16_t max) {
+        return (255u << 16) / (max > min ? max - min : 1);
+      }
+
+      /** rounded average like _mm_avg_epu8 */
+      static unsigned char avg(unsigned char a, unsigned char b) {
+        return (a + b + 1) >> 1;
+      }
+
+#ifdef __SSE2__
+      /** selects bytes of two registers
+       *  @param mask 0xff where a is selected
+       *  @param a the selected bytes
+       *  @param b the other bytes
+       *  @return the combined register
+       */
+      static __m128i select(__m128i mask, __m128i a, __m128i b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+      }
+#endif
+
+      /** demosaics one pixel of a bayer image
+       *  @param up the row above
+       *  @param row the row of the pixel
+       *  @param down the row below
+       *  @param out the RGBA row
+       *  @param x column of the pixel
+       *  @param width width of the image
+       *  @param red_row true if the row has red pixels
+       *  @param rx column parity of the red pixels
+       */
+      static void bayer_pixel(const unsigned char *up, const unsigned char *row, const unsigned char *down,
+                              unsigned char *out, int x, int width, bool red_row, int rx) {
+        int xl = mirror(x-1, width), xr = mirror(x+1, width);
+        unsigned char c = row[x];
+        unsigned char h = avg(row[xl], row[xr]);
+        unsigned char v = avg(up[x], down[x]);
+        unsigned char d = avg(avg(up[xl], up[xr]), avg(down[xl], down[xr]));
+        unsigned char p = avg(h, v);
+        bool red_col = ((x & 1) == rx);
+        unsigned char *o = out + x*4;
+        if(red_row) {
+          o[0] = red_col ? c : h;
+          o[1] = red_col ? p : c;
+          o[2] = red_col ? d : v;
+        }
+        else {
+          o[0] = red_col ? v : d;
+          o[1] = red_col ? c : p;
+          o[2] = red_col ? h : c;
+        }
+        o[3] = 255;
+      }
+  };
+}
@@ -0,0 +1,312 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+namespace SceneReconstruction {
+/** @class ReachabilityIndex "reachability.h"
+ *  Transitive reachability of a directed acyclic graph stored as
+ *  bit-parallel descendant and ancestor sets, one bit row per node.
+ *  Answers the ancestors and descendants of a node without traversing
+ *  the graph. Edge insertions and removals update the index in place,
+ *  other changes invalidate it until it is built again. Graphs with
+ *  cycles or more nodes than the limit are not indexed.
+ *  The node type needs the id vectors children and parents.
+ *  @author Bastian Klingen
+ */
+  template<class Node>
+  class ReachabilityIndex {
+    public:
+      /** Constructor
+       *  @param max_nodes maximal number of nodes to index, the index needs
+       *         max_nodes*max_nodes/4 bytes
+       */
+      ReachabilityIndex(int max_nodes = 8192) : limit(max_nodes), n(0), words(0), state(INVALID) {}
+
+      /** marks the index as outdated, it has to be built again */
+      void invalidate() {
+        state = INVALID;
+        desc.clear();
+        anc.clear();
+      }
+
+      /** checks if the index answers queries
+       *  @return true if the index is up to date
+       */
+      bool valid() const {
+        return state == VALID;
+      }
+
+      /** checks if a build is necessary
+       *  @return true if the index was invalidated since the last build
+       */
+      bool outdated() const {
+        return state == INVALID;
+      }
+
+      /** builds the index
+       *  @param nodes nodes of the graph indexed by id
+       *  @return true if the graph was indexed, false if it is too big or has a cycle
+       */
+      bool build(const std::vector<Node> &nodes) {
+        n = nodes.size();
+        words = (n+63)/64;
+        desc.clear();
+        anc.clear();
+        if(n > limit) {
+          state = UNAVAILABLE;
+          return false;
+        }
+
+        std::vector<int> order;
+        if(!topological_order(nodes, order)) {
+          state = UNAVAILABLE;
+          return false;
+        }
+
+        desc.assign((size_t)n*words, 0);
+        anc.assign((size_t)n*words, 0);
+        // children before parents for the descendants, parents before children for the ancestors
+        std::vector<int>::reverse_iterator riter;
+        for(riter = order.rbegin(); riter != order.rend(); riter++)
+          collect(nodes, *riter, true);
+        std::vector<int>::iterator iter;
+        for(iter = order.begin(); iter != order.end(); iter++)
+          collect(nodes, *iter, false);
+
+        state = VALID;
+        return true;
+      }
+
+      /** updates the index after an edge was added to the graph
+       *  only the rows are needed, the nodes are passed for symmetry with remove_edge
+       *  @param nodes nodes of the graph indexed by id
+       *  @param from id of the node the edge comes from
+       *  @param to id of the node the edge points to
+       */
+      void add_edge(const std::vector<Node> & /*nodes*/, int from, int to) {
+        if(state != VALID)
+          return;
+        if(from == to || reaches(to, from)) {
+          // the graph is no longer acyclic
+          state = UNAVAILABLE;
+          desc.clear();
+          anc.clear();
+          return;
+        }
+        if(reaches(from, to))
+          return;
+
+        // from and its ancestors reach to and its descendants
+        std::vector<int> sources, targets;
+        ids(anc, from, sources);
+        sources.push_back(from);
+        ids(desc, to, targets);
+        targets.push_back(to);
+
+        std::vector<int>::iterator iter;
+        for(iter = sources.begin(); iter != sources.end(); iter++) {
+          merge(desc, *iter, desc, to);
+          set(desc, *iter, to);
+        }
+        for(iter = targets.begin(); iter != targets.end(); iter++) {
+          merge(anc, *iter, anc, from);
+          set(anc, *iter, from);
+        }
+      }
+
+      /** updates the index after an edge was removed from the graph
+       *  only the descendants of from and its ancestors and the ancestors of to
+       *  and its descendants are computed again
+       *  @param nodes nodes of the graph indexed by id
+       *  @param from id of the node the edge came from
+       *  @param to id of the node the edge pointed to
+       */
+      void remove_edge(const std::vector<Node> &nodes, int from, int to) {
+        if(state == UNAVAILABLE) {
+          // removing the edge may have broken a cycle
+          invalidate();
+          return;
+        }
+        if(state != VALID)
+          return;
+        // another edge with a different label still connects the nodes
+        if(std::find(nodes[from].children.begin(), nodes[from].children.end(), to) != nodes[from].children.end())
+          return;
+
+        std::vector<int> sources, targets;
+        ids(anc, from, sources);
+        sources.push_back(from);
+        ids(desc, to, targets);
+        targets.push_back(to);
+
+        recompute(nodes, sources, true);
+        recompute(nodes, targets, false);
+      }
+
+      /** checks if a node reaches another one
+       *  @param from id of the start node
+       *  @param to id of the end node
+       *  @return true if to is a descendant of from
+       */
+      bool reaches(int from, int to) const {
+        return test(desc, from, to);
+      }
+
+      /** collects the node, its ancestors and its descendants
+       *  @param node id of the node
+       *  @param closure receives the ids in ascending order
+       *  @return false if the index is not valid
+       */
+      bool closure(int node, std::vector<int> &closure) const {
+        if(state != VALID)
+          return false;
+
+        closure.clear();
+        const boost::uint64_t *d = &desc[(size_t)node*words];
+        const boost::uint64_t *a = &anc[(size_t)node*words];
+        for(int w = 0; w < words; w++) {
+          boost::uint64_t bits = d[w] | a[w];
+          if(w == node/64)
+            bits |= (boost::uint64_t)1 << (node%64);
+          while(bits) {
+            closure.push_back(w*64 + __builtin_ctzll(bits));
+            bits &= bits-1;
+          }
+        }
+
+        return true;
+      }
+
+    private:
+      /** state of the index */
+      enum State { INVALID, VALID, UNAVAILABLE };
+
+      /** topological order of all nodes (parents before children)
+       *  @param nodes nodes of the graph indexed by id
+       *  @param order receives the ids
+       *  @return false if the graph has a cycle
+       */
+      static bool topological_order(const std::vector<Node> &nodes, std::vector<int> &order) {
+        std::vector<int> indegree(nodes.size(), 0);
+        for(size_t i = 0; i < nodes.size(); i++)
+          indegree[i] = nodes[i].parents.size();
+
+        order.clear();
+        order.reserve(nodes.size());
+        for(size_t i = 0; i < nodes.size(); i++)
+          if(indegree[i] == 0)
+            order.push_back(i);
+
+        for(size_t i = 0; i < order.size(); i++) {
+          const std::vector<int> &children = nodes[order[i]].children;
+          std::vector<int>::const_iterator iter;
+          for(iter = children.begin(); iter != children.end(); iter++)
+            if(--indegree[*iter] == 0)
+              order.push_back(*iter);
+        }
+
+        return order.size() == nodes.size();
+      }
+
+      /** computes the row of a node from its direct neighbours
+       *  @param nodes nodes of the graph indexed by id
+       *  @param node id of the node
+       *  @param down true for the descendants, false for the ancestors
+       */
+      void collect(const std::vector<Node> &nodes, int node, bool down) {
+        std::vector<boost::uint64_t> &rows = down ? desc : anc;
+        const std::vector<int> &next = down ? nodes[node].children : nodes[node].parents;
+        std::fill(rows.begin() + (size_t)node*words, rows.begin() + (size_t)(node+1)*words, 0);
+        std::vector<int>::const_iterator iter;
+        for(iter = next.begin(); iter != next.end(); iter++) {
+          merge(rows, node, rows, *iter);
+          set(rows, node, *iter);
+        }
+      }
+
+      /** computes the rows of an upward (descendants) or downward (ancestors) closed set again
+       *  @param nodes nodes of the graph indexed by id
+       *  @param set ids of the nodes to compute
+       *  @param down true for the descendants, false for the ancestors
+       */
+      void recompute(const std::vector<Node> &nodes, const std::vector<int> &set, bool down) {
+        // restricted topological order: a node is ready once all its
+        // neighbours in the set are computed
+        std::vector<int> pending(n, -1);
+        std::vector<int>::const_iterator iter;
+        for(iter = set.begin(); iter != set.end(); iter++)
+          pending[*iter] = 0;
+        for(iter = set.begin(); iter != set.end(); iter++) {
+          const std::vector<int> &next = down ? nodes[*iter].children : nodes[*iter].parents;
+          std::vector<int>::const_iterator niter;
+          for(niter = next.begin(); niter != next.end(); niter++)
+            if(pending[*niter] >= 0)
+              pending[*iter]++;
+        }
+
+        std::vector<int> ready;
+        for(iter = set.begin(); iter != set.end(); iter++)
+          if(pending[*iter] == 0)
+            ready.push_back(*iter);
+
+        for(size_t i = 0; i < ready.size(); i++) {
+          collect(nodes, ready[i], down);
+          const std::vector<int> &prev = down ? nodes[ready[i]].parents : nodes[ready[i]].children;
+          std::vector<int>::const_iterator piter;
+          for(piter = prev.begin(); piter != prev.end(); piter++)
+            if(pending[*piter] > 0 && --pending[*piter] == 0)
+              ready.push_back(*piter);
+        }
+      }
+
+      /** collects the ids in a row
+       *  @param rows bit rows
+       *  @param node id of the row
+       *  @param out receives the ids
+       */
+      void ids(const std::vector<boost::uint64_t> &rows, int node, std::vector<int> &out) const {
+        const boost::uint64_t *r = &rows[(size_t)node*words];
+        for(int w = 0; w < words; w++) {
+          boost::uint64_t bits = r[w];
+          while(bits) {
+            out.push_back(w*64 + __builtin_ctzll(bits));
+            bits &= bits-1;
+          }
+        }
+      }
+
+      /** ors a row into another one */
+      void merge(std::vector<boost::uint64_t> &dst, int row, const std::vector<boost::uint64_t> &src, int other) {
+        boost::uint64_t *d = &dst[(size_t)row*words];
+        const boost::uint64_t *s = &src[(size_t)other*words];
+        for(int w = 0; w < words; w++)
+          d[w] |= s[w];
+      }
+
+      /** sets a bit in a row */
+      void set(std::vector<boost::uint64_t> &rows, int row, int bit) {
+        rows[(size_t)row*words + bit/64] |= (boost::uint64_t)1 << (bit%64);
+      }
+
+      /** tests a bit in a row */
+      bool test(const std::vector<boost::uint64_t> &rows, int row, int bit) const {
+        return (rows[(size_t)row*words + bit/64] >> (bit%64)) & 1;
+      }
+
+    private:
+      /** maximal number of nodes to index */
+      int                                 limit;
+      /** number of indexed nodes */
+      int                                 n;
+      /** number of 64 bit words per row */
+      int                                 words;
+      /** state of the index */
+      State                               state;
+      /** descendant rows, node by node */
+      std::vector<boost::uint64_t>        desc;
+      /** ancestor rows, node by node */
+      std::vector<boost::uint64_t>        anc;
+  };
+}
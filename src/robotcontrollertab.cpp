@@ -37,6 +37,7 @@ RobotControllerTab::~RobotControllerTab() {
 }
 
 void RobotControllerTab::OnControllerInfoMsg(ConstSceneRobotControllerPtr& _msg) {
+  logger->record("~/SceneReconstruction/RobotController/ControllerInfo", *_msg);
   {
     boost::mutex::scoped_lock lock(*this->controllerinfoMutex);
     this->controllerinfoMsgs.push_back(*_msg);
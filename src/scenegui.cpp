@@ -88,6 +88,8 @@ SceneGUI::~SceneGUI() {
 }
 
 void SceneGUI::OnResponseMsg(ConstResponsePtr &_msg) {
+  // availability responses name the plugin instead of reporting success
+  logger->record("~/SceneReconstruction/GUI/Availability/Response", static_cast<const google::protobuf::Message&>(*_msg));
   {
     boost::mutex::scoped_lock lock(*this->responseMutex);
     this->responseMsgs.push_back(*_msg);
@@ -0,0 +1,181 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+#include <cairo.h>
+#include <cairomm/cairomm.h>
+
+#include <boost/thread/mutex.hpp>
+
+namespace SceneReconstruction {
+/** @class TextCache "textcache.h"
+ *  Least recently used cache of shaped texts. Converting a text to
+ *  glyphs is the most expensive part of drawing a label, so the glyphs
+ *  and extents of a text are kept per font, slant, weight and size, and
+ *  per scale and font options of the device, since both change the
+ *  hinting. They are reused by every later rendering of the same label
+ *  at the same scale. The glyphs
+ *  start at the origin, the caller translates the context to the
+ *  position of the text. The cache is locked, so renderings on several
+ *  threads can share it.
+ *  @author Bastian Klingen
+ */
+  class TextCache {
+    public:
+      /** a shaped text */
+      struct Text {
+        /** the glyphs, positioned relative to the start of the text */
+        std::vector<Cairo::Glyph>  glyphs;
+        /** extents of the glyphs */
+        Cairo::TextExtents         extents;
+      };
+
+      /** Constructor
+       *  @param _capacity number of texts to keep
+       */
+      TextCache(size_t _capacity = 4096) : capacity(_capacity), hits(0), misses(0), evictions(0) {}
+
+      /** selects a font on a context and gets the shaped text for it,
+       *  the text is only shaped if it is not cached yet
+       *  @param cr cairo context, the font is selected on it
+       *  @param font font family
+       *  @param slant font slant
+       *  @param weight font weight
+       *  @param size font size
+       *  @param text the text
+       *  @param result upon return contains the glyphs and extents
+       */
+      void shape(const Cairo::RefPtr<Cairo::Context> &cr, const std::string &font,
+                 Cairo::FontSlant slant, Cairo::FontWeight weight, double size,
+                 const std::string &text, Text &result) {
+        cr->select_font_face(font, slant, weight);
+        cr->set_font_size(size);
+        cairo_scaled_font_t *font_face = cairo_get_scaled_font(cr->cobj());
+
+        Key key;
+        key.font = font;
+        key.slant = slant;
+        key.weight = weight;
+        key.size = size;
+        key.text = text;
+        // hinted glyphs depend on the scale to the device and on the hint settings
+        cairo_matrix_t scale;
+        cairo_scaled_font_get_scale_matrix(font_face, &scale);
+        key.xx = scale.xx;
+        key.yx = scale.yx;
+        key.xy = scale.xy;
+        key.yy = scale.yy;
+        cairo_font_options_t *options = cairo_font_options_create();
+        cairo_scaled_font_get_font_options(font_face, options);
+        key.options = cairo_font_options_hash(options);
+        cairo_font_options_destroy(options);
+        {
+          boost::mutex::scoped_lock lock(mutex);
+          EntryIndex::iterator i = index.find(key);
+          if(i != index.end()) {
+            hits++;
+            // most recently used texts are at the front
+            entries.splice(entries.begin(), entries, i->second);
+            result = i->second->second;
+            return;
+          }
+          misses++;
+        }
+
+        cairo_glyph_t *glyphs = NULL;
+        int count = 0;
+        result.glyphs.clear();
+        if(cairo_scaled_font_text_to_glyphs(font_face, 0, 0, text.c_str(), text.size(), &glyphs, &count, NULL, NULL, NULL) == CAIRO_STATUS_SUCCESS) {
+          result.glyphs.assign(glyphs, glyphs + count);
+          cairo_glyph_free(glyphs);
+        }
+        cairo_scaled_font_glyph_extents(font_face, result.glyphs.empty() ? NULL : &result.glyphs[0], result.glyphs.size(), &result.extents);
+
+        boost::mutex::scoped_lock lock(mutex);
+        // another thread may have shaped the same text meanwhile
+        if(index.find(key) != index.end())
+          return;
+        entries.push_front(std::make_pair(key, result));
+        index[key] = entries.begin();
+        while(entries.size() > capacity) {
+          index.erase(entries.back().first);
+          entries.pop_back();
+          evictions++;
+        }
+      }
+
+      /** removes all texts, the counters are kept */
+      void clear() {
+        boost::mutex::scoped_lock lock(mutex);
+        index.clear();
+        entries.clear();
+      }
+
+      /** gets the counters of the cache
+       *  @param _hits upon return contains the number of texts found in the cache
+       *  @param _misses upon return contains the number of texts that were shaped
+       *  @param _evictions upon return contains the number of texts dropped for newer ones
+       *  @param _size upon return contains the number of cached texts
+       */
+      void get_stats(unsigned long &_hits, unsigned long &_misses, unsigned long &_evictions, size_t &_size) {
+        boost::mutex::scoped_lock lock(mutex);
+        _hits = hits;
+        _misses = misses;
+        _evictions = evictions;
+        _size = entries.size();
+      }
+
+    private:
+      /** what the glyphs of a text depend on */
+      struct Key {
+        std::string        font;
+        int                slant;
+        int                weight;
+        double             size;
+        std::string        text;
+        /** linear part of the font matrix times the CTM */
+        double             xx, yx, xy, yy;
+        /** hash of the font options */
+        unsigned long      options;
+
+        bool operator<(const Key &rhs) const {
+          if(size != rhs.size)
+            return size < rhs.size;
+          if(xx != rhs.xx)
+            return xx < rhs.xx;
+          if(yy != rhs.yy)
+            return yy < rhs.yy;
+          if(yx != rhs.yx)
+            return yx < rhs.yx;
+          if(xy != rhs.xy)
+            return xy < rhs.xy;
+          if(options != rhs.options)
+            return options < rhs.options;
+          if(slant != rhs.slant)
+            return slant < rhs.slant;
+          if(weight != rhs.weight)
+            return weight < rhs.weight;
+          int c = text.compare(rhs.text);
+          if(c != 0)
+            return c < 0;
+          return font < rhs.font;
+        }
+      };
+
+      typedef std::list<std::pair<Key, Text> >       EntryList;
+      typedef std::map<Key, EntryList::iterator>     EntryIndex;
+
+    private:
+      /** the cached texts, most recently used first */
+      EntryList          entries;
+      /** the cached texts by key */
+      EntryIndex         index;
+      /** maximum number of cached texts */
+      size_t             capacity;
+      /** counters */
+      unsigned long      hits, misses, evictions;
+      boost::mutex       mutex;
+  };
+}